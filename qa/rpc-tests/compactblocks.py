@@ -0,0 +1,85 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Compare compact block relay against full blocks on regtest.
+#
+# Node 0 mines, node 1 asks for compact blocks and node 2 runs with
+# -compactblocks=0; both only connect to node 0. Each round fills the
+# mempools with the same transactions, mines a block on node 0 and records,
+# for nodes 1 and 2, the bytes received for the block and the time until it
+# became their tip.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+import time
+
+class CompactBlocksTest(BitcoinTestFramework):
+
+    def setup_network(self):
+        self.nodes = []
+        self.nodes.append(start_node(0, self.options.tmpdir, ["-debug=net"]))
+        self.nodes.append(start_node(1, self.options.tmpdir, ["-debug=cmpctblock"]))
+        self.nodes.append(start_node(2, self.options.tmpdir, ["-compactblocks=0"]))
+        connect_nodes(self.nodes[1], 0)
+        connect_nodes(self.nodes[2], 0)
+        self.is_network_split = False
+        self.sync_all()
+
+    def bytes_received(self, node):
+        return sum(peer['bytesrecv'] for peer in node.getpeerinfo())
+
+    def relay_block(self):
+        before = [ self.bytes_received(self.nodes[i]) for i in (1, 2) ]
+        start = time.time()
+        blockhash = self.nodes[0].setgenerate(True, 1)[0]
+        latency = [ None, None ]
+        while None in latency:
+            if time.time() - start > 60:
+                raise AssertionError("block %s not relayed within 60s" % blockhash)
+            for i in (1, 2):
+                if latency[i - 1] is None and self.nodes[i].getbestblockhash() == blockhash:
+                    latency[i - 1] = time.time() - start
+            time.sleep(0.001)
+        after = [ self.bytes_received(self.nodes[i]) for i in (1, 2) ]
+        return [ after[i] - before[i] for i in (0, 1) ], latency
+
+    def run_test(self):
+        rounds = 5
+        txs_per_block = 50
+        total_bytes = [ 0, 0 ]
+        total_latency = [ 0.0, 0.0 ]
+
+        for r in range(rounds):
+            for n in range(txs_per_block):
+                self.nodes[0].sendtoaddress(self.nodes[1 + n % 2].getnewaddress(), 0.01)
+            sync_mempools(self.nodes)
+
+            size, latency = self.relay_block()
+            for i in (0, 1):
+                total_bytes[i] += size[i]
+                total_latency[i] += latency[i]
+            sync_blocks(self.nodes)
+            assert_equal(self.nodes[1].getrawmempool(), [])
+            assert_equal(self.nodes[2].getrawmempool(), [])
+
+        print "Compact blocks: %d bytes/block, %.1f ms/block" % (total_bytes[0] / rounds, 1000 * total_latency[0] / rounds)
+        print "Full blocks:    %d bytes/block, %.1f ms/block" % (total_bytes[1] / rounds, 1000 * total_latency[1] / rounds)
+
+        # With every transaction already in the mempool the compact block
+        # carries one short id per transaction instead of the transaction
+        assert(total_bytes[0] * 2 < total_bytes[1])
+
+        # Mine right away, before the inventory trickle has announced the new
+        # transactions: node 1 then needs a getblocktxn round trip, but still
+        # gets the block
+        for n in range(10):
+            self.nodes[0].sendtoaddress(self.nodes[2].getnewaddress(), 0.01)
+        self.relay_block()
+        sync_blocks(self.nodes)
+
+if __name__ == '__main__':
+    CompactBlocksTest().main()
@@ -0,0 +1,73 @@
+#!/usr/bin/env python2
+# Copyright (c) 2014 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test that the mempool, including fee deltas set with
+# prioritisetransaction, survives a restart through mempool.dat,
+# and that -persistmempool=0 neither loads nor writes it.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+import os
+import time
+
+class MempoolPersistTest(BitcoinTestFramework):
+
+    def setup_network(self):
+        self.nodes = []
+        self.nodes.append(start_node(0, self.options.tmpdir, ["-debug=mempool"]))
+        self.nodes.append(start_node(1, self.options.tmpdir, ["-persistmempool=0"]))
+        connect_nodes(self.nodes[1], 0)
+        self.is_network_split = False
+        self.sync_all()
+
+    def wait_for_mempool(self, node, size):
+        # mempool.dat is loaded in the background after startup
+        start = time.time()
+        while node.getmempoolinfo()['size'] != size:
+            if time.time() - start > 30:
+                raise AssertionError("mempool has %d transactions, expected %d" % (node.getmempoolinfo()['size'], size))
+            time.sleep(0.25)
+
+    def run_test(self):
+        txids = [ self.nodes[0].sendtoaddress(self.nodes[0].getnewaddress(), 0.01) for i in range(5) ]
+        sync_mempools(self.nodes)
+        assert_equal(len(self.nodes[0].getrawmempool()), 5)
+        assert_equal(len(self.nodes[1].getrawmempool()), 5)
+
+        self.nodes[0].prioritisetransaction(txids[0], 0, 1000)
+        before = self.nodes[0].getrawmempool(True)
+
+        stop_nodes(self.nodes)
+        wait_bitcoinds()
+        mempooldat0 = os.path.join(self.options.tmpdir, "node0", "regtest", "mempool.dat")
+        mempooldat1 = os.path.join(self.options.tmpdir, "node1", "regtest", "mempool.dat")
+        assert(os.path.isfile(mempooldat0))
+        assert(not os.path.isfile(mempooldat1))
+
+        # Restart without connecting the nodes, so node 0 can only have
+        # gotten its transactions back from disk
+        self.nodes.append(start_node(0, self.options.tmpdir))
+        self.nodes.append(start_node(1, self.options.tmpdir, ["-persistmempool=0"]))
+        self.wait_for_mempool(self.nodes[0], 5)
+        after = self.nodes[0].getrawmempool(True)
+        for txid in txids:
+            # entry time and fee deltas are kept
+            assert_equal(after[txid]['time'], before[txid]['time'])
+            assert_equal(after[txid]['modifiedfee'], before[txid]['modifiedfee'])
+        assert(after[txids[0]]['modifiedfee'] > after[txids[0]]['fee'])
+        time.sleep(2)
+        assert_equal(len(self.nodes[1].getrawmempool()), 0)
+
+        # Restarting with -persistmempool=0 leaves the mempool empty
+        stop_nodes(self.nodes)
+        wait_bitcoinds()
+        self.nodes.append(start_node(0, self.options.tmpdir, ["-persistmempool=0"]))
+        time.sleep(2)
+        assert_equal(len(self.nodes[0].getrawmempool()), 0)
+
+if __name__ == '__main__':
+    MempoolPersistTest().main()
@@ -0,0 +1,75 @@
+#!/usr/bin/env python2
+# Copyright (c) 2015-2018 The SAVIOUR developers
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Flood the masternode subsystems of a regtest node with mnb, mnp, mnw and
+# mvote traffic from virtual masternodes and report throughput, latency and
+# memory usage per subsystem.
+#
+# The virtual masternodes, their proposals and everything they sent are
+# removed after each run, so the maps the node started with are what it ends
+# up with.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+
+class MasternodeSimulateTest(BitcoinTestFramework):
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain_clean(self.options.tmpdir, 1)
+
+    def setup_network(self):
+        self.nodes = []
+        self.nodes.append(start_node(0, self.options.tmpdir))
+        self.is_network_split = False
+
+    def report(self, result):
+        print "%d masternodes, %d proposals" % (result["masternodes"], result["proposals"])
+        for command in ("mnb", "mnp", "mnw", "mvote"):
+            traffic = result[command]
+            print "  %-6s %7d sent %7d accepted %8d/s  avg %6d us  max %7d us" % (command, traffic["sent"], traffic["accepted"],
+                traffic["per_second"], traffic["latency_avg_us"], traffic["latency_max_us"])
+        for name, usage in sorted(result["memory"].items()):
+            print "  %-12s %7d -> %7d entries %10d -> %10d bytes" % (name, usage["entries_before"], usage["entries_after"],
+                usage["usage_before"], usage["usage_after"])
+
+    # Maps holding what the traffic sent, by subsystem
+    SIMULATED_MAPS = {
+        "masternodes": ("vMasternodes", "mapSeenMasternodeBroadcast", "mapSeenMasternodePing"),
+        "budget": ("mapProposals", "mapSeenMasternodeBudgetVotes", "mapOrphanMasternodeBudgetVotes"),
+        "payments": ("mapMasternodePayeeVotes", "masternodeBlocks", "mapMasternodesLastVote"),
+        "sync": ("mapSeenSyncMNB", "mapSeenSyncMNW", "mapSeenSyncBudget"),
+    }
+
+    def simulated_entries(self):
+        info = self.nodes[0].getmemoryinfo()
+        return dict((name, info[subsystem][name]["entries"])
+                    for subsystem, names in self.SIMULATED_MAPS.items() for name in names)
+
+    def run_test(self):
+        # Payment votes are for blocks past the first 100
+        self.nodes[0].setgenerate(True, 120)
+
+        masternodes = len(self.nodes[0].listmasternodes())
+        entries = self.simulated_entries()
+        for count in (50, 200):
+            result = self.nodes[0].mnsimulate(count, 10)
+            self.report(result)
+            assert_equal(result["masternodes"], count)
+            for command in ("mnb", "mnp", "mnw", "mvote"):
+                assert(result[command]["accepted"] > 0)
+            assert_equal(result["mnb"]["accepted"], count)
+            assert_equal(len(self.nodes[0].listmasternodes()), masternodes)
+            assert_equal(self.simulated_entries(), entries)
+
+        # Throttled runs stay close to the requested rate
+        result = self.nodes[0].mnsimulate(10, 1, 1000)
+        self.report(result)
+        assert(result["mnb"]["accepted"] > 0)
+
+if __name__ == '__main__':
+    MasternodeSimulateTest().main()
@@ -0,0 +1,95 @@
+#!/usr/bin/env python2
+# Copyright (c) 2015-2018 The SAVIOUR developers
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Compare the masternode list and budget sync with digests against the
+# full sync on regtest.
+#
+# Nodes 1 and 2 both sync from node 0; node 2 runs with -syncdigests=0.
+# Nodes 0 and 1 hold the same virtual masternodes, proposals and votes from
+# mnsimulate, so the digests node 1 sends (dsegd, mnvsd) match and node 0
+# has next to nothing to send it, while node 2 is offered everything.
+# Each round resets the masternode sync of both and records the bytes they
+# received and the time until they reached MASTERNODE_SYNC_FINISHED.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+import time
+
+MASTERNODE_SYNC_FINISHED = 999
+SIMULATED_MASTERNODES = 40
+SIMULATED_PROPOSALS = 5
+SIMULATION_SEED = 4242
+
+class MasternodeSyncTest(BitcoinTestFramework):
+
+    def setup_network(self):
+        self.nodes = []
+        self.nodes.append(start_node(0, self.options.tmpdir, ["-debug=masternode", "-debug=mnbudget"]))
+        self.nodes.append(start_node(1, self.options.tmpdir, ["-debug=masternode", "-debug=mnbudget"]))
+        self.nodes.append(start_node(2, self.options.tmpdir, ["-syncdigests=0"]))
+        connect_nodes(self.nodes[1], 0)
+        connect_nodes(self.nodes[2], 0)
+        self.is_network_split = False
+        self.sync_all()
+
+    def bytes_received(self, node):
+        return sum(peer['bytesrecv'] for peer in node.getpeerinfo())
+
+    def resync(self):
+        before = [ self.bytes_received(self.nodes[i]) for i in (1, 2) ]
+        start = time.time()
+        for i in (1, 2):
+            assert_equal(self.nodes[i].mnsync("reset"), "success")
+        elapsed = [ None, None ]
+        while None in elapsed:
+            if time.time() - start > 300:
+                raise AssertionError("masternode sync not finished within 300s")
+            for i in (1, 2):
+                if elapsed[i - 1] is None and self.nodes[i].mnsync("status")["RequestedMasternodeAssets"] == MASTERNODE_SYNC_FINISHED:
+                    elapsed[i - 1] = time.time() - start
+            time.sleep(0.1)
+        after = [ self.bytes_received(self.nodes[i]) for i in (1, 2) ]
+        return [ after[i] - before[i] for i in (0, 1) ], elapsed
+
+    def run_test(self):
+        # The masternode managers ignore messages until the tip is recent
+        self.nodes[0].setgenerate(True, 1)
+        self.sync_all()
+
+        # The same seed and clock give both nodes the same masternodes and votes;
+        # the traffic is not relayed, so node 2 only learns of it by syncing
+        now = int(time.time())
+        for i in (0, 1):
+            self.nodes[i].setmocktime(now)
+            result = self.nodes[i].mnsimulate(SIMULATED_MASTERNODES, SIMULATED_PROPOSALS, 0, True, SIMULATION_SEED)
+            assert_equal(result["mnb"]["accepted"], SIMULATED_MASTERNODES)
+            self.nodes[i].setmocktime(0)
+        assert_equal(len(self.nodes[0].listmasternodes()), SIMULATED_MASTERNODES)
+        assert_equal(self.nodes[1].listmasternodes(), self.nodes[0].listmasternodes())
+
+        rounds = 2
+        total_bytes = [ 0, 0 ]
+        total_time = [ 0.0, 0.0 ]
+        for r in range(rounds):
+            size, elapsed = self.resync()
+            for i in (0, 1):
+                total_bytes[i] += size[i]
+                total_time[i] += elapsed[i]
+
+        print "Digest sync: %d bytes, %.1f s" % (total_bytes[0] / rounds, total_time[0] / rounds)
+        print "Full sync:   %d bytes, %.1f s" % (total_bytes[1] / rounds, total_time[1] / rounds)
+
+        # Node 1 already had everything, so the digests spared it the entries
+        # and votes node 2 was sent
+        assert(total_bytes[0] < total_bytes[1])
+
+        for i in (1, 2):
+            assert_equal(self.nodes[i].mnsync("status")["RequestedMasternodeAssets"], MASTERNODE_SYNC_FINISHED)
+        assert_equal(len(self.nodes[1].listmasternodes()), SIMULATED_MASTERNODES)
+
+if __name__ == '__main__':
+    MasternodeSyncTest().main()
@@ -0,0 +1,63 @@
+#!/usr/bin/env python2
+# Copyright (c) 2014 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test wallet rescans: importing keys with a rescan must find both the
+# payments to them and the later spends from them, and -rescan on startup
+# must rebuild the same wallet state.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+
+class RescanTest(BitcoinTestFramework):
+
+    def setup_network(self):
+        self.nodes = start_nodes(3, self.options.tmpdir)
+        connect_nodes_bi(self.nodes, 0, 1)
+        connect_nodes_bi(self.nodes, 0, 2)
+        self.is_network_split = False
+        self.sync_all()
+
+    def unspent_at(self, node, addresses):
+        return sorted((u['txid'], u['vout'], u['amount']) for u in node.listunspent(0) if u['address'] in addresses)
+
+    def run_test(self):
+        addresses = [ self.nodes[1].getnewaddress() for i in range(5) ]
+
+        # Payments to node 1 spread over several blocks
+        for i, address in enumerate(addresses):
+            self.nodes[0].sendtoaddress(address, i + 1)
+            if i % 2 == 0:
+                self.nodes[0].setgenerate(True, 1)
+        self.nodes[0].setgenerate(True, 1)
+        self.sync_all()
+
+        # Spend one of them back to node 0
+        utxo = [ u for u in self.nodes[1].listunspent(0) if u['address'] == addresses[-1] ][0]
+        rawtx = self.nodes[1].createrawtransaction([ { "txid" : utxo['txid'], "vout" : utxo['vout'] } ],
+                                                   { self.nodes[0].getnewaddress() : utxo['amount'] - Decimal('0.01') })
+        self.nodes[1].sendrawtransaction(self.nodes[1].signrawtransaction(rawtx)['hex'])
+        self.sync_all()
+        self.nodes[0].setgenerate(True, 1)
+        self.sync_all()
+
+        expected = self.unspent_at(self.nodes[1], addresses)
+        assert_equal(len(expected), len(addresses) - 1)
+
+        for address in addresses[:-1]:
+            self.nodes[2].importprivkey(self.nodes[1].dumpprivkey(address), "", False)
+        self.nodes[2].importprivkey(self.nodes[1].dumpprivkey(addresses[-1]))
+        assert_equal(self.unspent_at(self.nodes[2], addresses), expected)
+        balance = self.nodes[2].getbalance()
+
+        # A full rescan on startup ends up in the same place
+        stop_node(self.nodes[2], 2)
+        self.nodes[2] = start_node(2, self.options.tmpdir, ["-rescan"])
+        assert_equal(self.unspent_at(self.nodes[2], addresses), expected)
+        assert_equal(self.nodes[2].getbalance(), balance)
+
+if __name__ == '__main__':
+    RescanTest().main()
@@ -0,0 +1,101 @@
+#!/usr/bin/env python2
+# Copyright (c) 2015 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test the ZMQ publisher: every notification arrives as one complete
+# three part message (topic, body, sequence number), sequence numbers
+# count up without gaps per notifier, rawblock carries the block as
+# stored, and getzmqnotifications reports no failures.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+import binascii
+import struct
+import sys
+import time
+
+try:
+    import zmq
+except ImportError:
+    zmq = None
+
+class ZMQPublishTest(BitcoinTestFramework):
+
+    port = 28332
+
+    def setup_network(self):
+        address = "tcp://127.0.0.1:%i" % self.port
+        self.nodes = []
+        # All three notifiers share one socket
+        self.nodes.append(start_node(0, self.options.tmpdir, ["-debug=zmq",
+            "-zmqpubhashblock=" + address, "-zmqpubrawblock=" + address, "-zmqpubhashtx=" + address]))
+        self.is_network_split = False
+
+        self.zmqContext = zmq.Context()
+        self.zmqSubSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqSubSocket.setsockopt(zmq.RCVTIMEO, 60000)
+        for topic in [b"hashblock", b"rawblock", b"hashtx"]:
+            self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, topic)
+        self.zmqSubSocket.connect(address)
+        # give the subscription time to reach the publisher
+        time.sleep(1)
+
+    def receive(self):
+        msg = self.zmqSubSocket.recv_multipart()
+        assert_equal(len(msg), 3)
+        assert_equal(len(msg[2]), 4)
+        topic, body, seq = msg[0], msg[1], struct.unpack("<I", msg[2])[0]
+        # sequence numbers are per notifier and have no gaps
+        if topic in self.sequences:
+            assert_equal(seq, self.sequences[topic] + 1)
+        self.sequences[topic] = seq
+        return topic, body
+
+    def run_test(self):
+        self.sequences = {}
+        node = self.nodes[0]
+
+        n = 5
+        hashes = node.setgenerate(True, n)
+        # hashblock, rawblock and hashtx of a block may interleave in any order
+        received = { b"hashblock": [], b"rawblock": [], b"hashtx": [] }
+        for i in range(n * 3):
+            topic, body = self.receive()
+            received[topic].append(binascii.hexlify(body))
+        txs = received[b"hashtx"]
+
+        assert_equal(received[b"hashblock"], hashes)
+        assert_equal(received[b"rawblock"], [ node.getblock(h, False) for h in hashes ])
+        # one coinbase per block
+        for h in hashes:
+            assert(node.getblock(h)['tx'][0] in txs)
+
+        txid = node.sendtoaddress(node.getnewaddress(), 1.0)
+        topic, body = self.receive()
+        assert_equal(topic, b"hashtx")
+        assert_equal(binascii.hexlify(body), txid)
+
+        stats = node.getzmqnotifications()
+        assert_equal(stats['queue']['size'], 0)
+        assert_equal(stats['queue']['dropped'], 0)
+        published = {}
+        for notifier in stats['notifiers']:
+            assert(notifier['enabled'])
+            assert_equal(notifier['failed'], 0)
+            assert_equal(notifier['dropped'], 0)
+            published[notifier['type']] = notifier['published']
+        assert_equal(published['pubhashblock'], n)
+        assert_equal(published['pubrawblock'], n)
+        assert_equal(published['pubhashtx'], n + 1)
+
+        self.zmqSubSocket.close()
+        self.zmqContext.term()
+
+if __name__ == '__main__':
+    if zmq is None:
+        print("python-zmq is not installed, skipping")
+        sys.exit(0)
+    ZMQPublishTest().main()
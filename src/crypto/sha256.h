@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-256. */
 class CSHA256
@@ -25,4 +26,16 @@ public:
     CSHA256& Reset();
 };
 
+/** Autodetect the best available SHA256 implementation and switch to it.
+ *  Returns a description of the implementations in use. Call this once at
+ *  startup, before any other thread hashes. */
+std::string SHA256AutoDetect();
+
+/** Compute the double-SHA256 of each of a number of 64-byte inputs.
+ *  out:    blocks * 32 bytes of output
+ *  in:     blocks * 64 bytes of input
+ *  blocks: the number of hashes to compute
+ */
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
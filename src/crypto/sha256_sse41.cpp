@@ -0,0 +1,137 @@
+// Copyright (c) 2017 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Double-SHA256 of four 64-byte inputs at once, one per SSE4.1 lane.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "crypto/common.h"
+
+namespace sha256d64_sse41
+{
+namespace
+{
+static const uint32_t K[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul};
+
+static const uint32_t IV[8] = {
+    0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul};
+
+typedef __m128i Vec;
+
+/** The number of independent inputs hashed side by side. */
+static const int WAYS = 4;
+
+Vec inline K32(uint32_t x) { return _mm_set1_epi32(x); }
+Vec inline Add(Vec x, Vec y) { return _mm_add_epi32(x, y); }
+Vec inline Add(Vec x, Vec y, Vec z) { return Add(Add(x, y), z); }
+Vec inline Add(Vec x, Vec y, Vec z, Vec w) { return Add(Add(x, y), Add(z, w)); }
+Vec inline Add(Vec x, Vec y, Vec z, Vec w, Vec v) { return Add(Add(x, y, z), Add(w, v)); }
+Vec inline Xor(Vec x, Vec y) { return _mm_xor_si128(x, y); }
+Vec inline Xor(Vec x, Vec y, Vec z) { return Xor(Xor(x, y), z); }
+Vec inline Or(Vec x, Vec y) { return _mm_or_si128(x, y); }
+Vec inline And(Vec x, Vec y) { return _mm_and_si128(x, y); }
+Vec inline ShR(Vec x, int n) { return _mm_srli_epi32(x, n); }
+Vec inline ShL(Vec x, int n) { return _mm_slli_epi32(x, n); }
+Vec inline RotR(Vec x, int n) { return Or(ShR(x, n), ShL(x, 32 - n)); }
+
+Vec inline Ch(Vec x, Vec y, Vec z) { return Xor(z, And(x, Xor(y, z))); }
+Vec inline Maj(Vec x, Vec y, Vec z) { return Or(And(x, y), And(z, Or(x, y))); }
+Vec inline Sigma0(Vec x) { return Xor(RotR(x, 2), RotR(x, 13), RotR(x, 22)); }
+Vec inline Sigma1(Vec x) { return Xor(RotR(x, 6), RotR(x, 11), RotR(x, 25)); }
+Vec inline sigma0(Vec x) { return Xor(RotR(x, 7), RotR(x, 18), ShR(x, 3)); }
+Vec inline sigma1(Vec x) { return Xor(RotR(x, 17), RotR(x, 19), ShR(x, 10)); }
+
+/** Run the 64 rounds on state s with message w (clobbered), and add the result to s. */
+void inline Transform(Vec* s, Vec* w)
+{
+    Vec a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16)
+            w[i & 15] = Add(w[i & 15], sigma1(w[(i + 14) & 15]), w[(i + 9) & 15], sigma0(w[(i + 1) & 15]));
+        Vec t1 = Add(h, Sigma1(e), Ch(e, f, g), K32(K[i]), w[i & 15]);
+        Vec t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = Add(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = Add(t1, t2);
+    }
+    s[0] = Add(s[0], a);
+    s[1] = Add(s[1], b);
+    s[2] = Add(s[2], c);
+    s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e);
+    s[5] = Add(s[5], f);
+    s[6] = Add(s[6], g);
+    s[7] = Add(s[7], h);
+}
+
+/** Load big-endian word i of each of the inputs, which are 64 bytes apart. */
+Vec inline Read(const unsigned char* in, int i)
+{
+    return _mm_setr_epi32(
+        ReadBE32(in + 4 * i),
+        ReadBE32(in + 64 + 4 * i),
+        ReadBE32(in + 128 + 4 * i),
+        ReadBE32(in + 192 + 4 * i));
+}
+
+/** Store each lane of the state words as the inputs' 32-byte big-endian digests. */
+void inline Write(unsigned char* out, const Vec* s)
+{
+    uint32_t lanes[WAYS];
+    for (int i = 0; i < 8; i++) {
+        _mm_storeu_si128((Vec*)lanes, s[i]);
+        for (int j = 0; j < WAYS; j++)
+            WriteBE32(out + 32 * j + 4 * i, lanes[j]);
+    }
+}
+} // namespace
+
+void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    Vec s[8], t[8], w[16];
+
+    // First hash: the 64-byte input, then a block holding only padding
+    for (int i = 0; i < 8; i++)
+        s[i] = K32(IV[i]);
+    for (int i = 0; i < 16; i++)
+        w[i] = Read(in, i);
+    Transform(s, w);
+    for (int i = 0; i < 16; i++)
+        w[i] = K32(0);
+    w[0] = K32(0x80000000ul);
+    w[15] = K32(512);
+    Transform(s, w);
+
+    // Second hash: the 32-byte first digest and its padding, in a single block
+    for (int i = 0; i < 8; i++) {
+        w[i] = s[i];
+        t[i] = K32(IV[i]);
+    }
+    for (int i = 8; i < 16; i++)
+        w[i] = K32(0);
+    w[8] = K32(0x80000000ul);
+    w[15] = K32(256);
+    Transform(t, w);
+
+    Write(out, t);
+}
+} // namespace sha256d64_sse41
+
+#endif
@@ -0,0 +1,71 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_EXPIRYINDEX_H
+#define BITCOIN_EXPIRYINDEX_H
+
+#include "memusage.h"
+
+#include <map>
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * Index of the keys of a map by the time (or height) they expire at, in
+ * buckets of nBucketSize, so a sweep only touches the buckets that are due
+ * instead of every entry of the map.
+ *
+ * Entries are never removed from the index when they are erased from the map
+ * or their time moves on: Expire() hands out every key of a due bucket and the
+ * caller checks the entry still exists and is due, and Add()s it again if not.
+ */
+template <typename K>
+class CExpiryIndex
+{
+private:
+    std::map<int64_t, std::vector<K> > mapBuckets;
+    int64_t nBucketSize;
+    size_t nKeys;
+
+public:
+    CExpiryIndex(int64_t nBucketSizeIn) : nBucketSize(nBucketSizeIn), nKeys(0) {}
+
+    /** Index a key that expires at nTime */
+    void Add(const K& key, int64_t nTime)
+    {
+        mapBuckets[nTime / nBucketSize].push_back(key);
+        nKeys++;
+    }
+
+    /** Remove the buckets of keys that expire before nTime and append their keys to vKeys */
+    void Expire(int64_t nTime, std::vector<K>& vKeys)
+    {
+        // a bucket is due once all the times it covers are
+        typename std::map<int64_t, std::vector<K> >::iterator itEnd = mapBuckets.lower_bound(nTime / nBucketSize);
+        for (typename std::map<int64_t, std::vector<K> >::iterator it = mapBuckets.begin(); it != itEnd; ++it) {
+            vKeys.insert(vKeys.end(), it->second.begin(), it->second.end());
+            nKeys -= it->second.size();
+        }
+        mapBuckets.erase(mapBuckets.begin(), itEnd);
+    }
+
+    void Clear()
+    {
+        mapBuckets.clear();
+        nKeys = 0;
+    }
+
+    size_t size() const { return nKeys; }
+
+    size_t DynamicMemoryUsage() const
+    {
+        size_t nUsage = memusage::DynamicUsage(mapBuckets);
+        for (typename std::map<int64_t, std::vector<K> >::const_iterator it = mapBuckets.begin(); it != mapBuckets.end(); ++it)
+            nUsage += memusage::DynamicUsage(it->second);
+        return nUsage;
+    }
+};
+
+#endif // BITCOIN_EXPIRYINDEX_H
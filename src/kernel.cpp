@@ -373,8 +373,11 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake)
     // First try finding the previous transaction in database
     uint256 hashBlock;
     CTransaction txPrev;
-    if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
+    if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true)) {
+        if (IsTransactionBlockPruned(txin.prevout.hash))
+            return error("CheckProofOfStake() : the block holding stake input %s has been pruned, the kernel cannot be checked", txin.prevout.hash.ToString());
         return error("CheckProofOfStake() : INFO: read txPrev failed");
+    }
 
     //verify signature and script
     if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
@@ -387,10 +390,8 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake)
     else
         return error("CheckProofOfStake() : read block failed");
 
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos()))
-        return error("CheckProofOfStake(): INFO: failed to find block");
+    // Read block header (from the index, so that the block data itself may have been pruned)
+    CBlock blockprev(pindex->GetBlockHeader());
 
     unsigned int nInterval = 0;
     unsigned int nTime = block.nTime;
@@ -12,8 +12,10 @@
 #include "masternode-sync.h"
 #include "masternode.h"
 #include "masternodeman.h"
+#include "memusage.h"
 #include "obfuscation.h"
 #include "util.h"
+#include "validationinterface.h"
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -96,6 +98,16 @@ bool IsBudgetCollateralValid(uint256 nTxCollateralHash, uint256 nExpectedHash, s
     }
 }
 
+bool IsBudgetCollateralCandidate(const CTransaction& tx)
+{
+    // Same shape IsBudgetCollateralValid looks for: OP_RETURN <32 byte hash> carrying the fee
+    BOOST_FOREACH (const CTxOut& o, tx.vout) {
+        if (o.nValue < std::min(PROPOSAL_FEE_TX, BUDGET_FEE_TX)) continue;
+        if (o.scriptPubKey.size() == 34 && o.scriptPubKey[0] == OP_RETURN && o.scriptPubKey[1] == 32) return true;
+    }
+    return false;
+}
+
 void CBudgetManager::CheckOrphanVotes()
 {
     LOCK(cs);
@@ -230,159 +242,22 @@ void CBudgetManager::SubmitFinalBudget()
     LogPrintf("CBudgetManager::SubmitFinalBudget - Done! %s\n", finalizedBudgetBroadcast.GetHash().ToString());
 }
 
-//
-// CBudgetDB
-//
-
-CBudgetDB::CBudgetDB()
-{
-    pathDB = GetDataDir() / "budget.dat";
-    strMagicMessage = "MasternodeBudget";
-}
-
-bool CBudgetDB::Write(const CBudgetManager& objToSave)
-{
-    LOCK(objToSave.cs);
-
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // masternode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
-
-    LogPrintf("Written info to budget.dat  %dms\n", GetTimeMillis() - nStart);
-
-    return true;
-}
-
-CBudgetDB::ReadResult CBudgetDB::Read(CBudgetManager& objToLoad, bool fDryRun)
-{
-    LOCK(objToLoad.cs);
-
-    int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathDB.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathDB);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
-
-    CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
-
-
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
-    try {
-        // de-serialize file header (masternode cache file specific magic message) and ..
-        ssObj >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid masternode cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-
-        // de-serialize file header (network specific magic number) and ..
-        ssObj >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
-
-        // de-serialize data into CBudgetManager object
-        ssObj >> objToLoad;
-    } catch (std::exception& e) {
-        objToLoad.Clear();
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return IncorrectFormat;
-    }
-
-    LogPrintf("Loaded info from budget.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrintf("  %s\n", objToLoad.ToString());
-    if (!fDryRun) {
-        LogPrintf("Budget manager - cleaning....\n");
-        objToLoad.CheckAndRemove();
-        LogPrintf("Budget manager - result:\n");
-        LogPrintf("  %s\n", objToLoad.ToString());
-    }
-
-    return Ok;
-}
+/** The budget on disk */
+CMasternodeCacheDB* pbudgetdb = NULL;
 
 void DumpBudgets()
 {
-    int64_t nStart = GetTimeMillis();
+    if (!pbudgetdb)
+        return;
 
-    CBudgetDB budgetdb;
-    CBudgetManager tempBudget;
-
-    LogPrintf("Verifying budget.dat format...\n");
-    CBudgetDB::ReadResult readResult = budgetdb.Read(tempBudget, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CBudgetDB::FileError)
-        LogPrintf("Missing budgets file - budget.dat, will try to recreate\n");
-    else if (readResult != CBudgetDB::Ok) {
-        LogPrintf("Error reading budget.dat: ");
-        if (readResult == CBudgetDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
+    int64_t nStart = GetTimeMillis();
+    unsigned int nWritten, nErased;
+    if (!budget.WriteCache(*pbudgetdb, nWritten, nErased)) {
+        LogPrintf("Error writing the budget cache\n");
+        return;
     }
-    LogPrintf("Writting info to budget.dat...\n");
-    budgetdb.Write(budget);
 
-    LogPrintf("Budget dump finished  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("Budget dump finished: %u records written, %u erased  %dms\n", nWritten, nErased, GetTimeMillis() - nStart);
 }
 
 bool CBudgetManager::AddFinalizedBudget(CFinalizedBudget& finalizedBudget)
@@ -411,11 +286,25 @@ bool CBudgetManager::AddProposal(CBudgetProposal& budgetProposal)
         return false;
     }
 
-    mapProposals.insert(make_pair(budgetProposal.GetHash(), budgetProposal));
+    uint256 nHash = budgetProposal.GetHash();
+    std::map<uint256, CBudgetProposal>::iterator it = mapProposals.insert(make_pair(nHash, budgetProposal)).first;
+    UpdateProposalRank(nHash, it->second);
     LogPrintf("CBudgetManager::AddProposal - proposal %s added\n", budgetProposal.GetName ().c_str ());
     return true;
 }
 
+void CBudgetManager::RemoveProposal(const uint256& nHash)
+{
+    LOCK(cs);
+
+    mapProposals.erase(nHash);
+    std::map<uint256, CProposalRank>::iterator it = mapProposalRank.find(nHash);
+    if (it != mapProposalRank.end()) {
+        setProposalRanking.erase(it->second);
+        mapProposalRank.erase(it);
+    }
+}
+
 void CBudgetManager::CheckAndRemove()
 {
     LogPrint("mnbudget", "CBudgetManager::CheckAndRemove\n");
@@ -643,10 +532,10 @@ std::vector<CBudgetProposal*> CBudgetManager::GetAllProposals()
 
     std::vector<CBudgetProposal*> vBudgetProposalRet;
 
+    CheckChangedVotes();
+
     std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin();
     while (it != mapProposals.end()) {
-        (*it).second.CleanAndRemove(false);
-
         CBudgetProposal* pbudgetProposal = &((*it).second);
         vBudgetProposalRet.push_back(pbudgetProposal);
 
@@ -656,35 +545,96 @@ std::vector<CBudgetProposal*> CBudgetManager::GetAllProposals()
     return vBudgetProposalRet;
 }
 
-//
-// Sort by votes, if there's a tie sort by their feeHash TX
-//
-struct sortProposalsByVotes {
-    bool operator()(const std::pair<CBudgetProposal*, int>& left, const std::pair<CBudgetProposal*, int>& right)
-    {
-        if (left.second != right.second)
-            return (left.second > right.second);
-        return (left.first->nFeeTXHash > right.first->nFeeTXHash);
-    }
-};
+void CBudgetManager::UpdateProposalRank(const uint256& nHash, CBudgetProposal& budgetProposal)
+{
+    CProposalRank rank;
+    rank.nNetYeas = budgetProposal.GetYeas() - budgetProposal.GetNays();
+    rank.nFeeTXHash = budgetProposal.nFeeTXHash;
+    rank.nProposalHash = nHash;
 
-//Need to review this function
-std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
+    std::map<uint256, CProposalRank>::iterator it = mapProposalRank.find(nHash);
+    if (it != mapProposalRank.end()) {
+        if (it->second.nNetYeas == rank.nNetYeas && it->second.nFeeTXHash == rank.nFeeTXHash)
+            return;
+        setProposalRanking.erase(it->second);
+        it->second = rank;
+    } else
+        mapProposalRank.insert(make_pair(nHash, rank));
+    setProposalRanking.insert(rank);
+}
+
+void CBudgetManager::MasternodeChanged(const CTxIn& vin)
 {
-    LOCK(cs);
+    LOCK(cs_changed);
+    setChangedMasternodes.insert(vin.prevout);
+}
 
-    // ------- Sort budgets by Yes Count
+void CBudgetManager::MasternodeListReset()
+{
+    LOCK(cs_changed);
+    setChangedMasternodes.clear();
+    fMasternodeListReset = true;
+}
 
-    std::vector<std::pair<CBudgetProposal*, int> > vBudgetPorposalsSort;
+void CBudgetManager::CheckChangedVotes()
+{
+    AssertLockHeld(cs);
+
+    std::set<COutPoint> setChanged;
+    bool fReset;
+    {
+        LOCK(cs_changed);
+        setChanged.swap(setChangedMasternodes);
+        fReset = fMasternodeListReset;
+        fMasternodeListReset = false;
+    }
+    if (!fReset && setChanged.empty()) return;
 
     std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin();
     while (it != mapProposals.end()) {
-        (*it).second.CleanAndRemove(false);
-        vBudgetPorposalsSort.push_back(make_pair(&((*it).second), (*it).second.GetYeas() - (*it).second.GetNays()));
+        if (fReset) {
+            (*it).second.CleanAndRemove(false);
+        } else {
+            BOOST_FOREACH (COutPoint prevout, setChanged)
+                (*it).second.CheckVote(prevout.GetHash(), false);
+        }
+        UpdateProposalRank((*it).first, (*it).second);
         ++it;
     }
+}
+
+std::vector<CBudgetProposal*> CBudgetManager::GetRankedProposals()
+{
+    LOCK(cs);
+
+    // votes are checked as they arrive, only those of masternodes that joined or left the list since need another look
+    CheckChangedVotes();
+
+    std::vector<CBudgetProposal*> vBudgetProposalsRanked;
+    std::set<CProposalRank>::iterator itRank = setProposalRanking.begin();
+    while (itRank != setProposalRanking.end()) {
+        std::map<uint256, CBudgetProposal>::iterator it = mapProposals.find(itRank->nProposalHash);
+        if (it == mapProposals.end()) {
+            // the proposals were replaced wholesale
+            mapProposalRank.erase(itRank->nProposalHash);
+            setProposalRanking.erase(itRank++);
+            continue;
+        }
+        vBudgetProposalsRanked.push_back(&((*it).second));
+        ++itRank;
+    }
 
-    std::sort(vBudgetPorposalsSort.begin(), vBudgetPorposalsSort.end(), sortProposalsByVotes());
+    return vBudgetProposalsRanked;
+}
+
+//Need to review this function
+std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
+{
+    LOCK(cs);
+
+    // ------- Sort budgets by Yes Count
+
+    std::vector<CBudgetProposal*> vBudgetPorposalsSort = GetRankedProposals();
 
     // ------- Grab The Budgets In Order
 
@@ -699,9 +649,9 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget()
     CAmount nTotalBudget = GetTotalBudget(nBlockStart);
 
 
-    std::vector<std::pair<CBudgetProposal*, int> >::iterator it2 = vBudgetPorposalsSort.begin();
+    std::vector<CBudgetProposal*>::iterator it2 = vBudgetPorposalsSort.begin();
     while (it2 != vBudgetPorposalsSort.end()) {
-        CBudgetProposal* pbudgetProposal = (*it2).first;
+        CBudgetProposal* pbudgetProposal = *it2;
 
         //prop start/end should be inside this period
         if (pbudgetProposal->fValid && pbudgetProposal->nBlockStart <= nBlockStart &&
@@ -877,11 +827,7 @@ void CBudgetManager::NewBlock()
     }
 
     LogPrintf("CBudgetManager::NewBlock - mapProposals cleanup - size: %d\n", mapProposals.size());
-    std::map<uint256, CBudgetProposal>::iterator it2 = mapProposals.begin();
-    while (it2 != mapProposals.end()) {
-        (*it2).second.CleanAndRemove(false);
-        ++it2;
-    }
+    CheckChangedVotes();
 
     LogPrintf("CBudgetManager::NewBlock - mapFinalizedBudgets cleanup - size: %d\n", mapFinalizedBudgets.size());
     std::map<uint256, CFinalizedBudget>::iterator it3 = mapFinalizedBudgets.begin();
@@ -970,6 +916,24 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         LogPrint("mnbudget", "mnvs - Sent Masternode votes to peer %i\n", pfrom->GetId());
     }
 
+    if (strCommand == "mnvsd") { //Masternode vote sync, for what the peer's digests show it is missing
+        std::map<uint256, uint256> mapProposalDigests;
+        std::map<uint256, uint256> mapBudgetDigests;
+        vRecv >> mapProposalDigests >> mapBudgetDigests;
+
+        if (Params().NetworkID() == CBaseChainParams::MAIN) {
+            if (pfrom->HasFulfilledRequest("mnvs")) {
+                LogPrintf("mnvsd - peer already asked me for the list\n");
+                Misbehaving(pfrom->GetId(), 20);
+                return;
+            }
+            pfrom->FulfilledRequest("mnvs");
+        }
+
+        Sync(pfrom, 0, false, &mapProposalDigests, &mapBudgetDigests);
+        LogPrint("mnbudget", "mnvsd - Sent Masternode votes to peer %i\n", pfrom->GetId());
+    }
+
     if (strCommand == "mprop") { //Masternode Proposal
         CBudgetProposalBroadcast budgetProposalBroadcast;
         vRecv >> budgetProposalBroadcast;
@@ -1008,7 +972,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
     if (strCommand == "mvote") { //Masternode Vote
         CBudgetVote vote;
-        vRecv >> vote;
+        pfrom->ReadMessage(vRecv, vote);
         vote.fValid = true;
 
         if (mapSeenMasternodeBudgetVotes.count(vote.GetHash())) {
@@ -1035,7 +999,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         std::string strError = "";
         if (UpdateProposal(vote, pfrom, strError)) {
-            vote.Relay();
+            if (pfrom->fRelayMasternodeMessages) vote.Relay();
             masternodeSync.AddedBudgetItem(vote.GetHash());
         }
 
@@ -1081,7 +1045,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
     if (strCommand == "fbvote") { //Finalized Budget Vote
         CFinalizedBudgetVote vote;
-        vRecv >> vote;
+        pfrom->ReadMessage(vRecv, vote);
         vote.fValid = true;
 
         if (mapSeenFinalizedBudgetVotes.count(vote.GetHash())) {
@@ -1107,7 +1071,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
         std::string strError = "";
         if (UpdateFinalizedBudget(vote, pfrom, strError)) {
-            vote.Relay();
+            if (pfrom->fRelayMasternodeMessages) vote.Relay();
             masternodeSync.AddedBudgetItem(vote.GetHash());
 
             LogPrintf("fbvote - new finalized budget vote - %s\n", vote.GetHash().ToString());
@@ -1198,7 +1162,7 @@ void CBudgetManager::MarkSynced()
 }
 
 
-void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
+void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial, const std::map<uint256, uint256>* pmapProposalDigests, const std::map<uint256, uint256>* pmapBudgetDigests)
 {
     LOCK(cs);
 
@@ -1210,23 +1174,34 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
         This code checks each of the hash maps for all known budget proposals and finalized budget proposals, then checks them against the
         budget object to see if they're OK. If all checks pass, we'll send it to the peer.
 
+        With the peer's digests, proposals and budgets it has are not sent, and their votes
+        only if the digest of the peer's votes differs from ours. The counts still cover
+        everything, so the peer can tell an empty budget from one it has in full.
+
     */
 
     int nInvCount = 0;
+    std::vector<CInv> vInv;
 
     std::map<uint256, CBudgetProposalBroadcast>::iterator it1 = mapSeenMasternodeBudgetProposals.begin();
     while (it1 != mapSeenMasternodeBudgetProposals.end()) {
         CBudgetProposal* pbudgetProposal = FindProposal((*it1).first);
         if (pbudgetProposal && pbudgetProposal->fValid && (nProp == 0 || (*it1).first == nProp)) {
-            pfrom->PushInventory(CInv(MSG_BUDGET_PROPOSAL, (*it1).second.GetHash()));
+            std::map<uint256, uint256>::const_iterator itDigest;
+            bool fPeerHas = pmapProposalDigests && (itDigest = pmapProposalDigests->find((*it1).first)) != pmapProposalDigests->end();
+            if (!fPeerHas)
+                vInv.push_back(CInv(MSG_BUDGET_PROPOSAL, (*it1).second.GetHash()));
             nInvCount++;
 
+            bool fSendVotes = !fPeerHas || itDigest->second != pbudgetProposal->GetVoteDigest();
+
             //send votes
             std::map<uint256, CBudgetVote>::iterator it2 = pbudgetProposal->mapVotes.begin();
             while (it2 != pbudgetProposal->mapVotes.end()) {
                 if ((*it2).second.fValid) {
                     if ((fPartial && !(*it2).second.fSynced) || !fPartial) {
-                        pfrom->PushInventory(CInv(MSG_BUDGET_VOTE, (*it2).second.GetHash()));
+                        if (fSendVotes)
+                            vInv.push_back(CInv(MSG_BUDGET_VOTE, (*it2).second.GetHash()));
                         nInvCount++;
                     }
                 }
@@ -1236,6 +1211,9 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
         ++it1;
     }
 
+    // the counts follow the items, so the peer knows it has all of them
+    pfrom->PushInventoryNow(vInv);
+    vInv.clear();
     pfrom->PushMessage("ssc", MASTERNODE_SYNC_BUDGET_PROP, nInvCount);
 
     LogPrint("mnbudget", "CBudgetManager::Sync - sent %d items\n", nInvCount);
@@ -1246,15 +1224,21 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
     while (it3 != mapSeenFinalizedBudgets.end()) {
         CFinalizedBudget* pfinalizedBudget = FindFinalizedBudget((*it3).first);
         if (pfinalizedBudget && pfinalizedBudget->fValid && (nProp == 0 || (*it3).first == nProp)) {
-            pfrom->PushInventory(CInv(MSG_BUDGET_FINALIZED, (*it3).second.GetHash()));
+            std::map<uint256, uint256>::const_iterator itDigest;
+            bool fPeerHas = pmapBudgetDigests && (itDigest = pmapBudgetDigests->find((*it3).first)) != pmapBudgetDigests->end();
+            if (!fPeerHas)
+                vInv.push_back(CInv(MSG_BUDGET_FINALIZED, (*it3).second.GetHash()));
             nInvCount++;
 
+            bool fSendVotes = !fPeerHas || itDigest->second != pfinalizedBudget->GetVoteDigest();
+
             //send votes
             std::map<uint256, CFinalizedBudgetVote>::iterator it4 = pfinalizedBudget->mapVotes.begin();
             while (it4 != pfinalizedBudget->mapVotes.end()) {
                 if ((*it4).second.fValid) {
                     if ((fPartial && !(*it4).second.fSynced) || !fPartial) {
-                        pfrom->PushInventory(CInv(MSG_BUDGET_FINALIZED_VOTE, (*it4).second.GetHash()));
+                        if (fSendVotes)
+                            vInv.push_back(CInv(MSG_BUDGET_FINALIZED_VOTE, (*it4).second.GetHash()));
                         nInvCount++;
                     }
                 }
@@ -1264,10 +1248,47 @@ void CBudgetManager::Sync(CNode* pfrom, uint256 nProp, bool fPartial)
         ++it3;
     }
 
+    pfrom->PushInventoryNow(vInv);
     pfrom->PushMessage("ssc", MASTERNODE_SYNC_BUDGET_FIN, nInvCount);
     LogPrint("mnbudget", "CBudgetManager::Sync - sent %d items\n", nInvCount);
 }
 
+void CBudgetManager::RequestSync(CNode* pnode)
+{
+    if (masternodeSync.UseDigests(pnode)) {
+        std::map<uint256, uint256> mapProposalDigests;
+        std::map<uint256, uint256> mapBudgetDigests;
+        GetVoteDigests(mapProposalDigests, mapBudgetDigests);
+        pnode->PushMessage("mnvsd", mapProposalDigests, mapBudgetDigests);
+    } else {
+        uint256 n = 0;
+        pnode->PushMessage("mnvs", n);
+    }
+}
+
+void CBudgetManager::GetMemoryUsage(std::map<std::string, std::pair<size_t, size_t> >& mapUsage) const
+{
+    LOCK(cs);
+    mapUsage["mapProposals"] = std::make_pair(mapProposals.size(), memusage::DynamicUsage(mapProposals));
+    mapUsage["mapFinalizedBudgets"] = std::make_pair(mapFinalizedBudgets.size(), memusage::DynamicUsage(mapFinalizedBudgets));
+    mapUsage["mapSeenMasternodeBudgetProposals"] = std::make_pair(mapSeenMasternodeBudgetProposals.size(), memusage::DynamicUsage(mapSeenMasternodeBudgetProposals));
+    mapUsage["mapSeenMasternodeBudgetVotes"] = std::make_pair(mapSeenMasternodeBudgetVotes.size(), memusage::DynamicUsage(mapSeenMasternodeBudgetVotes));
+    mapUsage["mapOrphanMasternodeBudgetVotes"] = std::make_pair(mapOrphanMasternodeBudgetVotes.size(), memusage::DynamicUsage(mapOrphanMasternodeBudgetVotes));
+    mapUsage["mapSeenFinalizedBudgets"] = std::make_pair(mapSeenFinalizedBudgets.size(), memusage::DynamicUsage(mapSeenFinalizedBudgets));
+    mapUsage["mapSeenFinalizedBudgetVotes"] = std::make_pair(mapSeenFinalizedBudgetVotes.size(), memusage::DynamicUsage(mapSeenFinalizedBudgetVotes));
+    mapUsage["mapOrphanFinalizedBudgetVotes"] = std::make_pair(mapOrphanFinalizedBudgetVotes.size(), memusage::DynamicUsage(mapOrphanFinalizedBudgetVotes));
+}
+
+void CBudgetManager::GetVoteDigests(std::map<uint256, uint256>& mapProposalDigests, std::map<uint256, uint256>& mapBudgetDigests)
+{
+    LOCK(cs);
+
+    for (std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin(); it != mapProposals.end(); ++it)
+        mapProposalDigests[(*it).first] = (*it).second.GetVoteDigest();
+    for (std::map<uint256, CFinalizedBudget>::iterator it = mapFinalizedBudgets.begin(); it != mapFinalizedBudgets.end(); ++it)
+        mapBudgetDigests[(*it).first] = (*it).second.GetVoteDigest();
+}
+
 bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string& strError)
 {
     LOCK(cs);
@@ -1292,7 +1313,12 @@ bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string
     }
 
 
-    return mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError);
+    if (!mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError))
+        return false;
+    UpdateProposalRank(vote.nProposalHash, mapProposals[vote.nProposalHash]);
+
+    GetMainSignals().NotifyBudgetVote(vote);
+    return true;
 }
 
 bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError)
@@ -1318,7 +1344,11 @@ bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pf
         return false;
     }
 
-    return mapFinalizedBudgets[vote.nBudgetHash].AddOrUpdateVote(vote, strError);
+    if (!mapFinalizedBudgets[vote.nBudgetHash].AddOrUpdateVote(vote, strError))
+        return false;
+
+    GetMainSignals().NotifyFinalizedBudgetVote(vote);
+    return true;
 }
 
 CBudgetProposal::CBudgetProposal()
@@ -1329,6 +1359,7 @@ CBudgetProposal::CBudgetProposal()
     nAmount = 0;
     nTime = 0;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strURLIn, int nBlockStartIn, int nBlockEndIn, CScript addressIn, CAmount nAmountIn, uint256 nFeeTXHashIn)
@@ -1341,6 +1372,7 @@ CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strU
     nAmount = nAmountIn;
     nFeeTXHash = nFeeTXHashIn;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
@@ -1354,6 +1386,11 @@ CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
     nTime = other.nTime;
     nFeeTXHash = other.nFeeTXHash;
     mapVotes = other.mapVotes;
+    nYeas = other.nYeas;
+    nNays = other.nNays;
+    nAbstains = other.nAbstains;
+    nAllYeas = other.nAllYeas;
+    nAllNays = other.nAllNays;
     fValid = true;
 }
 
@@ -1455,7 +1492,13 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
         return false;
     }
 
-    mapVotes[hash] = vote;
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.find(hash);
+    if (it != mapVotes.end()) {
+        TallyVote(it->second, -1);
+        it->second = vote;
+    } else
+        mapVotes[hash] = vote;
+    TallyVote(vote, 1);
     return true;
 }
 
@@ -1465,66 +1508,67 @@ void CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
-        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
+        CheckVote((*it).first, fSignatureCheck);
         ++it;
     }
 }
 
-double CBudgetProposal::GetRatio()
+bool CBudgetProposal::CheckVote(const uint256& hash, bool fSignatureCheck)
 {
-    int yeas = 0;
-    int nays = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.find(hash);
+    if (it == mapVotes.end()) return false;
 
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES) yeas++;
-        if ((*it).second.nVote == VOTE_NO) nays++;
-        ++it;
-    }
+    bool fValidVote = (*it).second.SignatureValid(fSignatureCheck);
+    if (fValidVote == (*it).second.fValid) return false;
 
-    if (yeas + nays == 0) return 0.0f;
-
-    return ((double)(yeas) / (double)(yeas + nays));
+    TallyVote((*it).second, -1);
+    (*it).second.fValid = fValidVote;
+    TallyVote((*it).second, 1);
+    return true;
 }
 
-int CBudgetProposal::GetYeas()
+uint256 CBudgetProposal::GetVoteDigest()
 {
-    int ret = 0;
+    uint256 hash = 0;
+    for (std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin(); it != mapVotes.end(); ++it)
+        if ((*it).second.fValid)
+            hash ^= (*it).second.GetHash();
+    return hash;
+}
 
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES && (*it).second.fValid) ret++;
-        ++it;
+void CBudgetProposal::TallyVote(const CBudgetVote& vote, int nDelta)
+{
+    if (vote.nVote == VOTE_YES) {
+        nAllYeas += nDelta;
+        if (vote.fValid) nYeas += nDelta;
+    } else if (vote.nVote == VOTE_NO) {
+        nAllNays += nDelta;
+        if (vote.fValid) nNays += nDelta;
+    } else if (vote.nVote == VOTE_ABSTAIN) {
+        if (vote.fValid) nAbstains += nDelta;
     }
-
-    return ret;
 }
 
-int CBudgetProposal::GetNays()
+void CBudgetProposal::RecountVotes()
 {
-    int ret = 0;
+    nYeas = 0;
+    nNays = 0;
+    nAbstains = 0;
+    nAllYeas = 0;
+    nAllNays = 0;
 
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
     while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_NO && (*it).second.fValid) ret++;
+        TallyVote((*it).second, 1);
         ++it;
     }
-
-    return ret;
 }
 
-int CBudgetProposal::GetAbstains()
+double CBudgetProposal::GetRatio()
 {
-    int ret = 0;
+    if (nAllYeas + nAllNays == 0) return 0.0f;
 
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_ABSTAIN && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    return ((double)(nAllYeas) / (double)(nAllYeas + nAllNays));
 }
 
 int CBudgetProposal::GetBlockStartCycle()
@@ -1620,7 +1664,7 @@ bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     CKey keyCollateralAddress;
 
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrintf("CBudgetVote::Sign - Error upon calling SignMessage");
@@ -1635,10 +1679,15 @@ bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     return true;
 }
 
+std::string CBudgetVote::GetSignatureMessage() const
+{
+    return vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+}
+
 bool CBudgetVote::SignatureValid(bool fSignatureCheck)
 {
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     CMasternode* pmn = mnodeman.Find(vin);
 
@@ -1799,6 +1848,15 @@ void CFinalizedBudget::CleanAndRemove(bool fSignatureCheck)
     }
 }
 
+uint256 CFinalizedBudget::GetVoteDigest()
+{
+    uint256 hash = 0;
+    for (std::map<uint256, CFinalizedBudgetVote>::iterator it = mapVotes.begin(); it != mapVotes.end(); ++it)
+        if ((*it).second.fValid)
+            hash ^= (*it).second.GetHash();
+    return hash;
+}
+
 
 CAmount CFinalizedBudget::GetTotalPayout()
 {
@@ -2050,7 +2108,7 @@ bool CFinalizedBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     CKey keyCollateralAddress;
 
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrintf("CFinalizedBudgetVote::Sign - Error upon calling SignMessage");
@@ -2065,11 +2123,16 @@ bool CFinalizedBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     return true;
 }
 
+std::string CFinalizedBudgetVote::GetSignatureMessage() const
+{
+    return vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+}
+
 bool CFinalizedBudgetVote::SignatureValid(bool fSignatureCheck)
 {
     std::string errorMessage;
 
-    std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetSignatureMessage();
 
     CMasternode* pmn = mnodeman.Find(vin);
 
@@ -2096,3 +2159,75 @@ std::string CBudgetManager::ToString() const
 
     return info.str();
 }
+
+bool CBudgetManager::WriteCache(CMasternodeCacheDB& db, unsigned int& nWritten, unsigned int& nErased)
+{
+    LOCK(cs);
+
+    db.WriteRecords('P', mapSeenMasternodeBudgetProposals);
+    db.WriteRecords('V', mapSeenMasternodeBudgetVotes);
+    db.WriteRecords('F', mapSeenFinalizedBudgets);
+    db.WriteRecords('W', mapSeenFinalizedBudgetVotes);
+    db.WriteRecords('O', mapOrphanMasternodeBudgetVotes);
+    db.WriteRecords('Q', mapOrphanFinalizedBudgetVotes);
+
+    // Votes are records of their own, so a new vote doesn't rewrite the
+    // proposal or budget it is for
+    for (map<uint256, CBudgetProposal>::iterator it = mapProposals.begin(); it != mapProposals.end(); ++it) {
+        CBudgetProposal proposal(it->second);
+        proposal.mapVotes.clear();
+        db.WriteRecord('p', it->first, proposal);
+        for (map<uint256, CBudgetVote>::iterator itVote = it->second.mapVotes.begin(); itVote != it->second.mapVotes.end(); ++itVote)
+            db.WriteRecord('v', make_pair(it->first, itVote->first), itVote->second);
+    }
+    for (map<uint256, CFinalizedBudget>::iterator it = mapFinalizedBudgets.begin(); it != mapFinalizedBudgets.end(); ++it) {
+        CFinalizedBudget finalizedBudget(it->second);
+        finalizedBudget.mapVotes.clear();
+        db.WriteRecord('f', it->first, finalizedBudget);
+        for (map<uint256, CFinalizedBudgetVote>::iterator itVote = it->second.mapVotes.begin(); itVote != it->second.mapVotes.end(); ++itVote)
+            db.WriteRecord('w', make_pair(it->first, itVote->first), itVote->second);
+    }
+
+    return db.Commit(nWritten, nErased);
+}
+
+bool CBudgetManager::ReadCache(CMasternodeCacheDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+    map<pair<uint256, uint256>, CBudgetVote> mapProposalVotes;
+    map<pair<uint256, uint256>, CFinalizedBudgetVote> mapFinalizedBudgetVotes;
+
+    LOCK(cs);
+    bool fOk = db.ReadRecords('P', mapSeenMasternodeBudgetProposals);
+    fOk &= db.ReadRecords('V', mapSeenMasternodeBudgetVotes);
+    fOk &= db.ReadRecords('F', mapSeenFinalizedBudgets);
+    fOk &= db.ReadRecords('W', mapSeenFinalizedBudgetVotes);
+    fOk &= db.ReadRecords('O', mapOrphanMasternodeBudgetVotes);
+    fOk &= db.ReadRecords('Q', mapOrphanFinalizedBudgetVotes);
+    fOk &= db.ReadRecords('p', mapProposals);
+    fOk &= db.ReadRecords('v', mapProposalVotes);
+    fOk &= db.ReadRecords('f', mapFinalizedBudgets);
+    fOk &= db.ReadRecords('w', mapFinalizedBudgetVotes);
+
+    // Votes for a proposal or budget that is gone are dropped, and erased by the next flush
+    for (map<pair<uint256, uint256>, CBudgetVote>::iterator it = mapProposalVotes.begin(); it != mapProposalVotes.end(); ++it) {
+        map<uint256, CBudgetProposal>::iterator itProposal = mapProposals.find(it->first.first);
+        if (itProposal != mapProposals.end())
+            itProposal->second.mapVotes[it->first.second] = it->second;
+    }
+    for (map<uint256, CBudgetProposal>::iterator it = mapProposals.begin(); it != mapProposals.end(); ++it) {
+        it->second.RecountVotes();
+        UpdateProposalRank(it->first, it->second);
+    }
+    // the masternodes that cast the votes are checked once they are used
+    MasternodeListReset();
+    for (map<pair<uint256, uint256>, CFinalizedBudgetVote>::iterator it = mapFinalizedBudgetVotes.begin(); it != mapFinalizedBudgetVotes.end(); ++it) {
+        map<uint256, CFinalizedBudget>::iterator itBudget = mapFinalizedBudgets.find(it->first.first);
+        if (itBudget != mapFinalizedBudgets.end())
+            itBudget->second.mapVotes[it->first.second] = it->second;
+    }
+
+    LogPrintf("Loaded budget cache  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("  %s\n", ToString());
+    return fOk;
+}
@@ -12,6 +12,7 @@
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
+#include "masternode-cachedb.h"
 #include "net.h"
 #include "sync.h"
 #include "util.h"
@@ -49,6 +50,9 @@ int GetBudgetPaymentCycleBlocks();
 //Check the collateral transaction for the budget proposal/finalized budget
 bool IsBudgetCollateralValid(uint256 nTxCollateralHash, uint256 nExpectedHash, std::string& strError, int64_t& nTime, int& nConf);
 
+//Check whether a transaction looks like the collateral of a budget proposal/finalized budget (pruning keeps those)
+bool IsBudgetCollateralCandidate(const CTransaction& tx);
+
 //
 // CBudgetVote - Allow a masternode node to vote and broadcast throughout the network
 //
@@ -69,6 +73,7 @@ public:
 
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool SignatureValid(bool fSignatureCheck);
+    std::string GetSignatureMessage() const;
     void Relay();
 
     std::string GetVoteString()
@@ -121,6 +126,7 @@ public:
 
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool SignatureValid(bool fSignatureCheck);
+    std::string GetSignatureMessage() const;
     void Relay();
 
     uint256 GetHash()
@@ -144,34 +150,32 @@ public:
     }
 };
 
-/** Save Budget Manager (budget.dat)
- */
-class CBudgetDB
-{
-private:
-    boost::filesystem::path pathDB;
-    std::string strMagicMessage;
-
-public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
-
-    CBudgetDB();
-    bool Write(const CBudgetManager& objToSave);
-    ReadResult Read(CBudgetManager& objToLoad, bool fDryRun = false);
-};
+/** The budget on disk (budget/) */
+extern CMasternodeCacheDB* pbudgetdb;
 
 
 //
 // Budget Manager : Contains all proposals for the budget
 //
+//
+// Position of a proposal in the order GetBudget() funds them: most net yes votes first,
+// ties broken by the fee transaction
+//
+struct CProposalRank {
+    int nNetYeas;
+    uint256 nFeeTXHash;
+    uint256 nProposalHash;
+
+    bool operator<(const CProposalRank& other) const
+    {
+        if (nNetYeas != other.nNetYeas)
+            return nNetYeas > other.nNetYeas;
+        if (nFeeTXHash != other.nFeeTXHash)
+            return nFeeTXHash > other.nFeeTXHash;
+        return nProposalHash < other.nProposalHash;
+    }
+};
+
 class CBudgetManager
 {
 private:
@@ -179,6 +183,22 @@ private:
     // XX42    map<uint256, CTransaction> mapCollateral;
     map<uint256, uint256> mapCollateralTxids;
 
+    // proposals sorted by their rank, and the rank each one is filed under
+    std::set<CProposalRank> setProposalRanking;
+    std::map<uint256, CProposalRank> mapProposalRank;
+
+    // file a proposal under its current tally
+    void UpdateProposalRank(const uint256& nHash, CBudgetProposal& budgetProposal);
+
+    // masternodes added to or removed from the list since their votes were last checked,
+    // under their own lock so the masternode manager can report them while holding its own
+    CCriticalSection cs_changed;
+    std::set<COutPoint> setChangedMasternodes;
+    bool fMasternodeListReset;
+
+    // recheck the votes of the masternodes that changed and refile their proposals
+    void CheckChangedVotes();
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -198,6 +218,7 @@ public:
     {
         mapProposals.clear();
         mapFinalizedBudgets.clear();
+        fMasternodeListReset = false;
     }
 
     void ClearSeen()
@@ -213,17 +234,28 @@ public:
 
     void ResetSync();
     void MarkSynced();
-    void Sync(CNode* node, uint256 nProp, bool fPartial = false);
+    /// Send a peer our proposals, budgets and votes; with its digests only what it is missing
+    void Sync(CNode* node, uint256 nProp, bool fPartial = false, const std::map<uint256, uint256>* pmapProposalDigests = NULL, const std::map<uint256, uint256>* pmapBudgetDigests = NULL);
+    /// Ask a peer for the budget, with digests of the votes we have if it supports them
+    void RequestSync(CNode* pnode);
+    /// Digest of the votes of each proposal and finalized budget we have
+    void GetVoteDigests(std::map<uint256, uint256>& mapProposalDigests, std::map<uint256, uint256>& mapBudgetDigests);
+    /// Number of entries and approximate memory usage in bytes of each map, by name
+    void GetMemoryUsage(std::map<std::string, std::pair<size_t, size_t> >& mapUsage) const;
 
     void Calculate();
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     void NewBlock();
     CBudgetProposal* FindProposal(const std::string& strProposalName);
     CBudgetProposal* FindProposal(uint256 nHash);
+    /// Forget a proposal along with its votes and rank
+    void RemoveProposal(const uint256& nHash);
     CFinalizedBudget* FindFinalizedBudget(uint256 nHash);
     std::pair<std::string, std::string> GetVotes(std::string strProposalName);
 
     CAmount GetTotalBudget(int nHeight);
+    /// Every proposal in the order GetBudget() funds them
+    std::vector<CBudgetProposal*> GetRankedProposals();
     std::vector<CBudgetProposal*> GetBudget();
     std::vector<CBudgetProposal*> GetAllProposals();
     std::vector<CFinalizedBudget*> GetFinalizedBudgets();
@@ -240,6 +272,11 @@ public:
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, CAmount nFees, bool fProofOfStake);
 
+    /// A masternode joined or left the list, its proposal votes are checked again before they are next used
+    void MasternodeChanged(const CTxIn& vin);
+    /// The whole masternode list was replaced, every proposal vote is checked again
+    void MasternodeListReset();
+
     void CheckOrphanVotes();
     void Clear()
     {
@@ -247,6 +284,8 @@ public:
 
         LogPrintf("Budget object cleared\n");
         mapProposals.clear();
+        setProposalRanking.clear();
+        mapProposalRank.clear();
         mapFinalizedBudgets.clear();
         mapSeenMasternodeBudgetProposals.clear();
         mapSeenMasternodeBudgetVotes.clear();
@@ -258,6 +297,12 @@ public:
     void CheckAndRemove();
     std::string ToString() const;
 
+    /// Write the items that changed since the last flush to the cache database
+    bool WriteCache(CMasternodeCacheDB& db, unsigned int& nWritten, unsigned int& nErased);
+
+    /// Load the items from the cache database
+    bool ReadCache(CMasternodeCacheDB& db);
+
 
     ADD_SERIALIZE_METHODS;
 
@@ -338,6 +383,8 @@ public:
     int GetBlockStart() { return nBlockStart; }
     int GetBlockEnd() { return nBlockStart + (int)(vecBudgetPayments.size() - 1); }
     int GetVoteCount() { return (int)mapVotes.size(); }
+    /// XOR of the hashes of the valid votes
+    uint256 GetVoteDigest();
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
     bool GetBudgetPaymentByBlock(int64_t nBlockHeight, CTxBudgetPayment& payment)
     {
@@ -459,6 +506,16 @@ private:
     mutable CCriticalSection cs;
     CAmount nAlloted;
 
+    // tally of the votes in mapVotes, kept up to date by AddOrUpdateVote(), CheckVote() and CleanAndRemove()
+    int nYeas;
+    int nNays;
+    int nAbstains;
+    // yes and no votes including the ones not currently valid, for GetRatio()
+    int nAllYeas;
+    int nAllNays;
+
+    void TallyVote(const CBudgetVote& vote, int nDelta);
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -509,14 +566,20 @@ public:
     int GetBlockCurrentCycle();
     int GetBlockEndCycle();
     double GetRatio();
-    int GetYeas();
-    int GetNays();
-    int GetAbstains();
+    int GetYeas() { return nYeas; }
+    int GetNays() { return nNays; }
+    int GetAbstains() { return nAbstains; }
     CAmount GetAmount() { return nAmount; }
     void SetAllotted(CAmount nAllotedIn) { nAlloted = nAllotedIn; }
     CAmount GetAllotted() { return nAlloted; }
 
     void CleanAndRemove(bool fSignatureCheck);
+    /// Recheck the vote of one masternode, keyed by its collateral, returns true if it moved in or out of the tally
+    bool CheckVote(const uint256& hash, bool fSignatureCheck);
+    /// XOR of the hashes of the valid votes
+    uint256 GetVoteDigest();
+    // recount the tally after mapVotes was changed directly
+    void RecountVotes();
 
     uint256 GetHash()
     {
@@ -550,6 +613,8 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+        if (ser_action.ForRead())
+            RecountVotes();
     }
 };
 
@@ -578,6 +643,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        first.RecountVotes();
+        second.RecountVotes();
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
@@ -0,0 +1,37 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-cachedb.h"
+
+#include "util.h"
+
+CMasternodeCacheDB::CMasternodeCacheDB(const std::string& strName, size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / strName, nCacheSize, fMemory, fWipe), nQueued(0)
+{
+}
+
+bool CMasternodeCacheDB::Commit(unsigned int& nWritten, unsigned int& nErased)
+{
+    nWritten = nQueued;
+    nErased = 0;
+
+    std::map<std::string, uint256>::iterator it = mapRecordHash.begin();
+    while (it != mapRecordHash.end()) {
+        if (setWritten.count(it->first)) {
+            ++it;
+            continue;
+        }
+        batch.Erase(CFlatData((void*)it->first.data(), (void*)(it->first.data() + it->first.size())));
+        mapRecordHash.erase(it++);
+        nErased++;
+    }
+    setWritten.clear();
+
+    if (nWritten == 0 && nErased == 0)
+        return true;
+
+    WriteBatch(batch);
+    batch = CLevelDBBatch();
+    nQueued = 0;
+    return true;
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_CACHEDB_H
+#define MASTERNODE_CACHEDB_H
+
+#include "hash.h"
+#include "leveldbwrapper.h"
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+
+/** Default cache size of each masternode cache database (bytes) */
+static const size_t MASTERNODE_CACHEDB_CACHE = 1 << 20;
+
+/**
+ * LevelDB-backed store for the masternode list, the masternode payment votes
+ * and the budget (mncache/, mnpayments/ and budget/ in the data directory).
+ *
+ * Every item is a record of its own, keyed by a type character and the key of
+ * the item in its manager. A flush passes every item to WriteRecord(); only the
+ * records whose serialization changed since the previous flush are queued,
+ * and Commit() erases the records that were not passed again. A periodic dump
+ * therefore costs I/O proportional to the churn instead of the size of the
+ * caches, and LevelDB's own compaction keeps the files bounded.
+ */
+class CMasternodeCacheDB : public CLevelDBWrapper
+{
+private:
+    //! hash of the value of every record on disk, by serialized key
+    std::map<std::string, uint256> mapRecordHash;
+    //! keys passed to WriteRecord() since the last Commit()
+    std::set<std::string> setWritten;
+    CLevelDBBatch batch;
+    unsigned int nQueued;
+
+    CMasternodeCacheDB(const CMasternodeCacheDB&);
+    void operator=(const CMasternodeCacheDB&);
+
+    template <typename K>
+    static std::string SerializeKey(char chType, const K& key)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << chType << key;
+        return ssKey.str();
+    }
+
+public:
+    CMasternodeCacheDB(const std::string& strName, size_t nCacheSize = MASTERNODE_CACHEDB_CACHE, bool fMemory = false, bool fWipe = false);
+
+    /** Queue a record unless it is on disk with the same value already */
+    template <typename K, typename V>
+    void WriteRecord(char chType, const K& key, const V& value)
+    {
+        std::string strKey = SerializeKey(chType, key);
+        uint256 hash = SerializeHash(value, SER_DISK, CLIENT_VERSION);
+        setWritten.insert(strKey);
+
+        std::map<std::string, uint256>::iterator it = mapRecordHash.find(strKey);
+        if (it != mapRecordHash.end() && it->second == hash)
+            return;
+        batch.Write(CFlatData((void*)strKey.data(), (void*)(strKey.data() + strKey.size())), value);
+        mapRecordHash[strKey] = hash;
+        nQueued++;
+    }
+
+    template <typename K, typename V>
+    void WriteRecords(char chType, const std::map<K, V>& mapIn)
+    {
+        for (typename std::map<K, V>::const_iterator it = mapIn.begin(); it != mapIn.end(); ++it)
+            WriteRecord(chType, it->first, it->second);
+    }
+
+    /** Erase the records not written since the last Commit() and write the queued batch */
+    bool Commit(unsigned int& nWritten, unsigned int& nErased);
+
+    /** Read all records of a type. Records that fail to deserialize are skipped and erased by the next Commit() */
+    template <typename K, typename V>
+    bool ReadRecords(char chType, std::map<K, V>& mapOut)
+    {
+        boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+        pcursor->Seek(std::string(1, chType));
+
+        bool fOk = true;
+        for (; pcursor->Valid(); pcursor->Next()) {
+            leveldb::Slice slKey = pcursor->key();
+            if (slKey.size() == 0 || slKey[0] != chType)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            std::string strKey = slKey.ToString();
+            K key;
+            try {
+                CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                char chKeyType;
+                ssKey >> chKeyType >> key;
+            } catch (const std::exception& e) {
+                mapRecordHash[strKey] = uint256();
+                fOk = error("%s : Deserialize error for a record of type '%c' - %s", __func__, chType, e.what());
+                continue;
+            }
+            try {
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                ssValue >> mapOut[key];
+            } catch (const std::exception& e) {
+                mapOut.erase(key);
+                mapRecordHash[strKey] = uint256();
+                fOk = error("%s : Deserialize error for a record of type '%c' - %s", __func__, chType, e.what());
+                continue;
+            }
+            mapRecordHash[strKey] = Hash(slValue.data(), slValue.data() + slValue.size());
+        }
+        HandleError(pcursor->status());
+        return fOk;
+    }
+};
+
+#endif // MASTERNODE_CACHEDB_H
@@ -14,6 +14,7 @@
 #include "sync.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "validationinterface.h"
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -24,154 +25,22 @@ CCriticalSection cs_vecPayments;
 CCriticalSection cs_mapMasternodeBlocks;
 CCriticalSection cs_mapMasternodePayeeVotes;
 
-//
-// CMasternodePaymentDB
-//
-
-CMasternodePaymentDB::CMasternodePaymentDB()
-{
-    pathDB = GetDataDir() / "mnpayments.dat";
-    strMagicMessage = "MasternodePayments";
-}
-
-bool CMasternodePaymentDB::Write(const CMasternodePayments& objToSave)
-{
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // masternode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
-
-    LogPrintf("Written info to mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
-
-    return true;
-}
-
-CMasternodePaymentDB::ReadResult CMasternodePaymentDB::Read(CMasternodePayments& objToLoad, bool fDryRun)
-{
-    int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathDB.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathDB);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
-
-    CDataStream ssObj(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssObj.begin(), ssObj.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
-
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
-    try {
-        // de-serialize file header (masternode cache file specific magic message) and ..
-        ssObj >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid masternode payement cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-
-        // de-serialize file header (network specific magic number) and ..
-        ssObj >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
-
-        // de-serialize data into CMasternodePayments object
-        ssObj >> objToLoad;
-    } catch (std::exception& e) {
-        objToLoad.Clear();
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return IncorrectFormat;
-    }
-
-    LogPrintf("Loaded info from mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrintf("  %s\n", objToLoad.ToString());
-    if (!fDryRun) {
-        LogPrintf("Masternode payments manager - cleaning....\n");
-        objToLoad.CleanPaymentList();
-        LogPrintf("Masternode payments manager - result:\n");
-        LogPrintf("  %s\n", objToLoad.ToString());
-    }
-
-    return Ok;
-}
+/** The masternode payment votes on disk */
+CMasternodeCacheDB* pmnpaymentsdb = NULL;
 
 void DumpMasternodePayments()
 {
-    int64_t nStart = GetTimeMillis();
+    if (!pmnpaymentsdb)
+        return;
 
-    CMasternodePaymentDB paymentdb;
-    CMasternodePayments tempPayments;
-
-    LogPrintf("Verifying mnpayments.dat format...\n");
-    CMasternodePaymentDB::ReadResult readResult = paymentdb.Read(tempPayments, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CMasternodePaymentDB::FileError)
-        LogPrintf("Missing budgets file - mnpayments.dat, will try to recreate\n");
-    else if (readResult != CMasternodePaymentDB::Ok) {
-        LogPrintf("Error reading mnpayments.dat: ");
-        if (readResult == CMasternodePaymentDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
+    int64_t nStart = GetTimeMillis();
+    unsigned int nWritten, nErased;
+    if (!masternodePayments.WriteCache(*pmnpaymentsdb, nWritten, nErased)) {
+        LogPrintf("Error writing the masternode payment cache\n");
+        return;
     }
-    LogPrintf("Writting info to mnpayments.dat...\n");
-    paymentdb.Write(masternodePayments);
 
-    LogPrintf("Budget dump finished  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("Masternode payments dump finished: %u records written, %u erased  %dms\n", nWritten, nErased, GetTimeMillis() - nStart);
 }
 
 bool IsBlockValueValid(const CBlock& block, CAmount nExpectedValue, CAmount nMinted)
@@ -368,7 +237,7 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
     } else if (strCommand == "mnw") { //Masternode Payments Declare Winner
         //this is required in litemodef
         CMasternodePaymentWinner winner;
-        vRecv >> winner;
+        pfrom->ReadMessage(vRecv, winner);
 
         if (pfrom->nVersion < ActiveProtocol()) return;
 
@@ -385,7 +254,8 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
             return;
         }
 
-        int nFirstBlock = nHeight - (mnodeman.CountEnabled() * 1.25);
+        // on a young chain the first block would be below the genesis block
+        int nFirstBlock = std::max(1, (int)(nHeight - (mnodeman.CountEnabled() * 1.25)));
         if (winner.nBlockHeight < nFirstBlock || winner.nBlockHeight > nHeight + 20) {
             LogPrint("mnpayments", "mnw - winner out of range - FirstBlock %d Height %d bestHeight %d\n", nFirstBlock, winner.nBlockHeight, nHeight);
             return;
@@ -417,7 +287,7 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
         //   LogPrint("mnpayments", "mnw - winning vote - Addr %s Height %d bestHeight %d - %s\n", address2.ToString().c_str(), winner.nBlockHeight, nHeight, winner.vinMasternode.prevout.ToStringShort());
 
         if (masternodePayments.AddWinningMasternode(winner)) {
-            winner.Relay();
+            if (pfrom->fRelayMasternodeMessages) winner.Relay();
             masternodeSync.AddedMasternodeWinner(winner.GetHash());
         }
     }
@@ -428,9 +298,7 @@ bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasterno
     std::string errorMessage;
     std::string strMasterNodeSignMessage;
 
-    std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             payee.ToString();
+    std::string strMessage = GetSignatureMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrintf("CMasternodePing::Sign() - Error: %s\n", errorMessage.c_str());
@@ -445,13 +313,118 @@ bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasterno
     return true;
 }
 
-bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
+std::string CMasternodePaymentWinner::GetSignatureMessage() const
+{
+    return vinMasternode.prevout.ToStringShort() +
+           boost::lexical_cast<std::string>(nBlockHeight) +
+           payee.ToString();
+}
+
+CMasternodeBlockPayeesWindow::CMasternodeBlockPayeesWindow(size_t nSize) : vSlots(nSize), nMinSize(nSize), nOldest(0), nNewest(0), nCount(0)
 {
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetPayee(payee);
+}
+
+void CMasternodeBlockPayeesWindow::Resize(size_t nSize)
+{
+    std::vector<CMasternodeBlockPayees> vOld(nSize);
+    vOld.swap(vSlots);
+    BOOST_FOREACH (CMasternodeBlockPayees& payees, vOld) {
+        if (payees.nBlockHeight == 0) continue;
+        CMasternodeBlockPayees& slot = Slot(payees.nBlockHeight);
+        slot.nBlockHeight = payees.nBlockHeight;
+        slot.vecPayments.swap(payees.vecPayments);
     }
+}
 
-    return false;
+void CMasternodeBlockPayeesWindow::Shrink()
+{
+    size_t nSpan = nCount > 0 ? nNewest - nOldest + 1 : 0;
+    size_t nSize = vSlots.size();
+    while (nSize / 2 >= nMinSize && nSpan < nSize / 4)
+        nSize /= 2;
+    if (nSize != vSlots.size())
+        Resize(nSize);
+}
+
+CMasternodeBlockPayees* CMasternodeBlockPayeesWindow::Get(int nHeight)
+{
+    // a slot of height 0 is empty, and no payee is voted below the first block
+    if (nHeight <= 0) return NULL;
+    if (Has(nHeight)) return &Slot(nHeight);
+
+    int nNewOldest = nCount > 0 ? std::min(nOldest, nHeight) : nHeight;
+    int nNewNewest = nCount > 0 ? std::max(nNewest, nHeight) : nHeight;
+    size_t nSize = vSlots.size();
+    while ((size_t)(nNewNewest - nNewOldest) >= nSize)
+        nSize *= 2;
+    if (nSize != vSlots.size())
+        Resize(nSize);
+
+    nOldest = nNewOldest;
+    nNewest = nNewNewest;
+    nCount++;
+    CMasternodeBlockPayees& payees = Slot(nHeight);
+    payees = CMasternodeBlockPayees(nHeight);
+    return &payees;
+}
+
+void CMasternodeBlockPayeesWindow::Set(int nHeight, const CMasternodeBlockPayees& payees)
+{
+    CMasternodeBlockPayees* pslot = Get(nHeight);
+    if (pslot) pslot->vecPayments = payees.vecPayments;
+}
+
+void CMasternodeBlockPayeesWindow::Erase(int nHeight)
+{
+    EraseSlot(nHeight);
+    Shrink();
+}
+
+void CMasternodeBlockPayeesWindow::EraseSlot(int nHeight)
+{
+    if (!Has(nHeight)) return;
+    Slot(nHeight) = CMasternodeBlockPayees();
+    if (--nCount == 0) {
+        nOldest = nNewest = 0;
+        return;
+    }
+    // move the ends of the window to the next heights held
+    while (Slot(nOldest).nBlockHeight != nOldest)
+        nOldest++;
+    while (Slot(nNewest).nBlockHeight != nNewest)
+        nNewest--;
+}
+
+void CMasternodeBlockPayeesWindow::EraseBelow(int nHeight)
+{
+    while (nCount > 0 && nOldest < nHeight)
+        EraseSlot(nOldest);
+    Shrink();
+}
+
+void CMasternodeBlockPayeesWindow::Clear()
+{
+    for (int h = nOldest; nCount > 0 && h <= nNewest; h++)
+        Slot(h) = CMasternodeBlockPayees();
+    nOldest = nNewest = 0;
+    nCount = 0;
+    Shrink();
+}
+
+size_t CMasternodeBlockPayeesWindow::DynamicMemoryUsage() const
+{
+    size_t nUsage = memusage::DynamicUsage(vSlots);
+    BOOST_FOREACH (const CMasternodeBlockPayees& payees, vSlots)
+        nUsage += memusage::DynamicUsage(payees.vecPayments);
+    return nUsage;
+}
+
+bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
+{
+    LOCK(cs_mapMasternodeBlocks);
+
+    CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Find(nBlockHeight);
+    return pblockPayees && pblockPayees->GetPayee(payee);
 }
 
 // Is this masternode scheduled to get paid soon?
@@ -471,15 +444,11 @@ bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
     mnpayee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
 
     CScript payee;
-    for (int64_t h = nHeight; h <= nHeight + 8; h++) {
+    for (int h = nHeight; h <= nHeight + 8; h++) {
         if (h == nNotBlockHeight) continue;
-        if (mapMasternodeBlocks.count(h)) {
-            if (mapMasternodeBlocks[h].GetPayee(payee)) {
-                if (mnpayee == payee) {
-                    return true;
-                }
-            }
-        }
+        CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Find(h);
+        if (pblockPayees && pblockPayees->GetPayee(payee) && mnpayee == payee)
+            return true;
     }
 
     return false;
@@ -487,6 +456,8 @@ bool CMasternodePayments::IsScheduled(CMasternode& mn, int nNotBlockHeight)
 
 bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerIn)
 {
+    if (winnerIn.nBlockHeight <= 0) return false;
+
     uint256 blockHash = 0;
     if (!GetBlockHash(blockHash, winnerIn.nBlockHeight - 100)) {
         return false;
@@ -500,15 +471,12 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
         }
 
         mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+        heightPayeeVotes.Add(winnerIn.GetHash(), winnerIn.nBlockHeight);
 
-        if (!mapMasternodeBlocks.count(winnerIn.nBlockHeight)) {
-            CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
-            mapMasternodeBlocks[winnerIn.nBlockHeight] = blockPayees;
-        }
+        masternodeBlocks.Get(winnerIn.nBlockHeight)->AddPayee(winnerIn.payee, 1);
     }
 
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
-
+    GetMainSignals().NotifyMasternodeWinner(winnerIn);
     return true;
 }
 
@@ -599,8 +567,9 @@ std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight)
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Find(nBlockHeight);
+    if (pblockPayees) {
+        return pblockPayees->GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -610,8 +579,9 @@ bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlo
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].IsTransactionValid(txNew);
+    CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Find(nBlockHeight);
+    if (pblockPayees) {
+        return pblockPayees->IsTransactionValid(txNew);
     }
 
     return true;
@@ -631,21 +601,38 @@ void CMasternodePayments::CleanPaymentList()
     //keep up to five cycles for historical sake
     int nLimit = std::max(int(mnodeman.size() * 1.25), 1000);
 
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
-    while (it != mapMasternodePayeeVotes.end()) {
-        CMasternodePaymentWinner winner = (*it).second;
+    // only the votes in the height buckets that fell out of the window are looked at
+    std::vector<uint256> vHash;
+    heightPayeeVotes.Expire(nHeight - nLimit, vHash);
+    BOOST_FOREACH (const uint256& hash, vHash) {
+        std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.find(hash);
+        if (it == mapMasternodePayeeVotes.end()) continue;
 
-        if (nHeight - winner.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
-            masternodeSync.mapSeenSyncMNW.erase((*it).first);
-            mapMasternodePayeeVotes.erase(it++);
-            mapMasternodeBlocks.erase(winner.nBlockHeight);
-        } else {
-            ++it;
-        }
+        LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", (*it).second.nBlockHeight);
+        masternodeSync.mapSeenSyncMNW.erase(hash);
+        mapMasternodePayeeVotes.erase(it);
+    }
+    masternodeBlocks.EraseBelow(nHeight - nLimit);
+
+    vHash.clear();
+    heightLastVote.Expire(nHeight - nLimit, vHash);
+    BOOST_FOREACH (const uint256& hash, vHash) {
+        std::map<uint256, int>::iterator it = mapMasternodesLastVote.find(hash);
+        if (it != mapMasternodesLastVote.end() && (*it).second < nHeight - nLimit)
+            mapMasternodesLastVote.erase(it);
     }
 }
 
+void CMasternodePayments::GetMemoryUsage(std::map<std::string, std::pair<size_t, size_t> >& mapUsage) const
+{
+    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+    mapUsage["mapMasternodePayeeVotes"] = std::make_pair(mapMasternodePayeeVotes.size(),
+        memusage::DynamicUsage(mapMasternodePayeeVotes) + heightPayeeVotes.DynamicMemoryUsage());
+    mapUsage["masternodeBlocks"] = std::make_pair(masternodeBlocks.size(), masternodeBlocks.DynamicMemoryUsage());
+    mapUsage["mapMasternodesLastVote"] = std::make_pair(mapMasternodesLastVote.size(),
+        memusage::DynamicUsage(mapMasternodesLastVote) + heightLastVote.DynamicMemoryUsage());
+}
+
 bool CMasternodePaymentWinner::IsValid(CNode* pnode, std::string& strError)
 {
     CMasternode* pmn = mnodeman.Find(vinMasternode);
@@ -762,9 +749,7 @@ bool CMasternodePaymentWinner::SignatureValid()
     CMasternode* pmn = mnodeman.Find(vinMasternode);
 
     if (pmn != NULL) {
-        std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                                 boost::lexical_cast<std::string>(nBlockHeight) +
-                                 payee.ToString();
+        std::string strMessage = GetSignatureMessage();
 
         std::string errorMessage = "";
         if (!obfuScationSigner.VerifyMessage(pmn->pubKeyMasternode, vchSig, strMessage, errorMessage)) {
@@ -791,60 +776,75 @@ void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
     int nCount = (mnodeman.CountEnabled() * 1.25);
     if (nCountNeeded > nCount) nCountNeeded = nCount;
 
-    int nInvCount = 0;
+    std::vector<CInv> vInv;
     std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
     while (it != mapMasternodePayeeVotes.end()) {
         CMasternodePaymentWinner winner = (*it).second;
-        if (winner.nBlockHeight >= nHeight - nCountNeeded && winner.nBlockHeight <= nHeight + 20) {
-            node->PushInventory(CInv(MSG_MASTERNODE_WINNER, winner.GetHash()));
-            nInvCount++;
-        }
+        if (winner.nBlockHeight >= nHeight - nCountNeeded && winner.nBlockHeight <= nHeight + 20)
+            vInv.push_back(CInv(MSG_MASTERNODE_WINNER, winner.GetHash()));
         ++it;
     }
-    node->PushMessage("ssc", MASTERNODE_SYNC_MNW, nInvCount);
+    // the count follows the votes, so the peer knows it has all of them
+    node->PushInventoryNow(vInv);
+    node->PushMessage("ssc", MASTERNODE_SYNC_MNW, (int)vInv.size());
 }
 
 std::string CMasternodePayments::ToString() const
 {
     std::ostringstream info;
 
-    info << "Votes: " << (int)mapMasternodePayeeVotes.size() << ", Blocks: " << (int)mapMasternodeBlocks.size();
+    info << "Votes: " << (int)mapMasternodePayeeVotes.size() << ", Blocks: " << (int)masternodeBlocks.size();
 
     return info.str();
 }
 
-
-int CMasternodePayments::GetOldestBlock()
+bool CMasternodePayments::WriteCache(CMasternodeCacheDB& db, unsigned int& nWritten, unsigned int& nErased)
 {
-    LOCK(cs_mapMasternodeBlocks);
-
-    int nOldestBlock = std::numeric_limits<int>::max();
+    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
 
-    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin();
-    while (it != mapMasternodeBlocks.end()) {
-        if ((*it).first < nOldestBlock) {
-            nOldestBlock = (*it).first;
-        }
-        it++;
+    db.WriteRecords('v', mapMasternodePayeeVotes);
+    for (int h = masternodeBlocks.GetOldest(); masternodeBlocks.size() > 0 && h <= masternodeBlocks.GetNewest(); h++) {
+        const CMasternodeBlockPayees* pblockPayees = masternodeBlocks.Find(h);
+        if (pblockPayees) db.WriteRecord('b', h, *pblockPayees);
     }
 
-    return nOldestBlock;
+    return db.Commit(nWritten, nErased);
 }
 
+bool CMasternodePayments::ReadCache(CMasternodeCacheDB& db)
+{
+    int64_t nStart = GetTimeMillis();
 
-int CMasternodePayments::GetNewestBlock()
+    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+    bool fOk = db.ReadRecords('v', mapMasternodePayeeVotes);
+    std::map<int, CMasternodeBlockPayees> mapBlocks;
+    fOk &= db.ReadRecords('b', mapBlocks);
+    masternodeBlocks.Clear();
+    for (std::map<int, CMasternodeBlockPayees>::iterator it = mapBlocks.begin(); it != mapBlocks.end(); ++it)
+        masternodeBlocks.Set(it->first, it->second);
+
+    heightPayeeVotes.Clear();
+    for (std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin(); it != mapMasternodePayeeVotes.end(); ++it)
+        heightPayeeVotes.Add(it->first, it->second.nBlockHeight);
+
+    LogPrintf("Loaded masternode payment cache  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("  %s\n", ToString());
+    return fOk;
+}
+
+
+int CMasternodePayments::GetOldestBlock()
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    int nNewestBlock = 0;
+    if (masternodeBlocks.size() == 0) return std::numeric_limits<int>::max();
+    return masternodeBlocks.GetOldest();
+}
 
-    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin();
-    while (it != mapMasternodeBlocks.end()) {
-        if ((*it).first > nNewestBlock) {
-            nNewestBlock = (*it).first;
-        }
-        it++;
-    }
 
-    return nNewestBlock;
+int CMasternodePayments::GetNewestBlock()
+{
+    LOCK(cs_mapMasternodeBlocks);
+
+    return masternodeBlocks.GetNewest();
 }
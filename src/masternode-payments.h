@@ -6,9 +6,11 @@
 #ifndef MASTERNODE_PAYMENTS_H
 #define MASTERNODE_PAYMENTS_H
 
+#include "expiryindex.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
+#include "masternode-cachedb.h"
 #include <boost/lexical_cast.hpp>
 
 using namespace std;
@@ -25,6 +27,10 @@ extern CMasternodePayments masternodePayments;
 
 #define MNPAYMENTS_SIGNATURES_REQUIRED 6
 #define MNPAYMENTS_SIGNATURES_TOTAL 10
+// Granularity in blocks of the height indexes of the payment votes
+#define MNPAYMENTS_EXPIRY_BUCKET_BLOCKS 10
+// Initial number of heights the payee window holds, it grows in powers of two as needed
+#define MNPAYMENTS_WINDOW_INITIAL_SIZE 2048
 
 void ProcessMessageMasternodePayments(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 bool IsBlockPayeeValid(const CBlock& block, int nBlockHeight);
@@ -34,29 +40,8 @@ void FillBlockPayee(CMutableTransaction& txNew, CAmount nFees, bool fProofOfStak
 
 void DumpMasternodePayments();
 
-/** Save Masternode Payment Data (mnpayments.dat)
- */
-class CMasternodePaymentDB
-{
-private:
-    boost::filesystem::path pathDB;
-    std::string strMagicMessage;
-
-public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
-
-    CMasternodePaymentDB();
-    bool Write(const CMasternodePayments& objToSave);
-    ReadResult Read(CMasternodePayments& objToLoad, bool fDryRun = false);
-};
+/** The masternode payment votes on disk (mnpayments/) */
+extern CMasternodeCacheDB* pmnpaymentsdb;
 
 class CMasternodePayee
 {
@@ -158,6 +143,72 @@ public:
     }
 };
 
+/**
+ * The payee tallies of a window of consecutive block heights, in a ring buffer
+ * indexed by height so a lookup, insertion or removal of a height is O(1).
+ * The window spans from the oldest to the newest height held and the buffer
+ * doubles when a height beyond its size is added.
+ */
+class CMasternodeBlockPayeesWindow
+{
+private:
+    // height h lives in vSlots[h % vSlots.size()], a slot of height 0 is empty
+    std::vector<CMasternodeBlockPayees> vSlots;
+    size_t nMinSize;
+    int nOldest;
+    int nNewest;
+    size_t nCount;
+
+    CMasternodeBlockPayees& Slot(int nHeight) { return vSlots[nHeight % vSlots.size()]; }
+    const CMasternodeBlockPayees& Slot(int nHeight) const { return vSlots[nHeight % vSlots.size()]; }
+    void Resize(size_t nSize);
+    void EraseSlot(int nHeight);
+    /** Give back the slots a span of heights that was erased needed */
+    void Shrink();
+
+public:
+    CMasternodeBlockPayeesWindow(size_t nSize = MNPAYMENTS_WINDOW_INITIAL_SIZE);
+
+    bool Has(int nHeight) const { return nCount > 0 && nHeight >= nOldest && nHeight <= nNewest && Slot(nHeight).nBlockHeight == nHeight; }
+    /** The tallies of a height, NULL if there are none */
+    CMasternodeBlockPayees* Find(int nHeight) { return Has(nHeight) ? &Slot(nHeight) : NULL; }
+    const CMasternodeBlockPayees* Find(int nHeight) const { return Has(nHeight) ? &Slot(nHeight) : NULL; }
+    /** The tallies of a height, added if there are none; NULL for heights below 1 */
+    CMasternodeBlockPayees* Get(int nHeight);
+    /** Replace the tallies of a height */
+    void Set(int nHeight, const CMasternodeBlockPayees& payees);
+    void Erase(int nHeight);
+    /** Remove every height below nHeight */
+    void EraseBelow(int nHeight);
+    void Clear();
+
+    size_t size() const { return nCount; }
+    /** Oldest and newest height held, 0 if none */
+    int GetOldest() const { return nOldest; }
+    int GetNewest() const { return nNewest; }
+
+    size_t DynamicMemoryUsage() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    // serialized as the map of heights it replaces
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        std::map<int, CMasternodeBlockPayees> mapBlocks;
+        if (!ser_action.ForRead()) {
+            for (int h = nOldest; nCount > 0 && h <= nNewest; h++)
+                if (Has(h)) mapBlocks[h] = Slot(h);
+        }
+        READWRITE(mapBlocks);
+        if (ser_action.ForRead()) {
+            Clear();
+            for (std::map<int, CMasternodeBlockPayees>::iterator it = mapBlocks.begin(); it != mapBlocks.end(); ++it)
+                Set(it->first, it->second);
+        }
+    }
+};
+
 // for storing the winning payments
 class CMasternodePaymentWinner
 {
@@ -195,6 +246,7 @@ public:
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool IsValid(CNode* pnode, std::string& strError);
     bool SignatureValid();
+    std::string GetSignatureMessage() const;
     void Relay();
 
     void AddPayee(CScript payeeIn)
@@ -236,12 +288,17 @@ private:
     int nSyncedFromPeer;
     int nLastBlockHeight;
 
+    // the keys of mapMasternodePayeeVotes and mapMasternodesLastVote by block height
+    CExpiryIndex<uint256> heightPayeeVotes;
+    CExpiryIndex<uint256> heightLastVote;
+
 public:
     std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
-    std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
+    CMasternodeBlockPayeesWindow masternodeBlocks;
     std::map<uint256, int> mapMasternodesLastVote; //prevout.hash + prevout.n, nBlockHeight
 
-    CMasternodePayments()
+    CMasternodePayments() : heightPayeeVotes(MNPAYMENTS_EXPIRY_BUCKET_BLOCKS),
+                            heightLastVote(MNPAYMENTS_EXPIRY_BUCKET_BLOCKS)
     {
         nSyncedFromPeer = 0;
         nLastBlockHeight = 0;
@@ -249,9 +306,10 @@ public:
 
     void Clear()
     {
-        LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
-        mapMasternodeBlocks.clear();
+        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+        masternodeBlocks.Clear();
         mapMasternodePayeeVotes.clear();
+        heightPayeeVotes.Clear();
     }
 
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
@@ -277,6 +335,7 @@ public:
 
         //record this masternode voted
         mapMasternodesLastVote[outMasternode.hash + outMasternode.n] = nBlockHeight;
+        heightLastVote.Add(outMasternode.hash + outMasternode.n, nBlockHeight);
         return true;
     }
 
@@ -286,15 +345,29 @@ public:
     void FillBlockPayee(CMutableTransaction& txNew, int64_t nFees, bool fProofOfStake);
     std::string ToString() const;
     int GetOldestBlock();
+
+    /// Write the votes that changed since the last flush to the cache database
+    bool WriteCache(CMasternodeCacheDB& db, unsigned int& nWritten, unsigned int& nErased);
+
+    /// Load the votes from the cache database
+    bool ReadCache(CMasternodeCacheDB& db);
     int GetNewestBlock();
 
+    /// Number of entries and approximate memory usage in bytes of each map, by name
+    void GetMemoryUsage(std::map<std::string, std::pair<size_t, size_t> >& mapUsage) const;
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
         READWRITE(mapMasternodePayeeVotes);
-        READWRITE(mapMasternodeBlocks);
+        READWRITE(masternodeBlocks);
+        if (ser_action.ForRead()) {
+            heightPayeeVotes.Clear();
+            for (std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin(); it != mapMasternodePayeeVotes.end(); ++it)
+                heightPayeeVotes.Add(it->first, it->second.nBlockHeight);
+        }
     }
 };
 
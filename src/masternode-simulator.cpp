@@ -0,0 +1,409 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-simulator.h"
+
+#include "chainparams.h"
+#include "hash.h"
+#include "main.h"
+#include "masternode-budget.h"
+#include "masternode-payments.h"
+#include "masternode-sync.h"
+#include "masternode.h"
+#include "masternodeman.h"
+#include "net.h"
+#include "obfuscation.h"
+#include "random.h"
+#include "spork.h"
+#include "timedata.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <boost/foreach.hpp>
+
+/** The handlers ProcessMessage() in main.cpp passes masternode messages to */
+static void ProcessMasternodeMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv)
+{
+    mnodeman.ProcessMessage(pfrom, strCommand, vRecv);
+    budget.ProcessMessage(pfrom, strCommand, vRecv);
+    masternodePayments.ProcessMessageMasternodePayments(pfrom, strCommand, vRecv);
+    masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+}
+
+CMasternodeSimulator::CMasternodeSimulator(int nMasternodesIn, int nProposalsIn, int nRateIn, bool fKeepIn, int64_t nSeedIn) : nMasternodes(nMasternodesIn), nProposals(nProposalsIn), nRate(nRateIn), fKeep(fKeepIn), nSeed(nSeedIn), nTimeStart(0), nSent(0)
+{
+}
+
+uint256 CMasternodeSimulator::MakeHash(const std::string& strPurpose, int n) const
+{
+    if (nSeed == 0) return GetRandHash();
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << nSeed << strPurpose << n;
+    return ss.GetHash();
+}
+
+void CMasternodeSimulator::MakeKey(CKey& key, const std::string& strPurpose, int n) const
+{
+    if (nSeed != 0) {
+        uint256 hash = MakeHash(strPurpose, n);
+        key.Set(hash.begin(), hash.end(), true);
+        if (key.IsValid()) return;
+    }
+    key.MakeNewKey(true);
+}
+
+void CMasternodeSimulator::Pace()
+{
+    if (nRate <= 0) return;
+
+    int64_t nWait = nTimeStart + (int64_t)nSent * 1000000 / nRate - GetTimeMicros();
+    if (nWait >= 1000)
+        MilliSleep(nWait / 1000);
+}
+
+void CMasternodeSimulator::Record(CMasternodeSimulatorTraffic& traffic, int64_t nTime)
+{
+    traffic.nSent++;
+    traffic.nTimeTotal += nTime;
+    traffic.nTimeMax = std::max(traffic.nTimeMax, nTime);
+    nSent++;
+}
+
+template <typename T>
+void CMasternodeSimulator::Send(CNode* pnode, CMasternodeSimulatorTraffic& traffic, const T& message)
+{
+    CDataStream vRecv(SER_NETWORK, PROTOCOL_VERSION);
+    vRecv << message;
+
+    Pace();
+    int64_t nStart = GetTimeMicros();
+    ProcessMasternodeMessage(pnode, traffic.strCommand, vRecv);
+    Record(traffic, GetTimeMicros() - nStart);
+}
+
+void CMasternodeSimulator::SendBroadcasts(int64_t nBroadcastTime, int64_t nPingTime)
+{
+    CMasternodeSimulatorTraffic traffic("mnb");
+
+    uint256 blockHash;
+    {
+        LOCK(cs_main);
+        blockHash = chainActive[std::max(0, chainActive.Height() - 12)]->GetBlockHash();
+    }
+
+    std::string strError;
+    for (unsigned int i = 0; i < vMasternodes.size(); i++) {
+        CVirtualMasternode& mn = vMasternodes[i];
+        CService addr(strprintf("10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff), Params().GetDefaultPort());
+
+        CMasternodeBroadcast mnb(addr, mn.vin, mn.pubKeyCollateral, mn.pubKeyMasternode, PROTOCOL_VERSION);
+        mnb.sigTime = nBroadcastTime;
+        mnb.lastPing.vin = mn.vin;
+        mnb.lastPing.blockHash = blockHash;
+        mnb.lastPing.sigTime = nPingTime;
+        obfuScationSigner.SignMessage(mnb.lastPing.GetSignatureMessage(), strError, mnb.lastPing.vchSig, mn.keyMasternode);
+        obfuScationSigner.SignMessage(mnb.GetSignatureMessage(), strError, mnb.sig, mn.keyCollateral);
+
+        // a new broadcast as ProcessMessage() takes it, short of looking up the collateral
+        Pace();
+        int64_t nStart = GetTimeMicros();
+        int nDoS = 0;
+        mnodeman.AddSeenBroadcast(mnb);
+        if (mnb.CheckAndUpdate(nDoS)) {
+            CMasternode mnVirtual(mnb);
+            mnVirtual.unitTest = true;
+            if (mnodeman.Add(mnVirtual)) {
+                masternodeSync.AddedMasternodeList(mnb.GetHash());
+                traffic.nAccepted++;
+            }
+        }
+        Record(traffic, GetTimeMicros() - nStart);
+    }
+
+    vTraffic.push_back(traffic);
+}
+
+void CMasternodeSimulator::SendPings(CNode* pnode, int64_t nPingTime, int64_t nNow)
+{
+    CMasternodeSimulatorTraffic traffic("mnp");
+
+    uint256 blockHash;
+    {
+        LOCK(cs_main);
+        blockHash = chainActive[std::max(0, chainActive.Height() - 12)]->GetBlockHash();
+    }
+
+    // every masternode pings as often as it may, for as long as pings can be
+    // ahead of the clock
+    std::string strError;
+    for (int64_t nSigTime = nPingTime + MASTERNODE_MIN_MNP_SECONDS; nSigTime < nNow + 60 * 60 - 60; nSigTime += MASTERNODE_MIN_MNP_SECONDS) {
+        BOOST_FOREACH (CVirtualMasternode& mn, vMasternodes) {
+            CMasternodePing mnp;
+            mnp.vin = mn.vin;
+            mnp.blockHash = blockHash;
+            mnp.sigTime = nSigTime;
+            obfuScationSigner.SignMessage(mnp.GetSignatureMessage(), strError, mnp.vchSig, mn.keyMasternode);
+
+            Send(pnode, traffic, mnp);
+
+            CMasternode* pmn = mnodeman.Find(mn.vin);
+            if (pmn && pmn->lastPing.sigTime == nSigTime) traffic.nAccepted++;
+        }
+    }
+
+    vTraffic.push_back(traffic);
+}
+
+void CMasternodeSimulator::SendWinners(CNode* pnode)
+{
+    CMasternodeSimulatorTraffic traffic("mnw");
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+
+    std::map<COutPoint, CVirtualMasternode*> mapVirtual;
+    BOOST_FOREACH (CVirtualMasternode& mn, vMasternodes)
+        mapVirtual[mn.vin.prevout] = &mn;
+
+    // the top masternodes of every height a vote is accepted for agree on a payee;
+    // the rankings need the block 100 below
+    int nFirstBlock = std::max(nHeight - (int)(mnodeman.CountEnabled() * 1.25) + 1, 101);
+    for (int nBlockHeight = nFirstBlock; nBlockHeight <= nHeight + 20; nBlockHeight++) {
+        CScript payee = GetScriptForDestination(vMasternodes[nBlockHeight % vMasternodes.size()].pubKeyCollateral.GetID());
+
+        for (int nRank = 1; nRank <= MNPAYMENTS_SIGNATURES_TOTAL; nRank++) {
+            CMasternode* pmn = mnodeman.GetMasternodeByRank(nRank, nBlockHeight - 100, ActiveProtocol());
+            if (pmn == NULL) break;
+            std::map<COutPoint, CVirtualMasternode*>::iterator it = mapVirtual.find(pmn->vin.prevout);
+            if (it == mapVirtual.end()) continue;
+
+            CMasternodePaymentWinner winner(it->second->vin);
+            winner.nBlockHeight = nBlockHeight;
+            winner.AddPayee(payee);
+            winner.Sign(it->second->keyMasternode, it->second->pubKeyMasternode);
+
+            Send(pnode, traffic, winner);
+
+            LOCK(cs_mapMasternodePayeeVotes);
+            if (masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash())) traffic.nAccepted++;
+        }
+    }
+
+    vTraffic.push_back(traffic);
+}
+
+void CMasternodeSimulator::SendBudgetVotes(CNode* pnode, int64_t nNow)
+{
+    CMasternodeSimulatorTraffic traffic("mvote");
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+    int nBlockStart = nHeight - nHeight % GetBudgetPaymentCycleBlocks() + GetBudgetPaymentCycleBlocks();
+
+    for (int i = 0; i < nProposals; i++) {
+        CScript payee = GetScriptForDestination(vMasternodes[i % vMasternodes.size()].pubKeyCollateral.GetID());
+        CBudgetProposal proposal(strprintf("simulated-%d", i), "http://simulated", nBlockStart, nBlockStart + GetBudgetPaymentCycleBlocks(), payee, 10 * COIN, MakeHash("proposal", i));
+        uint256 nHash = proposal.GetHash();
+
+        LOCK(budget.cs);
+        if (budget.mapProposals.insert(std::make_pair(nHash, proposal)).second)
+            vProposals.push_back(nHash);
+    }
+
+    // every masternode votes on every proposal, and changes its vote as soon as it may
+    for (int nPass = 0; nPass < 2; nPass++) {
+        BOOST_FOREACH (const uint256& nHash, vProposals) {
+            BOOST_FOREACH (CVirtualMasternode& mn, vMasternodes) {
+                CBudgetVote vote(mn.vin, nHash, nPass == 0 ? VOTE_YES : VOTE_NO);
+                vote.nTime = nNow - (1 - nPass) * BUDGET_VOTE_UPDATE_MIN;
+                vote.Sign(mn.keyMasternode, mn.pubKeyMasternode);
+
+                Send(pnode, traffic, vote);
+
+                LOCK(budget.cs);
+                CBudgetProposal* pbudgetProposal = budget.FindProposal(nHash);
+                if (pbudgetProposal == NULL) continue;
+                std::map<uint256, CBudgetVote>::iterator it = pbudgetProposal->mapVotes.find(mn.vin.prevout.GetHash());
+                if (it != pbudgetProposal->mapVotes.end() && it->second.nTime == vote.nTime) traffic.nAccepted++;
+            }
+        }
+    }
+
+    vTraffic.push_back(traffic);
+}
+
+void CMasternodeSimulator::RecordUsage(bool fAfter)
+{
+    static const char* pszSubsystems[] = {"masternodes", "budget", "payments", "sync"};
+
+    for (int i = 0; i < 4; i++) {
+        std::map<std::string, std::pair<size_t, size_t> > mapUsage;
+        if (i == 0) mnodeman.GetMemoryUsage(mapUsage);
+        if (i == 1) budget.GetMemoryUsage(mapUsage);
+        if (i == 2) masternodePayments.GetMemoryUsage(mapUsage);
+        if (i == 3) masternodeSync.GetMemoryUsage(mapUsage);
+
+        size_t nEntries = 0;
+        size_t nUsage = 0;
+        for (std::map<std::string, std::pair<size_t, size_t> >::const_iterator it = mapUsage.begin(); it != mapUsage.end(); ++it) {
+            nEntries += it->second.first;
+            nUsage += it->second.second;
+        }
+
+        if (!fAfter) {
+            vUsage.push_back(CMasternodeSimulatorUsage(pszSubsystems[i]));
+            vUsage.back().nEntriesBefore = nEntries;
+            vUsage.back().nUsageBefore = nUsage;
+        } else {
+            vUsage[i].nEntriesAfter = nEntries;
+            vUsage[i].nUsageAfter = nUsage;
+        }
+    }
+}
+
+void CMasternodeSimulator::Cleanup()
+{
+    std::set<COutPoint> setVirtual;
+    BOOST_FOREACH (const CVirtualMasternode& mn, vMasternodes)
+        setVirtual.insert(mn.vin.prevout);
+
+    // budget votes, with the proposals they were cast on
+    BOOST_FOREACH (const uint256& nHash, vProposals)
+        budget.RemoveProposal(nHash);
+    vProposals.clear();
+    {
+        LOCK(budget.cs);
+        std::map<uint256, CBudgetVote>::iterator it = budget.mapSeenMasternodeBudgetVotes.begin();
+        while (it != budget.mapSeenMasternodeBudgetVotes.end()) {
+            if (setVirtual.count(it->second.vin.prevout)) {
+                masternodeSync.mapSeenSyncBudget.erase(it->first);
+                budget.mapSeenMasternodeBudgetVotes.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        it = budget.mapOrphanMasternodeBudgetVotes.begin();
+        while (it != budget.mapOrphanMasternodeBudgetVotes.end()) {
+            if (setVirtual.count(it->second.vin.prevout))
+                budget.mapOrphanMasternodeBudgetVotes.erase(it++);
+            else
+                ++it;
+        }
+    }
+
+    // payment votes, and the tallies of the heights they were cast for
+    {
+        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+        std::set<int> setHeights;
+        std::map<uint256, CMasternodePaymentWinner>::iterator it = masternodePayments.mapMasternodePayeeVotes.begin();
+        while (it != masternodePayments.mapMasternodePayeeVotes.end()) {
+            const COutPoint& outpoint = it->second.vinMasternode.prevout;
+            if (setVirtual.count(outpoint)) {
+                setHeights.insert(it->second.nBlockHeight);
+                masternodePayments.mapMasternodesLastVote.erase(outpoint.hash + outpoint.n);
+                masternodeSync.mapSeenSyncMNW.erase(it->first);
+                masternodePayments.mapMasternodePayeeVotes.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        BOOST_FOREACH (int nBlockHeight, setHeights)
+            masternodePayments.masternodeBlocks.Erase(nBlockHeight);
+        for (it = masternodePayments.mapMasternodePayeeVotes.begin(); it != masternodePayments.mapMasternodePayeeVotes.end(); ++it) {
+            if (setHeights.count(it->second.nBlockHeight))
+                masternodePayments.masternodeBlocks.Get(it->second.nBlockHeight)->AddPayee(it->second.payee, 1);
+        }
+    }
+
+    // the masternodes, their broadcasts and pings
+    BOOST_FOREACH (const CVirtualMasternode& mn, vMasternodes)
+        mnodeman.Remove(mn.vin);
+    vMasternodes.clear();
+
+    std::map<uint256, CMasternodeBroadcast>::iterator itBroadcast = mnodeman.mapSeenMasternodeBroadcast.begin();
+    while (itBroadcast != mnodeman.mapSeenMasternodeBroadcast.end()) {
+        if (setVirtual.count(itBroadcast->second.vin.prevout)) {
+            masternodeSync.mapSeenSyncMNB.erase(itBroadcast->first);
+            mnodeman.mapSeenMasternodeBroadcast.erase(itBroadcast++);
+        } else {
+            ++itBroadcast;
+        }
+    }
+    std::map<uint256, CMasternodePing>::iterator itPing = mnodeman.mapSeenMasternodePing.begin();
+    while (itPing != mnodeman.mapSeenMasternodePing.end()) {
+        if (setVirtual.count(itPing->second.vin.prevout))
+            mnodeman.mapSeenMasternodePing.erase(itPing++);
+        else
+            ++itPing;
+    }
+}
+
+bool CMasternodeSimulator::Run(std::string& strError)
+{
+    if (fLiteMode) {
+        strError = "Masternode functionality is disabled in lite mode";
+        return false;
+    }
+    if (!masternodeSync.IsBlockchainSynced()) {
+        strError = "The masternode subsystems ignore messages until the blockchain is synced, generate a block first";
+        return false;
+    }
+    if (nMasternodes <= 0) {
+        strError = "At least one masternode is needed";
+        return false;
+    }
+
+    int64_t nNow = GetAdjustedTime();
+    // broadcasts old enough to rank for payments, pings as old as they may be
+    int64_t nBroadcastTime = nNow - GetSporkValue(SPORK_16_MN_WINNER_MINIMUM_AGE) - 60 * 60;
+    int64_t nPingTime = nNow - 60 * 60 + MASTERNODE_MIN_MNP_SECONDS;
+
+    vMasternodes.resize(nMasternodes);
+    for (int i = 0; i < nMasternodes; i++) {
+        CVirtualMasternode& mn = vMasternodes[i];
+        MakeKey(mn.keyCollateral, "collateral", i);
+        mn.pubKeyCollateral = mn.keyCollateral.GetPubKey();
+        MakeKey(mn.keyMasternode, "masternode", i);
+        mn.pubKeyMasternode = mn.keyMasternode.GetPubKey();
+        mn.vin = CTxIn(COutPoint(MakeHash("vin", i), 0));
+    }
+
+    LogPrintf("CMasternodeSimulator::Run - %d masternodes, %d proposals, rate %d%s\n", nMasternodes, nProposals, nRate, fKeep ? ", kept" : "");
+
+    vTraffic.clear();
+    vUsage.clear();
+    RecordUsage(false);
+    nTimeStart = GetTimeMicros();
+    nSent = 0;
+
+    {
+        CNode node(INVALID_SOCKET, CAddress(CService("127.0.0.1", Params().GetDefaultPort())), "", true);
+        node.nVersion = PROTOCOL_VERSION;
+        // the traffic is for this node only
+        node.fRelayMasternodeMessages = false;
+
+        SendBroadcasts(nBroadcastTime, nPingTime);
+        SendPings(&node, nPingTime, nNow);
+        SendWinners(&node);
+        SendBudgetVotes(&node, nNow);
+    }
+
+    RecordUsage(true);
+    if (!fKeep)
+        Cleanup();
+
+    LogPrintf("CMasternodeSimulator::Run - done, %d messages in %dms\n", nSent, (GetTimeMicros() - nTimeStart) / 1000);
+    return true;
+}
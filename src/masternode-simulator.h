@@ -0,0 +1,112 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_SIMULATOR_H
+#define MASTERNODE_SIMULATOR_H
+
+#include "key.h"
+#include "primitives/transaction.h"
+#include "pubkey.h"
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+class CNode;
+
+/** Messages of one type the simulator sent and the time the node spent on them */
+struct CMasternodeSimulatorTraffic {
+    std::string strCommand;
+    int nSent;
+    int nAccepted;
+    int64_t nTimeTotal; // microseconds spent in the handlers
+    int64_t nTimeMax;   // microseconds spent on the slowest message
+
+    CMasternodeSimulatorTraffic(const std::string& strCommandIn) : strCommand(strCommandIn), nSent(0), nAccepted(0), nTimeTotal(0), nTimeMax(0) {}
+};
+
+/** Entries and approximate memory usage of a subsystem before and after the traffic */
+struct CMasternodeSimulatorUsage {
+    std::string strSubsystem;
+    size_t nEntriesBefore;
+    size_t nUsageBefore;
+    size_t nEntriesAfter;
+    size_t nUsageAfter;
+
+    CMasternodeSimulatorUsage(const std::string& strSubsystemIn) : strSubsystem(strSubsystemIn), nEntriesBefore(0), nUsageBefore(0), nEntriesAfter(0), nUsageAfter(0) {}
+};
+
+/**
+ * In-process load generator for the masternode subsystems of a -regtest node.
+ *
+ * Creates virtual masternodes with keys of their own and feeds signed mnb,
+ * mnp, mnw and mvote messages from a dummy peer to the handlers main.cpp
+ * passes masternode messages to, at up to nRate messages per second (0 for as
+ * fast as possible). It records the time spent in the handlers per message
+ * type, and the entries and memory usage of CMasternodeMan, CBudgetManager,
+ * CMasternodePayments and CMasternodeSync.
+ *
+ * Virtual masternodes have no collateral on chain: their broadcasts are
+ * checked with CheckAndUpdate() and added to the list directly, marked
+ * unitTest so Check() skips the collateral, and their budget proposals are
+ * added without a fee transaction. None of the traffic is relayed to peers,
+ * and everything it left in the subsystems is removed again after the run,
+ * unless fKeep is set.
+ *
+ * With a nonzero nSeed the keys, collaterals and proposals are derived from
+ * the seed instead of drawn at random, so nodes given the same seed and mock
+ * time end up with the same masternodes, proposals and votes. Kept, they
+ * give the masternode sync something to reconcile.
+ */
+class CMasternodeSimulator
+{
+private:
+    struct CVirtualMasternode {
+        CKey keyCollateral;
+        CPubKey pubKeyCollateral;
+        CKey keyMasternode;
+        CPubKey pubKeyMasternode;
+        CTxIn vin;
+    };
+
+    int nMasternodes;
+    int nProposals;
+    int nRate;
+    bool fKeep;
+    int64_t nSeed;
+    std::vector<CVirtualMasternode> vMasternodes;
+    std::vector<uint256> vProposals;
+    std::vector<CMasternodeSimulatorTraffic> vTraffic;
+    std::vector<CMasternodeSimulatorUsage> vUsage;
+    int64_t nTimeStart;
+    int nSent;
+
+    /** Random, or derived from nSeed, strPurpose and n when a seed is set */
+    uint256 MakeHash(const std::string& strPurpose, int n) const;
+    void MakeKey(CKey& key, const std::string& strPurpose, int n) const;
+    /** Sleep until the next message is due at nRate */
+    void Pace();
+    void Record(CMasternodeSimulatorTraffic& traffic, int64_t nTime);
+    template <typename T>
+    void Send(CNode* pnode, CMasternodeSimulatorTraffic& traffic, const T& message);
+
+    void SendBroadcasts(int64_t nBroadcastTime, int64_t nPingTime);
+    void SendPings(CNode* pnode, int64_t nPingTime, int64_t nNow);
+    void SendWinners(CNode* pnode);
+    void SendBudgetVotes(CNode* pnode, int64_t nNow);
+    void RecordUsage(bool fAfter);
+    void Cleanup();
+
+public:
+    CMasternodeSimulator(int nMasternodesIn, int nProposalsIn, int nRateIn, bool fKeepIn = false, int64_t nSeedIn = 0);
+
+    bool Run(std::string& strError);
+
+    const std::vector<CMasternodeSimulatorTraffic>& GetTraffic() const { return vTraffic; }
+    const std::vector<CMasternodeSimulatorUsage>& GetUsage() const { return vUsage; }
+};
+
+#endif // MASTERNODE_SIMULATOR_H
@@ -12,19 +12,62 @@
 #include "masternode-budget.h"
 #include "masternode.h"
 #include "masternodeman.h"
+#include "memusage.h"
+#include "scheduler.h"
 #include "spork.h"
 #include "util.h"
 #include "addrman.h"
 // clang-format on
 
+#include <boost/bind.hpp>
+
 class CMasternodeSync;
 CMasternodeSync masternodeSync;
 
-CMasternodeSync::CMasternodeSync()
+CMasternodeSync::CMasternodeSync() : pscheduler(NULL), nNextProcessTime(0)
 {
     Reset();
 }
 
+void CMasternodeSync::StartSync(CScheduler& scheduler)
+{
+    {
+        LOCK(cs_schedule);
+        pscheduler = &scheduler;
+    }
+    ScheduleProcess(0);
+}
+
+void CMasternodeSync::ScheduleProcess(int64_t nDelayMs)
+{
+    LOCK(cs_schedule);
+    if (pscheduler == NULL) return;
+
+    int64_t nTime = GetTimeMillis() + nDelayMs;
+    if (nNextProcessTime != 0 && nNextProcessTime <= nTime) return;
+
+    // a run that was due later finds its time superseded and does nothing
+    nNextProcessTime = nTime;
+    pscheduler->scheduleFromNow(boost::bind(&CMasternodeSync::RunScheduledProcess, this, nTime), nDelayMs);
+}
+
+void CMasternodeSync::RunScheduledProcess(int64_t nTime)
+{
+    {
+        LOCK(cs_schedule);
+        if (nTime != nNextProcessTime) return;
+        nNextProcessTime = 0;
+    }
+
+    Process();
+
+    // nothing to do but to watch for a lost list or retry a failed sync once a minute
+    if (IsSynced() || RequestedMasternodeAssets == MASTERNODE_SYNC_FAILED)
+        ScheduleProcess(60 * 1000);
+    else
+        ScheduleProcess(MASTERNODE_SYNC_TIMEOUT * 1000);
+}
+
 bool CMasternodeSync::IsSynced()
 {
     return RequestedMasternodeAssets == MASTERNODE_SYNC_FINISHED;
@@ -82,6 +125,10 @@ void CMasternodeSync::Reset()
     RequestedMasternodeAssets = MASTERNODE_SYNC_INITIAL;
     RequestedMasternodeAttempt = 0;
     nAssetSyncStarted = GetTime();
+    nStageAnswers = 0;
+    nLastStageAnswer = 0;
+
+    ScheduleProcess(0);
 }
 
 void CMasternodeSync::AddedMasternodeList(uint256 hash)
@@ -134,6 +181,18 @@ bool CMasternodeSync::IsBudgetFinEmpty()
     return sumBudgetItemFin == 0 && countBudgetItemFin > 0;
 }
 
+bool CMasternodeSync::UseDigests(CNode* pnode)
+{
+    return pnode->fSyncDigests && GetBoolArg("-syncdigests", DEFAULT_SYNC_DIGESTS);
+}
+
+void CMasternodeSync::GetMemoryUsage(std::map<std::string, std::pair<size_t, size_t> >& mapUsage) const
+{
+    mapUsage["mapSeenSyncMNB"] = std::make_pair(mapSeenSyncMNB.size(), memusage::DynamicUsage(mapSeenSyncMNB));
+    mapUsage["mapSeenSyncMNW"] = std::make_pair(mapSeenSyncMNW.size(), memusage::DynamicUsage(mapSeenSyncMNW));
+    mapUsage["mapSeenSyncBudget"] = std::make_pair(mapSeenSyncBudget.size(), memusage::DynamicUsage(mapSeenSyncBudget));
+}
+
 void CMasternodeSync::GetNextAsset()
 {
     switch (RequestedMasternodeAssets) {
@@ -158,6 +217,28 @@ void CMasternodeSync::GetNextAsset()
     }
     RequestedMasternodeAttempt = 0;
     nAssetSyncStarted = GetTime();
+    nStageAnswers = 0;
+    nLastStageAnswer = 0;
+}
+
+// Items announced by several peers take longer to arrive, but never wait longer than without answers
+int64_t CMasternodeSync::GetStageQuiet()
+{
+    return std::min((int64_t)MASTERNODE_SYNC_QUIET * nStageAnswers, (int64_t)MASTERNODE_SYNC_TIMEOUT * 2);
+}
+
+bool CMasternodeSync::IsStageAnswered(int64_t nLastItem)
+{
+    // an empty stage is left to the timeouts in Process
+    if (nLastItem == 0 || nStageAnswers == 0) return false;
+    if (nStageAnswers < MASTERNODE_SYNC_THRESHOLD && nStageAnswers < RequestedMasternodeAttempt) return false;
+    return std::max(nLastItem, nLastStageAnswer) < GetTime() - GetStageQuiet();
+}
+
+void CMasternodeSync::NextAssetNow()
+{
+    GetNextAsset();
+    ScheduleProcess(0);
 }
 
 std::string CMasternodeSync::GetSyncStatus()
@@ -190,12 +271,20 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
 
         if (RequestedMasternodeAssets >= MASTERNODE_SYNC_FINISHED) return;
 
+        // A peer answering our digests only sends what we are missing, and counts
+        // everything it has: a nonzero count means we are in sync with it so far
+        bool fDigestsMatched = nCount > 0 && UseDigests(pfrom);
+        // Peers that announced senddigests send the count after the items, so
+        // once the items requested from it arrived the peer is done
+        bool fAnswered = pfrom->fSyncDigests;
+
         //this means we will receive no further communication
         switch (nItemID) {
         case (MASTERNODE_SYNC_LIST):
             if (nItemID != RequestedMasternodeAssets) return;
             sumMasternodeList += nCount;
             countMasternodeList++;
+            if (fDigestsMatched) lastMasternodeList = GetTime();
             break;
         case (MASTERNODE_SYNC_MNW):
             if (nItemID != RequestedMasternodeAssets) return;
@@ -203,18 +292,29 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
             countMasternodeWinner++;
             break;
         case (MASTERNODE_SYNC_BUDGET_PROP):
+            // the finalized budgets follow
+            fAnswered = false;
             if (RequestedMasternodeAssets != MASTERNODE_SYNC_BUDGET) return;
             sumBudgetItemProp += nCount;
             countBudgetItemProp++;
+            if (fDigestsMatched) lastBudgetItem = GetTime();
             break;
         case (MASTERNODE_SYNC_BUDGET_FIN):
             if (RequestedMasternodeAssets != MASTERNODE_SYNC_BUDGET) return;
             sumBudgetItemFin += nCount;
             countBudgetItemFin++;
+            if (fDigestsMatched) lastBudgetItem = GetTime();
             break;
         }
 
         LogPrint("masternode", "CMasternodeSync:ProcessMessage - ssc - got inventory count %d %d\n", nItemID, nCount);
+
+        if (fAnswered) {
+            nStageAnswers++;
+            nLastStageAnswer = GetTime();
+            // check again once the items it announced had the time to arrive
+            ScheduleProcess((GetStageQuiet() + 1) * 1000);
+        }
     }
 }
 
@@ -233,10 +333,6 @@ void CMasternodeSync::ClearFulfilledRequest()
 
 void CMasternodeSync::Process()
 {
-    static int tick = 0;
-
-    if (tick++ % MASTERNODE_SYNC_TIMEOUT != 0) return;
-
     if (IsSynced()) {
         /* 
             Resync if we lose all masternodes from sleep/wake or failure to sync originally
@@ -254,7 +350,7 @@ void CMasternodeSync::Process()
         return;
     }
 
-    LogPrint("masternode", "CMasternodeSync::Process() - tick %d RequestedMasternodeAssets %d\n", tick, RequestedMasternodeAssets);
+    LogPrint("masternode", "CMasternodeSync::Process() - RequestedMasternodeAssets %d attempt %d answers %d\n", RequestedMasternodeAssets, RequestedMasternodeAttempt, nStageAnswers);
 
     if (RequestedMasternodeAssets == MASTERNODE_SYNC_INITIAL) GetNextAsset();
 
@@ -262,44 +358,42 @@ void CMasternodeSync::Process()
     if (Params().NetworkID() != CBaseChainParams::REGTEST &&
         !IsBlockchainSynced() && RequestedMasternodeAssets > MASTERNODE_SYNC_SPORKS) return;
 
+    // the peers we asked sent everything they have and nothing arrived since
+    if (RequestedMasternodeAssets == MASTERNODE_SYNC_LIST && IsStageAnswered(lastMasternodeList)) {
+        NextAssetNow();
+        return;
+    }
+    if (RequestedMasternodeAssets == MASTERNODE_SYNC_MNW && IsStageAnswered(lastMasternodeWinner)) {
+        NextAssetNow();
+        return;
+    }
+    if (RequestedMasternodeAssets == MASTERNODE_SYNC_BUDGET && IsStageAnswered(lastBudgetItem)) {
+        NextAssetNow();
+        activeMasternode.ManageStatus();
+        return;
+    }
+
     TRY_LOCK(cs_vNodes, lockRecv);
     if (!lockRecv) return;
 
-    BOOST_FOREACH (CNode* pnode, vNodes) {
-        if (Params().NetworkID() == CBaseChainParams::REGTEST) {
-            if (RequestedMasternodeAttempt <= 2) {
-                pnode->PushMessage("getsporks"); //get current network sporks
-            } else if (RequestedMasternodeAttempt < 4) {
-                mnodeman.DsegUpdate(pnode);
-            } else if (RequestedMasternodeAttempt < 6) {
-                int nMnCount = mnodeman.CountEnabled();
-                pnode->PushMessage("mnget", nMnCount); //sync payees
-                uint256 n = 0;
-                pnode->PushMessage("mnvs", n); //sync masternode votes
-            } else {
-                RequestedMasternodeAssets = MASTERNODE_SYNC_FINISHED;
-            }
-            RequestedMasternodeAttempt++;
-            return;
-        }
+    // ask up to this many peers per pass
+    int nAsked = 0;
 
+    BOOST_FOREACH (CNode* pnode, vNodes) {
         //set to synced
         if (RequestedMasternodeAssets == MASTERNODE_SYNC_SPORKS) {
             if (pnode->HasFulfilledRequest("getspork")) continue;
             pnode->FulfilledRequest("getspork");
 
             pnode->PushMessage("getsporks"); //get current network sporks
-            if (RequestedMasternodeAttempt >= 2) GetNextAsset();
             RequestedMasternodeAttempt++;
-
-            return;
+            continue;
         }
-
         if (pnode->nVersion >= masternodePayments.GetMinMasternodePaymentsProto()) {
             if (RequestedMasternodeAssets == MASTERNODE_SYNC_LIST) {
                 LogPrint("masternode", "CMasternodeSync::Process() - lastMasternodeList %lld (GetTime() - MASTERNODE_SYNC_TIMEOUT) %lld\n", lastMasternodeList, GetTime() - MASTERNODE_SYNC_TIMEOUT);
                 if (lastMasternodeList > 0 && lastMasternodeList < GetTime() - MASTERNODE_SYNC_TIMEOUT * 2 && RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD) { //hasn't received a new item in the last five seconds, so we'll move to the
-                    GetNextAsset();
+                    NextAssetNow();
                     return;
                 }
 
@@ -316,7 +410,7 @@ void CMasternodeSync::Process()
                         lastFailure = GetTime();
                         nCountFailures++;
                     } else {
-                        GetNextAsset();
+                        NextAssetNow();
                     }
                     return;
                 }
@@ -325,12 +419,13 @@ void CMasternodeSync::Process()
 
                 mnodeman.DsegUpdate(pnode);
                 RequestedMasternodeAttempt++;
-                return;
+                if (++nAsked >= MASTERNODE_SYNC_THRESHOLD) return;
+                continue;
             }
 
             if (RequestedMasternodeAssets == MASTERNODE_SYNC_MNW) {
                 if (lastMasternodeWinner > 0 && lastMasternodeWinner < GetTime() - MASTERNODE_SYNC_TIMEOUT * 2 && RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD) { //hasn't received a new item in the last five seconds, so we'll move to the
-                    GetNextAsset();
+                    NextAssetNow();
                     return;
                 }
 
@@ -347,7 +442,7 @@ void CMasternodeSync::Process()
                         lastFailure = GetTime();
                         nCountFailures++;
                     } else {
-                        GetNextAsset();
+                        NextAssetNow();
                     }
                     return;
                 }
@@ -360,8 +455,8 @@ void CMasternodeSync::Process()
                 int nMnCount = mnodeman.CountEnabled();
                 pnode->PushMessage("mnget", nMnCount); //sync payees
                 RequestedMasternodeAttempt++;
-
-                return;
+                if (++nAsked >= MASTERNODE_SYNC_THRESHOLD) return;
+                continue;
             }
         }
 
@@ -371,7 +466,7 @@ void CMasternodeSync::Process()
                 if (lastBudgetItem > 0 && lastBudgetItem < GetTime() - MASTERNODE_SYNC_TIMEOUT * 2 && RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD) { //hasn't received a new item in the last five seconds, so we'll move to the
                                                                                                                                                                  //LogPrintf("CMasternodeSync::Process - HasNextFinalizedBudget %d nCountFailures %d IsBudgetPropEmpty %d\n", budget.HasNextFinalizedBudget(), nCountFailures, IsBudgetPropEmpty());
                                                                                                                                                                  //if(budget.HasNextFinalizedBudget() || nCountFailures >= 2 || IsBudgetPropEmpty()) {
-                    GetNextAsset();
+                    NextAssetNow();
 
                     //try to activate our masternode if possible
                     activeMasternode.ManageStatus();
@@ -389,7 +484,7 @@ void CMasternodeSync::Process()
                 if (lastBudgetItem == 0 &&
                     (RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD * 3 || GetTime() - nAssetSyncStarted > MASTERNODE_SYNC_TIMEOUT * 5)) {
                     // maybe there is no budgets at all, so just finish syncing
-                    GetNextAsset();
+                    NextAssetNow();
                     activeMasternode.ManageStatus();
                     return;
                 }
@@ -399,12 +494,14 @@ void CMasternodeSync::Process()
 
                 if (RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD * 3) return;
 
-                uint256 n = 0;
-                pnode->PushMessage("mnvs", n); //sync masternode votes
+                budget.RequestSync(pnode); //sync masternode votes
                 RequestedMasternodeAttempt++;
-
-                return;
+                if (++nAsked >= MASTERNODE_SYNC_THRESHOLD) return;
+                continue;
             }
         }
     }
+
+    // the sporks were asked from every peer, the answers arrive before anything we ask next
+    if (RequestedMasternodeAssets == MASTERNODE_SYNC_SPORKS && RequestedMasternodeAttempt > 0) NextAssetNow();
 }
@@ -19,8 +19,18 @@
 
 #define MASTERNODE_SYNC_TIMEOUT 5
 #define MASTERNODE_SYNC_THRESHOLD 2
+// Seconds without new items after the peers answered before a stage is complete, per answering peer
+#define MASTERNODE_SYNC_QUIET 2
+
+// Masternode list digests: one digest per this many entries, up to a maximum number of buckets
+#define MASTERNODE_SYNC_DIGEST_BUCKET_SIZE 8
+#define MASTERNODE_SYNC_DIGEST_BUCKETS_MAX 1024
+
+/** Sync with peers that support it by digests of what we have */
+static const bool DEFAULT_SYNC_DIGESTS = true;
 
 class CMasternodeSync;
+class CScheduler;
 extern CMasternodeSync masternodeSync;
 
 //
@@ -58,6 +68,10 @@ public:
     // Time when current masternode asset sync started
     int64_t nAssetSyncStarted;
 
+    // Peers that answered the current asset with a count after sending all of it, and when the last one did
+    int nStageAnswers;
+    int64_t nLastStageAnswer;
+
     CMasternodeSync();
 
     void AddedMasternodeList(uint256 hash);
@@ -68,13 +82,32 @@ public:
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     bool IsBudgetFinEmpty();
     bool IsBudgetPropEmpty();
+    /// Whether to send the peer digests of what we have instead of asking for everything
+    bool UseDigests(CNode* pnode);
+    /// Number of entries and approximate memory usage in bytes of each map, by name
+    void GetMemoryUsage(std::map<std::string, std::pair<size_t, size_t> >& mapUsage) const;
 
     void Reset();
     void Process();
+    /// Drive Process() from the scheduler from now on
+    void StartSync(CScheduler& scheduler);
+    /// Run Process() after nDelayMs milliseconds, unless a run is due earlier already
+    void ScheduleProcess(int64_t nDelayMs);
     bool IsSynced();
     bool IsBlockchainSynced();
     bool IsMasternodeListSynced() { return RequestedMasternodeAssets > MASTERNODE_SYNC_LIST; }
     void ClearFulfilledRequest();
+
+private:
+    CCriticalSection cs_schedule;
+    CScheduler* pscheduler;
+    // Time (ms) the pending run of Process() is due, 0 if none
+    int64_t nNextProcessTime;
+
+    void RunScheduledProcess(int64_t nTime);
+    int64_t GetStageQuiet();
+    bool IsStageAnswered(int64_t nLastItem);
+    void NextAssetNow();
 };
 
 #endif
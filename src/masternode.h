@@ -31,6 +31,7 @@ class CMasternodePing;
 extern map<int64_t, uint256> mapCacheBlockHashes;
 
 bool GetBlockHash(uint256& hash, int nBlockHeight);
+void ForgetBlockHashes(int nHeight);
 
 
 //
@@ -60,11 +61,12 @@ public:
         READWRITE(vchSig);
     }
 
-    bool CheckAndUpdate(int& nDos, bool fRequireEnabled = true);
+    bool CheckAndUpdate(int& nDos, bool fRequireEnabled = true, bool fRelay = true);
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
+    std::string GetSignatureMessage() const;
     void Relay();
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << vin;
@@ -111,6 +113,8 @@ private:
     mutable CCriticalSection cs;
     int64_t lastTimeChecked;
 
+    void UpdateState(bool forceCheck);
+
 public:
     enum state {
         MASTERNODE_PRE_ENABLED,
@@ -300,6 +304,7 @@ public:
     bool CheckAndUpdate(int& nDoS);
     bool CheckInputsAndAdd(int& nDos);
     bool Sign(CKey& keyCollateralAddress);
+    std::string GetSignatureMessage() const;
     void Relay();
 
     ADD_SERIALIZE_METHODS;
@@ -318,7 +323,7 @@ public:
         READWRITE(nLastDsq);
     }
 
-    uint256 GetHash()
+    uint256 GetHash() const
     {
         CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
         ss << sigTime;
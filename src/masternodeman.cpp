@@ -8,6 +8,7 @@
 #include "activemasternode.h"
 #include "addrman.h"
 #include "masternode.h"
+#include "masternode-budget.h"
 #include "obfuscation.h"
 #include "spork.h"
 #include "util.h"
@@ -41,158 +42,29 @@ struct CompareScoreMN {
     }
 };
 
-//
-// CMasternodeDB
-//
-
-CMasternodeDB::CMasternodeDB()
-{
-    pathMN = GetDataDir() / "mncache.dat";
-    strMagicMessage = "MasternodeCache";
-}
-
-bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
-{
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssMasternodes(SER_DISK, CLIENT_VERSION);
-    ssMasternodes << strMagicMessage;                   // masternode cache file specific magic message
-    ssMasternodes << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssMasternodes << mnodemanToSave;
-    uint256 hash = Hash(ssMasternodes.begin(), ssMasternodes.end());
-    ssMasternodes << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathMN.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathMN.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssMasternodes;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    //    FileCommit(fileout);
-    fileout.fclose();
-
-    LogPrintf("Written info to mncache.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrintf("  %s\n", mnodemanToSave.ToString());
-
-    return true;
-}
-
-CMasternodeDB::ReadResult CMasternodeDB::Read(CMasternodeMan& mnodemanToLoad, bool fDryRun)
-{
-    int64_t nStart = GetTimeMillis();
-    // open input file, and associate with CAutoFile
-    FILE* file = fopen(pathMN.string().c_str(), "rb");
-    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) {
-        error("%s : Failed to open file %s", __func__, pathMN.string());
-        return FileError;
-    }
-
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathMN);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return HashReadError;
-    }
-    filein.fclose();
-
-    CDataStream ssMasternodes(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssMasternodes.begin(), ssMasternodes.end());
-    if (hashIn != hashTmp) {
-        error("%s : Checksum mismatch, data corrupted", __func__);
-        return IncorrectHash;
-    }
-
-    unsigned char pchMsgTmp[4];
-    std::string strMagicMessageTmp;
-    try {
-        // de-serialize file header (masternode cache file specific magic message) and ..
-
-        ssMasternodes >> strMagicMessageTmp;
-
-        // ... verify the message matches predefined one
-        if (strMagicMessage != strMagicMessageTmp) {
-            error("%s : Invalid masternode cache magic message", __func__);
-            return IncorrectMagicMessage;
-        }
-
-        // de-serialize file header (network specific magic number) and ..
-        ssMasternodes >> FLATDATA(pchMsgTmp);
-
-        // ... verify the network matches ours
-        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp))) {
-            error("%s : Invalid network magic number", __func__);
-            return IncorrectMagicNumber;
-        }
-        // de-serialize data into CMasternodeMan object
-        ssMasternodes >> mnodemanToLoad;
-    } catch (std::exception& e) {
-        mnodemanToLoad.Clear();
-        error("%s : Deserialize or I/O error - %s", __func__, e.what());
-        return IncorrectFormat;
-    }
-
-    LogPrintf("Loaded info from mncache.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrintf("  %s\n", mnodemanToLoad.ToString());
-    if (!fDryRun) {
-        LogPrintf("Masternode manager - cleaning....\n");
-        mnodemanToLoad.CheckAndRemove(true);
-        LogPrintf("Masternode manager - result:\n");
-        LogPrintf("  %s\n", mnodemanToLoad.ToString());
-    }
-
-    return Ok;
-}
+/** The masternode list on disk */
+CMasternodeCacheDB* pmncachedb = NULL;
 
 void DumpMasternodes()
 {
-    int64_t nStart = GetTimeMillis();
+    if (!pmncachedb)
+        return;
 
-    CMasternodeDB mndb;
-    CMasternodeMan tempMnodeman;
-
-    LogPrintf("Verifying mncache.dat format...\n");
-    CMasternodeDB::ReadResult readResult = mndb.Read(tempMnodeman, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CMasternodeDB::FileError)
-        LogPrintf("Missing masternode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CMasternodeDB::Ok) {
-        LogPrintf("Error reading mncache.dat: ");
-        if (readResult == CMasternodeDB::IncorrectFormat)
-            LogPrintf("magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrintf("file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
+    int64_t nStart = GetTimeMillis();
+    unsigned int nWritten, nErased;
+    if (!mnodeman.WriteCache(*pmncachedb, nWritten, nErased)) {
+        LogPrintf("Error writing the masternode cache\n");
+        return;
     }
-    LogPrintf("Writting info to mncache.dat...\n");
-    mndb.Write(mnodeman);
 
-    LogPrintf("Masternode dump finished  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("Masternode dump finished: %u records written, %u erased  %dms\n", nWritten, nErased, GetTimeMillis() - nStart);
 }
 
-CMasternodeMan::CMasternodeMan()
+CMasternodeMan::CMasternodeMan() : expiryAskedUsForList(MASTERNODES_EXPIRY_BUCKET_SECONDS),
+                                   expiryWeAskedForList(MASTERNODES_EXPIRY_BUCKET_SECONDS),
+                                   expiryWeAskedForListEntry(MASTERNODES_EXPIRY_BUCKET_SECONDS),
+                                   expirySeenBroadcast(MASTERNODES_EXPIRY_BUCKET_SECONDS),
+                                   expirySeenPing(MASTERNODES_EXPIRY_BUCKET_SECONDS)
 {
     nDsqCount = 0;
 }
@@ -208,6 +80,8 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        ClearQuorums();
+        budget.MasternodeChanged(mn.vin);
         return true;
     }
 
@@ -228,6 +102,44 @@ void CMasternodeMan::AskForMN(CNode* pnode, CTxIn& vin)
     pnode->PushMessage("dseg", vin);
     int64_t askAgain = GetTime() + MASTERNODE_MIN_MNP_SECONDS;
     mWeAskedForMasternodeListEntry[vin.prevout] = askAgain;
+    LOCK(cs_expiry);
+    expiryWeAskedForListEntry.Add(vin.prevout, askAgain);
+}
+
+void CMasternodeMan::AddSeenBroadcast(const CMasternodeBroadcast& mnb)
+{
+    uint256 hash = mnb.GetHash();
+    if (!mapSeenMasternodeBroadcast.insert(make_pair(hash, mnb)).second) return;
+    LOCK(cs_expiry);
+    expirySeenBroadcast.Add(hash, mnb.lastPing.sigTime + MASTERNODE_REMOVAL_SECONDS * 2);
+}
+
+void CMasternodeMan::AddSeenPing(const CMasternodePing& mnp)
+{
+    uint256 hash = mnp.GetHash();
+    if (!mapSeenMasternodePing.insert(make_pair(hash, mnp)).second) return;
+    LOCK(cs_expiry);
+    expirySeenPing.Add(hash, mnp.sigTime + MASTERNODE_REMOVAL_SECONDS * 2);
+}
+
+void CMasternodeMan::RebuildExpiryIndexes()
+{
+    LOCK2(cs, cs_expiry);
+    expiryAskedUsForList.Clear();
+    for (std::map<CNetAddr, int64_t>::iterator it = mAskedUsForMasternodeList.begin(); it != mAskedUsForMasternodeList.end(); ++it)
+        expiryAskedUsForList.Add(it->first, it->second);
+    expiryWeAskedForList.Clear();
+    for (std::map<CNetAddr, int64_t>::iterator it = mWeAskedForMasternodeList.begin(); it != mWeAskedForMasternodeList.end(); ++it)
+        expiryWeAskedForList.Add(it->first, it->second);
+    expiryWeAskedForListEntry.Clear();
+    for (std::map<COutPoint, int64_t>::iterator it = mWeAskedForMasternodeListEntry.begin(); it != mWeAskedForMasternodeListEntry.end(); ++it)
+        expiryWeAskedForListEntry.Add(it->first, it->second);
+    expirySeenBroadcast.Clear();
+    for (map<uint256, CMasternodeBroadcast>::iterator it = mapSeenMasternodeBroadcast.begin(); it != mapSeenMasternodeBroadcast.end(); ++it)
+        expirySeenBroadcast.Add(it->first, it->second.lastPing.sigTime + MASTERNODE_REMOVAL_SECONDS * 2);
+    expirySeenPing.Clear();
+    for (map<uint256, CMasternodePing>::iterator it = mapSeenMasternodePing.begin(); it != mapSeenMasternodePing.end(); ++it)
+        expirySeenPing.Add(it->first, it->second.sigTime + MASTERNODE_REMOVAL_SECONDS * 2);
 }
 
 void CMasternodeMan::Check()
@@ -243,7 +155,7 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
 {
     Check();
 
-    LOCK(cs);
+    LOCK2(cs, cs_expiry);
 
     //remove inactive and outdated
     vector<CMasternode>::iterator it = vMasternodes.begin();
@@ -277,61 +189,89 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
+            budget.MasternodeChanged((*it).vin);
             it = vMasternodes.erase(it);
+            ClearQuorums();
         } else {
             ++it;
         }
     }
 
-    // check who's asked for the Masternode list
-    map<CNetAddr, int64_t>::iterator it1 = mAskedUsForMasternodeList.begin();
-    while (it1 != mAskedUsForMasternodeList.end()) {
-        if ((*it1).second < GetTime()) {
-            mAskedUsForMasternodeList.erase(it1++);
-        } else {
-            ++it1;
+    {
+        LOCK(cs_quorums);
+        std::map<std::pair<uint256, std::pair<int, int> >, std::pair<int64_t, CMasternodeQuorumRef> >::iterator itQuorum = mapQuorums.begin();
+        while (itQuorum != mapQuorums.end()) {
+            if (GetTime() - itQuorum->second.first >= MASTERNODES_QUORUM_CACHE_SECONDS)
+                mapQuorums.erase(itQuorum++);
+            else
+                ++itQuorum;
         }
     }
 
+    // Only the entries in the due buckets of the expiry indexes are looked at. An
+    // entry that is gone already is skipped, one whose time moved on is indexed again.
+    int64_t nNow = GetTime();
+
+    // check who's asked for the Masternode list
+    std::vector<CNetAddr> vAddr;
+    expiryAskedUsForList.Expire(nNow, vAddr);
+    BOOST_FOREACH (const CNetAddr& addr, vAddr) {
+        map<CNetAddr, int64_t>::iterator it1 = mAskedUsForMasternodeList.find(addr);
+        if (it1 == mAskedUsForMasternodeList.end()) continue;
+        if ((*it1).second < nNow)
+            mAskedUsForMasternodeList.erase(it1);
+        else
+            expiryAskedUsForList.Add(addr, (*it1).second);
+    }
+
     // check who we asked for the Masternode list
-    it1 = mWeAskedForMasternodeList.begin();
-    while (it1 != mWeAskedForMasternodeList.end()) {
-        if ((*it1).second < GetTime()) {
-            mWeAskedForMasternodeList.erase(it1++);
-        } else {
-            ++it1;
-        }
+    vAddr.clear();
+    expiryWeAskedForList.Expire(nNow, vAddr);
+    BOOST_FOREACH (const CNetAddr& addr, vAddr) {
+        map<CNetAddr, int64_t>::iterator it1 = mWeAskedForMasternodeList.find(addr);
+        if (it1 == mWeAskedForMasternodeList.end()) continue;
+        if ((*it1).second < nNow)
+            mWeAskedForMasternodeList.erase(it1);
+        else
+            expiryWeAskedForList.Add(addr, (*it1).second);
     }
 
     // check which Masternodes we've asked for
-    map<COutPoint, int64_t>::iterator it2 = mWeAskedForMasternodeListEntry.begin();
-    while (it2 != mWeAskedForMasternodeListEntry.end()) {
-        if ((*it2).second < GetTime()) {
-            mWeAskedForMasternodeListEntry.erase(it2++);
-        } else {
-            ++it2;
-        }
+    std::vector<COutPoint> vOutpoint;
+    expiryWeAskedForListEntry.Expire(nNow, vOutpoint);
+    BOOST_FOREACH (const COutPoint& outpoint, vOutpoint) {
+        map<COutPoint, int64_t>::iterator it2 = mWeAskedForMasternodeListEntry.find(outpoint);
+        if (it2 == mWeAskedForMasternodeListEntry.end()) continue;
+        if ((*it2).second < nNow)
+            mWeAskedForMasternodeListEntry.erase(it2);
+        else
+            expiryWeAskedForListEntry.Add(outpoint, (*it2).second);
     }
 
     // remove expired mapSeenMasternodeBroadcast
-    map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-    while (it3 != mapSeenMasternodeBroadcast.end()) {
-        if ((*it3).second.lastPing.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            mapSeenMasternodeBroadcast.erase(it3++);
-            masternodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
+    std::vector<uint256> vHash;
+    expirySeenBroadcast.Expire(nNow - MASTERNODE_REMOVAL_SECONDS * 2, vHash);
+    BOOST_FOREACH (const uint256& hash, vHash) {
+        map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.find(hash);
+        if (it3 == mapSeenMasternodeBroadcast.end()) continue;
+        if ((*it3).second.lastPing.sigTime < nNow - (MASTERNODE_REMOVAL_SECONDS * 2)) {
+            masternodeSync.mapSeenSyncMNB.erase(hash);
+            mapSeenMasternodeBroadcast.erase(it3);
         } else {
-            ++it3;
+            expirySeenBroadcast.Add(hash, (*it3).second.lastPing.sigTime + MASTERNODE_REMOVAL_SECONDS * 2);
         }
     }
 
     // remove expired mapSeenMasternodePing
-    map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.begin();
-    while (it4 != mapSeenMasternodePing.end()) {
-        if ((*it4).second.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            mapSeenMasternodePing.erase(it4++);
-        } else {
-            ++it4;
-        }
+    vHash.clear();
+    expirySeenPing.Expire(nNow - MASTERNODE_REMOVAL_SECONDS * 2, vHash);
+    BOOST_FOREACH (const uint256& hash, vHash) {
+        map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.find(hash);
+        if (it4 == mapSeenMasternodePing.end()) continue;
+        if ((*it4).second.sigTime < nNow - (MASTERNODE_REMOVAL_SECONDS * 2))
+            mapSeenMasternodePing.erase(it4);
+        else
+            expirySeenPing.Add(hash, (*it4).second.sigTime + MASTERNODE_REMOVAL_SECONDS * 2);
     }
 }
 
@@ -345,6 +285,61 @@ void CMasternodeMan::Clear()
     mapSeenMasternodeBroadcast.clear();
     mapSeenMasternodePing.clear();
     nDsqCount = 0;
+    ClearQuorums();
+    budget.MasternodeListReset();
+
+    {
+        LOCK(cs_expiry);
+        expiryAskedUsForList.Clear();
+        expiryWeAskedForList.Clear();
+        expiryWeAskedForListEntry.Clear();
+        expirySeenBroadcast.Clear();
+        expirySeenPing.Clear();
+    }
+}
+
+bool CMasternodeMan::WriteCache(CMasternodeCacheDB& db, unsigned int& nWritten, unsigned int& nErased)
+{
+    LOCK(cs);
+
+    BOOST_FOREACH (const CMasternode& mn, vMasternodes)
+        db.WriteRecord('m', mn.vin.prevout, mn);
+    db.WriteRecords('a', mAskedUsForMasternodeList);
+    db.WriteRecords('w', mWeAskedForMasternodeList);
+    db.WriteRecords('e', mWeAskedForMasternodeListEntry);
+    db.WriteRecords('b', mapSeenMasternodeBroadcast);
+    db.WriteRecords('p', mapSeenMasternodePing);
+    db.WriteRecord('d', std::string("dsqcount"), nDsqCount);
+
+    return db.Commit(nWritten, nErased);
+}
+
+bool CMasternodeMan::ReadCache(CMasternodeCacheDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+    std::map<COutPoint, CMasternode> mapMasternodes;
+    std::map<std::string, int64_t> mapCounters;
+
+    LOCK(cs);
+    bool fOk = db.ReadRecords('m', mapMasternodes);
+    fOk &= db.ReadRecords('a', mAskedUsForMasternodeList);
+    fOk &= db.ReadRecords('w', mWeAskedForMasternodeList);
+    fOk &= db.ReadRecords('e', mWeAskedForMasternodeListEntry);
+    fOk &= db.ReadRecords('b', mapSeenMasternodeBroadcast);
+    fOk &= db.ReadRecords('p', mapSeenMasternodePing);
+    fOk &= db.ReadRecords('d', mapCounters);
+
+    vMasternodes.reserve(mapMasternodes.size());
+    for (std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.begin(); it != mapMasternodes.end(); ++it)
+        vMasternodes.push_back(it->second);
+    nDsqCount = mapCounters["dsqcount"];
+    RebuildExpiryIndexes();
+    ClearQuorums();
+    budget.MasternodeListReset();
+
+    LogPrintf("Loaded masternode cache  %dms\n", GetTimeMillis() - nStart);
+    LogPrintf("  %s\n", ToString());
+    return fOk;
 }
 
 int CMasternodeMan::stable_size ()
@@ -388,6 +383,13 @@ int CMasternodeMan::CountEnabled(int protocolVersion)
     return i;
 }
 
+int CMasternodeMan::CountEnabledAtTip(int protocolVersion)
+{
+    CMasternodeQuorumRef quorum = GetQuorum(0, protocolVersion, QUORUM_ONLY_ACTIVE);
+    if (!quorum) return CountEnabled(protocolVersion);
+    return quorum->size();
+}
+
 void CMasternodeMan::CountNetworks(int protocolVersion, int& ipv4, int& ipv6, int& onion)
 {
     protocolVersion = protocolVersion == -1 ? masternodePayments.GetMinMasternodePaymentsProto() : protocolVersion;
@@ -429,9 +431,63 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
         }
     }
 
-    pnode->PushMessage("dseg", CTxIn());
+    if (masternodeSync.UseDigests(pnode)) {
+        // the peer only sends the entries in buckets whose digest differs from its own
+        unsigned int nBuckets = std::min((vMasternodes.size() + MASTERNODE_SYNC_DIGEST_BUCKET_SIZE - 1) / MASTERNODE_SYNC_DIGEST_BUCKET_SIZE,
+            (size_t)MASTERNODE_SYNC_DIGEST_BUCKETS_MAX);
+        pnode->PushMessage("dsegd", GetListDigests(nBuckets));
+    } else
+        pnode->PushMessage("dseg", CTxIn());
     int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
+    {
+        LOCK(cs_expiry);
+        expiryWeAskedForList.Add(pnode->addr, askAgain);
+    }
+}
+
+static unsigned int GetDigestBucket(const uint256& hash, unsigned int nBuckets)
+{
+    return hash.GetLow64() % nBuckets;
+}
+
+std::vector<uint256> CMasternodeMan::GetListDigests(unsigned int nBuckets)
+{
+    LOCK(cs);
+
+    std::vector<uint256> vDigests(nBuckets);
+    if (nBuckets == 0) return vDigests;
+
+    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
+        if (mn.addr.IsRFC1918() || !mn.IsEnabled()) continue;
+        uint256 hash = CMasternodeBroadcast(mn).GetHash();
+        vDigests[GetDigestBucket(hash, nBuckets)] ^= hash;
+    }
+
+    return vDigests;
+}
+
+bool CMasternodeMan::CheckListRequest(CNode* pfrom)
+{
+    //local network
+    bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
+
+    if (!isLocal && Params().NetworkID() == CBaseChainParams::MAIN) {
+        std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
+        if (i != mAskedUsForMasternodeList.end()) {
+            int64_t t = (*i).second;
+            if (GetTime() < t) {
+                Misbehaving(pfrom->GetId(), 34);
+                LogPrintf("dseg - peer already asked me for the list\n");
+                return false;
+            }
+        }
+        int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
+        mAskedUsForMasternodeList[pfrom->addr] = askAgain;
+        LOCK(cs_expiry);
+        expiryAskedUsForList.Add(pfrom->addr, askAgain);
+    }
+    return true;
 }
 
 CMasternode* CMasternodeMan::Find(const CScript& payee)
@@ -590,31 +646,19 @@ CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight,
     return winner;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+void CMasternodeMan::GetMasternodeScores(int64_t nBlockHeight, int minProtocol, int nFilters, std::vector<pair<int64_t, CTxIn> >& vecMasternodeScores)
 {
-    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
     int64_t nMasternode_Min_Age = GetSporkValue(SPORK_16_MN_WINNER_MINIMUM_AGE);
     int64_t nMasternode_Age = 0;
-	CCoins coins;
-
-    //make sure we know about this block
-    uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return -1;
 
     // scan for winner
     BOOST_FOREACH (CMasternode& mn, vMasternodes) {
         if (mn.protocolVersion < minProtocol) {
-            LogPrintf("Skipping Masternode with obsolete version %d\n", mn.protocolVersion);
+            LogPrint("masternode", "Skipping Masternode with obsolete version %d\n", mn.protocolVersion);
             continue;                                                       // Skip obsolete versions
         }
 
-		
-		
-	
-	
-		
-
-        if (IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)) {
+        if ((nFilters & QUORUM_MIN_AGE) && IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)) {
             nMasternode_Age = GetAdjustedTime() - mn.sigTime;
             if ((nMasternode_Age) < nMasternode_Min_Age) {
                 if (fDebug){
@@ -623,7 +667,7 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
                 continue;  // Skip masternodes younger than (default) 8000 sec
             }
         }
-        if (fOnlyActive) {
+        if (nFilters & QUORUM_ONLY_ACTIVE) {
             mn.Check();
             if (!mn.IsEnabled()) continue;
         }
@@ -634,12 +678,52 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
     }
 
     sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
+}
 
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecMasternodeScores) {
-        rank++;
-        if (s.second.prevout == vin.prevout) {
-            return rank;
+CMasternodeQuorumRef CMasternodeMan::GetQuorum(int64_t nBlockHeight, int minProtocol, int nFilters)
+{
+    //make sure we know about this block
+    uint256 hash = 0;
+    if (!GetBlockHash(hash, nBlockHeight)) return CMasternodeQuorumRef();
+
+    // the scores only depend on the block hash, so a reorg gets rankings of its own
+    std::pair<uint256, std::pair<int, int> > key = make_pair(hash, make_pair(minProtocol, nFilters));
+    {
+        LOCK(cs_quorums);
+        std::map<std::pair<uint256, std::pair<int, int> >, std::pair<int64_t, CMasternodeQuorumRef> >::iterator it = mapQuorums.find(key);
+        if (it != mapQuorums.end() && GetTime() - it->second.first < MASTERNODES_QUORUM_CACHE_SECONDS)
+            return it->second.second;
+    }
+
+    // score without cs_quorums held, checking the masternodes takes cs_main
+    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
+    GetMasternodeScores(nBlockHeight, minProtocol, nFilters, vecMasternodeScores);
+
+    boost::shared_ptr<std::vector<CTxIn> > pvecRanked(new std::vector<CTxIn>());
+    pvecRanked->reserve(vecMasternodeScores.size());
+    BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecMasternodeScores)
+        pvecRanked->push_back(s.second);
+
+    CMasternodeQuorumRef quorum(pvecRanked);
+    LOCK(cs_quorums);
+    mapQuorums[key] = make_pair(GetTime(), quorum);
+    return quorum;
+}
+
+void CMasternodeMan::ClearQuorums()
+{
+    LOCK(cs_quorums);
+    mapQuorums.clear();
+}
+
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
+    CMasternodeQuorumRef quorum = GetQuorum(nBlockHeight, minProtocol, QUORUM_MIN_AGE | (fOnlyActive ? QUORUM_ONLY_ACTIVE : 0));
+    if (!quorum) return -1;
+
+    for (unsigned int i = 0; i < quorum->size(); i++) {
+        if ((*quorum)[i].prevout == vin.prevout) {
+            return i + 1;
         }
     }
 
@@ -686,33 +770,10 @@ std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
-
-    // scan for winner
-    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        if (mn.protocolVersion < minProtocol) continue;
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled()) continue;
-        }
-
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(make_pair(n2, mn.vin));
-    }
+    CMasternodeQuorumRef quorum = GetQuorum(nBlockHeight, minProtocol, fOnlyActive ? QUORUM_ONLY_ACTIVE : 0);
+    if (!quorum || nRank < 1 || nRank > (int)quorum->size()) return NULL;
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
-
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecMasternodeScores) {
-        rank++;
-        if (rank == nRank) {
-            return Find(s.second);
-        }
-    }
-
-    return NULL;
+    return Find((*quorum)[nRank - 1]);
 }
 
 void CMasternodeMan::ProcessMasternodeConnections()
@@ -740,13 +801,13 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
     if (strCommand == "mnb") { //Masternode Broadcast
         CMasternodeBroadcast mnb;
-        vRecv >> mnb;
+        pfrom->ReadMessage(vRecv, mnb);
 
         if (mapSeenMasternodeBroadcast.count(mnb.GetHash())) { //seen
             masternodeSync.AddedMasternodeList(mnb.GetHash());
             return;
         }
-        mapSeenMasternodeBroadcast.insert(make_pair(mnb.GetHash(), mnb));
+        AddSeenBroadcast(mnb);
 
         int nDoS = 0;
         if (!mnb.CheckAndUpdate(nDoS)) {
@@ -766,7 +827,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         }
 
         // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
+        //  - this is checked later by .check() in many places and by the scheduled masternode checks
         if (mnb.CheckInputsAndAdd(nDoS)) {
             // use this as a peer
             addrman.Add(CAddress(mnb.addr), pfrom->addr, 2 * 60 * 60);
@@ -781,15 +842,15 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
 
     else if (strCommand == "mnp") { //Masternode Ping
         CMasternodePing mnp;
-        vRecv >> mnp;
+        pfrom->ReadMessage(vRecv, mnp);
 
         LogPrint("masternode", "mnp - Masternode ping, vin: %s\n", mnp.vin.prevout.hash.ToString());
 
         if (mapSeenMasternodePing.count(mnp.GetHash())) return; //seen
-        mapSeenMasternodePing.insert(make_pair(mnp.GetHash(), mnp));
+        AddSeenPing(mnp);
 
         int nDoS = 0;
-        if (mnp.CheckAndUpdate(nDoS)) return;
+        if (mnp.CheckAndUpdate(nDoS, true, pfrom->fRelayMasternodeMessages)) return;
 
         if (nDoS > 0) {
             // if anything significant failed, mark that node
@@ -811,26 +872,12 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         vRecv >> vin;
 
         if (vin == CTxIn()) { //only should ask for this once
-            //local network
-            bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
-
-            if (!isLocal && Params().NetworkID() == CBaseChainParams::MAIN) {
-                std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
-                if (i != mAskedUsForMasternodeList.end()) {
-                    int64_t t = (*i).second;
-                    if (GetTime() < t) {
-                        Misbehaving(pfrom->GetId(), 34);
-                        LogPrintf("dseg - peer already asked me for the list\n");
-                        return;
-                    }
-                }
-                int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
-                mAskedUsForMasternodeList[pfrom->addr] = askAgain;
-            }
+            if (!CheckListRequest(pfrom)) return;
         } //else, asking for a specific node which is ok
 
 
         int nInvCount = 0;
+        std::vector<CInv> vInv;
 
         BOOST_FOREACH (CMasternode& mn, vMasternodes) {
             if (mn.addr.IsRFC1918()) continue; //local network
@@ -840,10 +887,13 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                 if (vin == CTxIn() || vin == mn.vin) {
                     CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
                     uint256 hash = mnb.GetHash();
-                    pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+                    if (vin == CTxIn())
+                        vInv.push_back(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+                    else
+                        pfrom->PushInventory(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
                     nInvCount++;
 
-                    if (!mapSeenMasternodeBroadcast.count(hash)) mapSeenMasternodeBroadcast.insert(make_pair(hash, mnb));
+                    AddSeenBroadcast(mnb);
 
                     if (vin == mn.vin) {
                         LogPrint("masternode", "dseg - Sent 1 Masternode entry to peer %i\n", pfrom->GetId());
@@ -854,9 +904,50 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         }
 
         if (vin == CTxIn()) {
+            // the count follows the entries, so the peer knows it has all of them
+            pfrom->PushInventoryNow(vInv);
             pfrom->PushMessage("ssc", MASTERNODE_SYNC_LIST, nInvCount);
             LogPrint("masternode", "dseg - Sent %d Masternode entries to peer %i\n", nInvCount, pfrom->GetId());
         }
+
+    } else if (strCommand == "dsegd") { //Get the Masternode list entries missing from the peer's digests
+
+        std::vector<uint256> vDigests;
+        vRecv >> vDigests;
+
+        if (vDigests.size() > MASTERNODE_SYNC_DIGEST_BUCKETS_MAX) {
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+        if (!CheckListRequest(pfrom)) return;
+
+        LOCK(cs);
+        std::vector<uint256> vOurDigests = GetListDigests(vDigests.size());
+
+        // the count covers the entries in matching buckets too, as if they were sent
+        int nInvCount = 0;
+        std::vector<CInv> vInv;
+
+        BOOST_FOREACH (CMasternode& mn, vMasternodes) {
+            if (mn.addr.IsRFC1918() || !mn.IsEnabled()) continue;
+
+            CMasternodeBroadcast mnb = CMasternodeBroadcast(mn);
+            uint256 hash = mnb.GetHash();
+            nInvCount++;
+
+            if (!vDigests.empty()) {
+                unsigned int nBucket = GetDigestBucket(hash, vDigests.size());
+                if (vDigests[nBucket] == vOurDigests[nBucket]) continue;
+            }
+
+            vInv.push_back(CInv(MSG_MASTERNODE_ANNOUNCE, hash));
+
+            AddSeenBroadcast(mnb);
+        }
+
+        pfrom->PushInventoryNow(vInv);
+        pfrom->PushMessage("ssc", MASTERNODE_SYNC_LIST, nInvCount);
+        LogPrint("masternode", "dsegd - Sent %d of %d Masternode entries to peer %i\n", vInv.size(), nInvCount, pfrom->GetId());
     }
     /*
      * IT'S SAFE TO REMOVE THIS IN FURTHER VERSIONS
@@ -991,7 +1082,7 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         LogPrint("masternode", "dsee - Got NEW OLD Masternode entry %s\n", vin.prevout.hash.ToString());
 
         // make sure it's still unspent
-        //  - this is checked later by .check() in many places and by ThreadCheckObfuScationPool()
+        //  - this is checked later by .check() in many places and by the scheduled masternode checks
 
         CValidationState state;
         CMutableTransaction tx = CMutableTransaction();
@@ -1018,7 +1109,11 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             // should be at least not earlier than block when 1000 SAVIOUR tx got MASTERNODE_MIN_CONFIRMATIONS
             uint256 hashBlock = 0;
             CTransaction tx2;
-            GetTransaction(vin.prevout.hash, tx2, hashBlock, true);
+            if (!GetTransaction(vin.prevout.hash, tx2, hashBlock, true)) {
+                CCoins coins;
+                if (fHavePruned)
+                    GetUnspentTransactionOutputs(vin.prevout.hash, coins, hashBlock);
+            }
             BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
             if (mi != mapBlockIndex.end() && (*mi).second) {
                 CBlockIndex* pMNIndex = (*mi).second;                                                        // block for masternode amount of  SAVIOUR tx -> 1 confirmation 
@@ -1149,7 +1244,9 @@ void CMasternodeMan::Remove(CTxIn vin)
     while (it != vMasternodes.end()) {
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
+            budget.MasternodeChanged(vin);
             vMasternodes.erase(it);
+            ClearQuorums();
             break;
         }
         ++it;
@@ -1159,8 +1256,8 @@ void CMasternodeMan::Remove(CTxIn vin)
 void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
 {
     LOCK(cs);
-    mapSeenMasternodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
-    mapSeenMasternodeBroadcast.insert(std::make_pair(mnb.GetHash(), mnb));
+    AddSeenPing(mnb.lastPing);
+    AddSeenBroadcast(mnb);
 
     LogPrintf("CMasternodeMan::UpdateMasternodeList -- masternode=%s\n", mnb.vin.prevout.ToStringShort());
 
@@ -1172,9 +1269,32 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         }
     } else if (pmn->UpdateFromNewBroadcast(mnb)) {
         masternodeSync.AddedMasternodeList(mnb.GetHash());
+        ClearQuorums();
     }
 }
 
+void CMasternodeMan::GetMemoryUsage(std::map<std::string, std::pair<size_t, size_t> >& mapUsage) const
+{
+    LOCK2(cs, cs_expiry);
+    mapUsage["vMasternodes"] = std::make_pair(vMasternodes.size(), memusage::DynamicUsage(vMasternodes));
+    mapUsage["mAskedUsForMasternodeList"] = std::make_pair(mAskedUsForMasternodeList.size(),
+        memusage::DynamicUsage(mAskedUsForMasternodeList) + expiryAskedUsForList.DynamicMemoryUsage());
+    mapUsage["mWeAskedForMasternodeList"] = std::make_pair(mWeAskedForMasternodeList.size(),
+        memusage::DynamicUsage(mWeAskedForMasternodeList) + expiryWeAskedForList.DynamicMemoryUsage());
+    mapUsage["mWeAskedForMasternodeListEntry"] = std::make_pair(mWeAskedForMasternodeListEntry.size(),
+        memusage::DynamicUsage(mWeAskedForMasternodeListEntry) + expiryWeAskedForListEntry.DynamicMemoryUsage());
+    mapUsage["mapSeenMasternodeBroadcast"] = std::make_pair(mapSeenMasternodeBroadcast.size(),
+        memusage::DynamicUsage(mapSeenMasternodeBroadcast) + expirySeenBroadcast.DynamicMemoryUsage());
+    mapUsage["mapSeenMasternodePing"] = std::make_pair(mapSeenMasternodePing.size(),
+        memusage::DynamicUsage(mapSeenMasternodePing) + expirySeenPing.DynamicMemoryUsage());
+
+    LOCK(cs_quorums);
+    size_t nQuorumUsage = memusage::DynamicUsage(mapQuorums);
+    for (std::map<std::pair<uint256, std::pair<int, int> >, std::pair<int64_t, CMasternodeQuorumRef> >::const_iterator it = mapQuorums.begin(); it != mapQuorums.end(); ++it)
+        nQuorumUsage += memusage::DynamicUsage(it->second.second) + memusage::DynamicUsage(*it->second.second);
+    mapUsage["mapQuorums"] = std::make_pair(mapQuorums.size(), nQuorumUsage);
+}
+
 std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
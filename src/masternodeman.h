@@ -8,15 +8,26 @@
 #define MASTERNODEMAN_H
 
 #include "base58.h"
+#include "expiryindex.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
+#include "masternode-cachedb.h"
 #include "net.h"
 #include "sync.h"
 #include "util.h"
 
+#include <boost/shared_ptr.hpp>
+
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
+// Granularity of the expiry indexes of the maps below, CheckAndRemove() runs about once a minute
+#define MASTERNODES_EXPIRY_BUCKET_SECONDS 60
+// How long a ranking of the list is reused while the list doesn't change
+#define MASTERNODES_QUORUM_CACHE_SECONDS 60
+
+/** Vins of the masternodes that pass the filters of a ranking, best score first */
+typedef boost::shared_ptr<const std::vector<CTxIn> > CMasternodeQuorumRef;
 
 using namespace std;
 
@@ -25,29 +36,8 @@ class CMasternodeMan;
 extern CMasternodeMan mnodeman;
 void DumpMasternodes();
 
-/** Access to the MN database (mncache.dat)
- */
-class CMasternodeDB
-{
-private:
-    boost::filesystem::path pathMN;
-    std::string strMagicMessage;
-
-public:
-    enum ReadResult {
-        Ok,
-        FileError,
-        HashReadError,
-        IncorrectHash,
-        IncorrectMagicMessage,
-        IncorrectMagicNumber,
-        IncorrectFormat
-    };
-
-    CMasternodeDB();
-    bool Write(const CMasternodeMan& mnodemanToSave);
-    ReadResult Read(CMasternodeMan& mnodemanToLoad, bool fDryRun = false);
-};
+/** The masternode list on disk (mncache/) */
+extern CMasternodeCacheDB* pmncachedb;
 
 class CMasternodeMan
 {
@@ -67,6 +57,36 @@ private:
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // the keys of the maps above and below by when they expire
+    mutable CCriticalSection cs_expiry;
+    CExpiryIndex<CNetAddr> expiryAskedUsForList;
+    CExpiryIndex<CNetAddr> expiryWeAskedForList;
+    CExpiryIndex<COutPoint> expiryWeAskedForListEntry;
+    CExpiryIndex<uint256> expirySeenBroadcast;
+    CExpiryIndex<uint256> expirySeenPing;
+
+    /// Check a peer doesn't ask for the whole list too often
+    bool CheckListRequest(CNode* pfrom);
+
+    /// Index every entry of the maps again, after they were loaded
+    void RebuildExpiryIndexes();
+
+    // Rankings of the list from one scoring pass each, by the block they are scored
+    // against, the minimum protocol and the QUORUM_ filters. SwiftTX, obfuscation
+    // relays and payment votes look their masternodes up here; the rankings are
+    // dropped whenever the list changes.
+    enum {
+        QUORUM_ONLY_ACTIVE = 1,
+        QUORUM_MIN_AGE = 2
+    };
+    mutable CCriticalSection cs_quorums;
+    std::map<std::pair<uint256, std::pair<int, int> >, std::pair<int64_t, CMasternodeQuorumRef> > mapQuorums;
+
+    /// Score the masternodes at a height, best first
+    void GetMasternodeScores(int64_t nBlockHeight, int minProtocol, int nFilters, std::vector<pair<int64_t, CTxIn> >& vecMasternodeScores);
+    /// The ranking of the list at a height, scored once and cached; NULL if the block is unknown
+    CMasternodeQuorumRef GetQuorum(int64_t nBlockHeight, int minProtocol, int nFilters);
+
 public:
     // Keep track of all broadcasts I've seen
     map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
@@ -90,6 +110,8 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
+        if (ser_action.ForRead())
+            RebuildExpiryIndexes();
     }
 
     CMasternodeMan();
@@ -101,6 +123,10 @@ public:
     /// Ask (source) node for mnb
     void AskForMN(CNode* pnode, CTxIn& vin);
 
+    /// Remember a broadcast or ping as seen, unless it is already
+    void AddSeenBroadcast(const CMasternodeBroadcast& mnb);
+    void AddSeenPing(const CMasternodePing& mnp);
+
     /// Check all Masternodes
     void Check();
 
@@ -109,13 +135,30 @@ public:
 
     /// Clear Masternode vector
     void Clear();
+    /// Drop the cached rankings, a masternode was enabled or disabled
+    void ClearQuorums();
+
+    /// Write the entries that changed since the last flush to the cache database
+    bool WriteCache(CMasternodeCacheDB& db, unsigned int& nWritten, unsigned int& nErased);
+
+    /// Load the entries from the cache database
+    bool ReadCache(CMasternodeCacheDB& db);
 
     int CountEnabled(int protocolVersion = -1);
+    /// CountEnabled() for the tip, from the cached ranking instead of checking every entry
+    int CountEnabledAtTip(int protocolVersion);
 
     void CountNetworks(int protocolVersion, int& ipv4, int& ipv6, int& onion);
 
+    /// Number of entries and approximate memory usage in bytes of each map, by name
+    void GetMemoryUsage(std::map<std::string, std::pair<size_t, size_t> >& mapUsage) const;
+
+    /// Ask a peer for the list, or with digests only for the entries we are missing
     void DsegUpdate(CNode* pnode);
 
+    /// Digests of the entries a dseg sends, split into nBuckets buckets by hash
+    std::vector<uint256> GetListDigests(unsigned int nBuckets);
+
     /// Find an entry
     CMasternode* Find(const CScript& payee);
     CMasternode* Find(const CTxIn& vin);
@@ -17,6 +17,7 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "timedata.h"
+#include "txmempool.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #ifdef ENABLE_WALLET
@@ -24,8 +25,10 @@
 #endif
 #include "masternode-payments.h"
 
+#include <boost/multi_index/identity.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index_container.hpp>
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple.hpp>
 
 using namespace std;
 
@@ -34,53 +37,339 @@ using namespace std;
 // SAVIOURMiner
 //
 
+uint64_t nLastBlockTx = 0;
+uint64_t nLastBlockSize = 0;
+int64_t nLastCoinStakeSearchInterval = 0;
+
 //
-// Unconfirmed transactions in the memory pool often depend on other
-// transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
-// The COrphan class keeps track of these 'temporary orphans' while
-// CreateBlock is figuring out which transactions to include.
+// Block transactions are picked straight from the mempool indexes, which
+// addUnchecked, removeForBlock and the reorg handling keep current: the
+// ancestor score index already orders every transaction together with its
+// unconfirmed ancestors by fee rate, so building a template no longer walks
+// the whole pool looking up coins. Only the transactions that end up in the
+// block are checked against the UTXO set.
 //
-class COrphan
+
+namespace
 {
-public:
-    const CTransaction* ptx;
-    set<uint256> setDependsOn;
-    CFeeRate feeRate;
-    double dPriority;
+// A mempool entry whose ancestor state leaves out the ancestors already
+// selected for the block
+struct CTxMemPoolModifiedEntry {
+    CTxMemPoolModifiedEntry(CTxMemPool::txiter entry)
+    {
+        iter = entry;
+        nSizeWithAncestors = entry->GetSizeWithAncestors();
+        nModFeesWithAncestors = entry->GetModFeesWithAncestors();
+    }
+
+    CTxMemPool::txiter iter;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+};
 
-    COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0)
+struct modifiedentry_iter {
+    typedef CTxMemPool::txiter result_type;
+    result_type operator()(const CTxMemPoolModifiedEntry& entry) const
     {
+        return entry.iter;
     }
 };
 
-uint64_t nLastBlockTx = 0;
-uint64_t nLastBlockSize = 0;
-int64_t nLastCoinStakeSearchInterval = 0;
+// Same order as CompareTxMemPoolEntryByAncestorFee, on the modified state
+struct CompareModifiedEntry {
+    bool operator()(const CTxMemPoolModifiedEntry& a, const CTxMemPoolModifiedEntry& b) const
+    {
+        double f1 = (double)a.nModFeesWithAncestors * b.nSizeWithAncestors;
+        double f2 = (double)b.nModFeesWithAncestors * a.nSizeWithAncestors;
+        if (f1 == f2)
+            return CTxMemPool::CompareIteratorByHash()(a.iter, b.iter);
+        return f1 > f2;
+    }
+};
 
-// We want to sort transactions by priority and fee rate, so:
-typedef boost::tuple<double, CFeeRate, const CTransaction*> TxPriority;
-class TxPriorityCompare
+// A transaction always has more ancestors than any of its parents, so this
+// is a valid order for the transactions of a package within a block
+struct CompareTxIterByAncestorCount {
+    bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b) const
+    {
+        if (a->GetCountWithAncestors() != b->GetCountWithAncestors())
+            return a->GetCountWithAncestors() < b->GetCountWithAncestors();
+        return CTxMemPool::CompareIteratorByHash()(a, b);
+    }
+};
+
+struct update_for_parent_inclusion {
+    update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
+
+    void operator()(CTxMemPoolModifiedEntry& e)
+    {
+        e.nModFeesWithAncestors -= iter->GetModifiedFee();
+        e.nSizeWithAncestors -= iter->GetTxSize();
+    }
+
+    CTxMemPool::txiter iter;
+};
+
+typedef boost::multi_index_container<
+    CTxMemPoolModifiedEntry,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            modifiedentry_iter,
+            CTxMemPool::CompareIteratorByHash>,
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<ancestor_score>,
+            boost::multi_index::identity<CTxMemPoolModifiedEntry>,
+            CompareModifiedEntry> > >
+    indexed_modified_transaction_set;
+
+typedef indexed_modified_transaction_set::nth_index<0>::type::iterator modtxiter;
+typedef indexed_modified_transaction_set::index<ancestor_score>::type::iterator modtxscoreiter;
+
+// We want to sort transactions by priority, so:
+typedef std::pair<double, CTxMemPool::txiter> TxCoinAgePriority;
+struct TxCoinAgePriorityCompare {
+    bool operator()(const TxCoinAgePriority& a, const TxCoinAgePriority& b) const
+    {
+        if (a.first == b.first)
+            return CTxMemPool::CompareIteratorByHash()(b.second, a.second);
+        return a.first < b.first;
+    }
+};
+
+class CBlockTxSelector
 {
-    bool byFee;
+private:
+    CTxMemPool& pool;
+    const int nHeight;
+    const unsigned int nBlockMaxSize;
+    const unsigned int nBlockPrioritySize;
+    const unsigned int nBlockMinSize;
+    std::vector<CTxMemPool::txiter>& vSelected;
+
+    uint64_t nBlockSize;
+    CTxMemPool::setEntries inBlock;
+
+    void AddToBlock(CTxMemPool::txiter iter)
+    {
+        vSelected.push_back(iter);
+        nBlockSize += iter->GetTxSize();
+        inBlock.insert(iter);
+    }
+
+    bool IsFinal(CTxMemPool::txiter iter) const
+    {
+        const CTransaction& tx = iter->GetTx();
+        return !tx.IsCoinBase() && !tx.IsCoinStake() && IsFinalTx(tx, nHeight);
+    }
+
+    bool IsStillDependent(CTxMemPool::txiter iter) const
+    {
+        BOOST_FOREACH (CTxMemPool::txiter parent, pool.GetMemPoolParents(iter)) {
+            if (!inBlock.count(parent))
+                return true;
+        }
+        return false;
+    }
+
+    // Re-score the descendants of newly selected transactions without them
+    void UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set& mapModifiedTx)
+    {
+        BOOST_FOREACH (CTxMemPool::txiter it, alreadyAdded) {
+            CTxMemPool::setEntries descendants;
+            pool.CalculateDescendants(it, descendants);
+            BOOST_FOREACH (CTxMemPool::txiter desc, descendants) {
+                if (alreadyAdded.count(desc))
+                    continue;
+                modtxiter mit = mapModifiedTx.find(desc);
+                if (mit == mapModifiedTx.end()) {
+                    CTxMemPoolModifiedEntry modEntry(desc);
+                    modEntry.nSizeWithAncestors -= it->GetTxSize();
+                    modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
+                    mapModifiedTx.insert(modEntry);
+                } else {
+                    mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
+                }
+            }
+        }
+    }
+
+    bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set& mapModifiedTx, const CTxMemPool::setEntries& failedTx) const
+    {
+        return mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it);
+    }
 
 public:
-    TxPriorityCompare(bool _byFee) : byFee(_byFee) {}
+    CBlockTxSelector(CTxMemPool& poolIn, int nHeightIn, unsigned int nBlockMaxSizeIn, unsigned int nBlockPrioritySizeIn, unsigned int nBlockMinSizeIn, std::vector<CTxMemPool::txiter>& vSelectedIn)
+        : pool(poolIn), nHeight(nHeightIn), nBlockMaxSize(nBlockMaxSizeIn), nBlockPrioritySize(nBlockPrioritySizeIn),
+          nBlockMinSize(nBlockMinSizeIn), vSelected(vSelectedIn), nBlockSize(1000)
+    {
+    }
 
-    bool operator()(const TxPriority& a, const TxPriority& b)
+    // Fill the first nBlockPrioritySize bytes with the oldest coins,
+    // regardless of the fees they pay
+    void AddPriorityTxs()
     {
-        if (byFee) {
-            if (a.get<1>() == b.get<1>())
-                return a.get<0>() < b.get<0>();
-            return a.get<1>() < b.get<1>();
-        } else {
-            if (a.get<0>() == b.get<0>())
-                return a.get<1>() < b.get<1>();
-            return a.get<0>() < b.get<0>();
+        if (nBlockPrioritySize == 0)
+            return;
+
+        std::vector<TxCoinAgePriority> vecPriority;
+        TxCoinAgePriorityCompare pricomparer;
+        std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
+        typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
+
+        // The entries carry their priority at entry height, so bringing it
+        // up to date needs no coin lookups
+        vecPriority.reserve(pool.mapTx.size());
+        for (CTxMemPool::indexed_transaction_set::iterator mi = pool.mapTx.begin(); mi != pool.mapTx.end(); ++mi) {
+            double dPriority = mi->GetPriority(nHeight);
+            CAmount dummy = 0;
+            pool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
+            vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
+        }
+        std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+
+        bool fPrintPriority = GetBoolArg("-printpriority", false);
+        while (!vecPriority.empty()) {
+            CTxMemPool::txiter iter = vecPriority.front().second;
+            double dPriority = vecPriority.front().first;
+            std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+            vecPriority.pop_back();
+
+            // Wait for the parents to make it in first
+            if (IsStillDependent(iter)) {
+                waitPriMap.insert(std::make_pair(iter, dPriority));
+                continue;
+            }
+
+            if (nBlockSize + iter->GetTxSize() >= nBlockMaxSize || !IsFinal(iter))
+                continue;
+
+            AddToBlock(iter);
+            if (fPrintPriority) {
+                LogPrintf("priority %.1f fee %s txid %s\n",
+                    dPriority, CFeeRate(iter->GetModifiedFee(), iter->GetTxSize()).ToString(), iter->GetTx().GetHash().ToString());
+            }
+
+            // Done once past the priority size or out of high-priority transactions
+            if (nBlockSize >= nBlockPrioritySize || !AllowFree(dPriority))
+                break;
+
+            // Children that were waiting on this one can go in now
+            BOOST_FOREACH (CTxMemPool::txiter child, pool.GetMemPoolChildren(iter)) {
+                waitPriIter wpiter = waitPriMap.find(child);
+                if (wpiter != waitPriMap.end()) {
+                    vecPriority.push_back(TxCoinAgePriority(wpiter->second, child));
+                    std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+                    waitPriMap.erase(wpiter);
+                }
+            }
+        }
+    }
+
+    // Fill the rest of the block with packages of transactions and their
+    // unconfirmed ancestors, best ancestor fee rate first
+    void AddPackageTxs()
+    {
+        indexed_modified_transaction_set mapModifiedTx;
+        CTxMemPool::setEntries failedTx;
+
+        // Descendants of the priority transactions no longer pay for them
+        UpdatePackagesForAdded(inBlock, mapModifiedTx);
+
+        CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = pool.mapTx.get<ancestor_score>().begin();
+        CTxMemPool::txiter iter;
+        while (mi != pool.mapTx.get<ancestor_score>().end() || !mapModifiedTx.empty()) {
+            // Skip entries that are selected, failed or now scored in mapModifiedTx
+            if (mi != pool.mapTx.get<ancestor_score>().end() &&
+                SkipMapTxEntry(pool.mapTx.project<0>(mi), mapModifiedTx, failedTx)) {
+                ++mi;
+                continue;
+            }
+
+            // Take the better of the next mapTx entry and the best modified one
+            bool fUsingModified = false;
+            modtxscoreiter modit = mapModifiedTx.get<ancestor_score>().begin();
+            if (mi == pool.mapTx.get<ancestor_score>().end()) {
+                iter = modit->iter;
+                fUsingModified = true;
+            } else {
+                iter = pool.mapTx.project<0>(mi);
+                if (modit != mapModifiedTx.get<ancestor_score>().end() &&
+                    CompareModifiedEntry()(*modit, CTxMemPoolModifiedEntry(iter))) {
+                    iter = modit->iter;
+                    fUsingModified = true;
+                } else {
+                    ++mi;
+                }
+            }
+
+            assert(!inBlock.count(iter));
+
+            uint64_t packageSize = iter->GetSizeWithAncestors();
+            CAmount packageFees = iter->GetModFeesWithAncestors();
+            if (fUsingModified) {
+                packageSize = modit->nSizeWithAncestors;
+                packageFees = modit->nModFeesWithAncestors;
+            }
+
+            // Everything left pays less than this: stop at free transactions
+            // once past the minimum block size
+            if (packageFees < ::minRelayTxFee.GetFee(packageSize) && nBlockSize >= nBlockMinSize)
+                return;
+
+            CTxMemPool::setEntries ancestors;
+            bool fFits = nBlockSize + packageSize < nBlockMaxSize;
+            if (fFits) {
+                uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+                std::string dummy;
+                pool.CalculateMemPoolAncestors(*iter, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+                for (CTxMemPool::setEntries::iterator it = ancestors.begin(); it != ancestors.end();) {
+                    if (inBlock.count(*it))
+                        ancestors.erase(it++);
+                    else
+                        ++it;
+                }
+                ancestors.insert(iter);
+                BOOST_FOREACH (CTxMemPool::txiter it, ancestors) {
+                    if (!IsFinal(it)) {
+                        fFits = false;
+                        break;
+                    }
+                }
+            }
+
+            if (!fFits) {
+                // The best modified entry is always looked at next, so a
+                // failed one has to go
+                if (fUsingModified) {
+                    mapModifiedTx.get<ancestor_score>().erase(modit);
+                    failedTx.insert(iter);
+                }
+                continue;
+            }
+
+            std::vector<CTxMemPool::txiter> sortedEntries(ancestors.begin(), ancestors.end());
+            std::sort(sortedEntries.begin(), sortedEntries.end(), CompareTxIterByAncestorCount());
+            for (size_t i = 0; i < sortedEntries.size(); i++) {
+                AddToBlock(sortedEntries[i]);
+                mapModifiedTx.erase(sortedEntries[i]);
+            }
+
+            UpdatePackagesForAdded(ancestors, mapModifiedTx);
         }
     }
 };
+} // anonymous namespace
+
+void SelectMempoolTransactions(CTxMemPool& pool, int nHeight, unsigned int nBlockMaxSize, unsigned int nBlockPrioritySize, unsigned int nBlockMinSize, std::vector<CTxMemPool::txiter>& vSelected)
+{
+    AssertLockHeld(pool.cs);
+    vSelected.clear();
+
+    CBlockTxSelector selector(pool, nHeight, nBlockMaxSize, nBlockPrioritySize, nBlockMinSize, vSelected);
+    selector.AddPriorityTxs();
+    selector.AddPackageTxs();
+}
 
 void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 {
@@ -168,123 +457,27 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         const int nHeight = pindexPrev->nHeight + 1;
         CCoinsViewCache view(pcoinsTip);
 
-        // Priority order to process transactions
-        list<COrphan> vOrphan; // list memory doesn't move
-        map<uint256, vector<COrphan*> > mapDependers;
-        bool fPrintPriority = GetBoolArg("-printpriority", false);
-
-        // This vector will be sorted into a priority queue:
-        vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-             mi != mempool.mapTx.end(); ++mi) {
-            const CTransaction& tx = mi->second.GetTx();
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
-                continue;
-
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            CAmount nTotalIn = 0;
-            bool fMissingInputs = false;
-            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-                // Read prev transaction
-                if (!view.HaveCoins(txin.prevout.hash)) {
-                    // This should never happen; all transactions in the memory
-                    // pool should connect to either transactions in the chain
-                    // or other transactions in the memory pool.
-                    if (!mempool.mapTx.count(txin.prevout.hash)) {
-                        LogPrintf("ERROR: mempool transaction missing input\n");
-                        if (fDebug) assert("mempool transaction missing input" == 0);
-                        fMissingInputs = true;
-                        if (porphan)
-                            vOrphan.pop_back();
-                        break;
-                    }
-
-                    // Has to wait for dependencies
-                    if (!porphan) {
-                        // Use list for automatic deletion
-                        vOrphan.push_back(COrphan(&tx));
-                        porphan = &vOrphan.back();
-                    }
-                    mapDependers[txin.prevout.hash].push_back(porphan);
-                    porphan->setDependsOn.insert(txin.prevout.hash);
-                    nTotalIn += mempool.mapTx[txin.prevout.hash].GetTx().vout[txin.prevout.n].nValue;
-                    continue;
-                }
-                const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-                assert(coins);
-
-                CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
-                nTotalIn += nValueIn;
-
-                int nConf = nHeight - coins->nHeight;
-
-                dPriority += (double)nValueIn * nConf;
-            }
-            if (fMissingInputs) continue;
-
-            // Priority is sum(valuein * age) / modified_txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority = tx.ComputePriority(dPriority, nTxSize);
-
-            uint256 hash = tx.GetHash();
-            mempool.ApplyDeltas(hash, dPriority, nTotalIn);
-
-            CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
-
-            if (porphan) {
-                porphan->dPriority = dPriority;
-                porphan->feeRate = feeRate;
-            } else
-                vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
-        }
+        int64_t nTimeStart = GetTimeMicros();
+        std::vector<CTxMemPool::txiter> vSelected;
+        SelectMempoolTransactions(mempool, nHeight, nBlockMaxSize, nBlockPrioritySize, nBlockMinSize, vSelected);
+        int64_t nTimeSelected = GetTimeMicros();
 
         // Collect transactions into block
         uint64_t nBlockSize = 1000;
         uint64_t nBlockTx = 0;
         int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
-
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-        while (!vecPriority.empty()) {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransaction& tx = *(vecPriority.front().get<2>());
 
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
-
-            // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBlockSize + nTxSize >= nBlockMaxSize)
-                continue;
+        // The selection is in block order, so a transaction whose parent
+        // was dropped below fails HaveInputs and is dropped as well
+        BOOST_FOREACH (CTxMemPool::txiter iter, vSelected) {
+            const CTransaction& tx = iter->GetTx();
+            unsigned int nTxSize = iter->GetTxSize();
 
             // Legacy limits on sigOps:
             unsigned int nTxSigOps = GetLegacySigOpCount(tx);
             if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
                 continue;
 
-            // Skip free transactions if we're past the minimum block size:
-            const uint256& hash = tx.GetHash();
-            double dPriorityDelta = 0;
-            CAmount nFeeDelta = 0;
-            mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-            if (fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
-                continue;
-
-            // Prioritise by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-                fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            }
-
             if (!view.HaveInputs(tx))
                 continue;
 
@@ -312,26 +505,11 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
             ++nBlockTx;
             nBlockSigOps += nTxSigOps;
             nFees += nTxFees;
-
-            if (fPrintPriority) {
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                    dPriority, feeRate.ToString(), tx.GetHash().ToString());
-            }
-
-            // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash)) {
-                BOOST_FOREACH (COrphan* porphan, mapDependers[hash]) {
-                    if (!porphan->setDependsOn.empty()) {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty()) {
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
-                }
-            }
         }
 
+        LogPrint("bench", "CreateNewBlock(): selected %u of %u mempool txs in %.2fms, checked in %.2fms\n",
+            vSelected.size(), mempool.mapTx.size(), 0.001 * (nTimeSelected - nTimeStart), 0.001 * (GetTimeMicros() - nTimeSelected));
+
         if (!fProofOfStake) {
             //Masternode and general budget payments
             FillBlockPayee(txNew, nFees, fProofOfStake);
@@ -6,7 +6,10 @@
 #ifndef BITCOIN_MINER_H
 #define BITCOIN_MINER_H
 
+#include "txmempool.h"
+
 #include <stdint.h>
+#include <vector>
 
 class CBlock;
 class CBlockHeader;
@@ -22,6 +25,12 @@ void GenerateBitcoins(bool fGenerate, CWallet* pwallet, int nThreads);
 /** Generate a new block, without valid proof-of-work */
 CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake);
 CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet, bool fProofOfStake);
+/**
+ * Pick the mempool transactions for a block at nHeight, in block order: the
+ * first nBlockPrioritySize bytes by coin age priority, the rest as ancestor
+ * packages by fee rate. Inputs are not checked; the caller holds pool.cs.
+ */
+void SelectMempoolTransactions(CTxMemPool& pool, int nHeight, unsigned int nBlockMaxSize, unsigned int nBlockPrioritySize, unsigned int nBlockMinSize, std::vector<CTxMemPool::txiter>& vSelected);
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 /** Check mined block */
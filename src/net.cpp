@@ -21,6 +21,8 @@
 #include "ui_interface.h"
 #include "wallet.h"
 
+#include <math.h>
+
 #ifdef WIN32
 #include <string.h>
 #else
@@ -35,6 +37,7 @@
 #endif
 
 #include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
 // Dump addresses to peers.dat every 15 minutes (900s)
@@ -109,6 +112,23 @@ CCriticalSection cs_nLastNodeId;
 static CSemaphore* semOutbound = NULL;
 boost::condition_variable messageHandlerCondition;
 
+namespace
+{
+/** An inventory item waiting in the relay queue */
+struct CRelayItem {
+    CInv inv;
+    //! set for transactions, so bloom filtered peers can be matched against it
+    boost::shared_ptr<const CTransaction> ptx;
+};
+
+CCriticalSection cs_relayQueue;
+std::vector<CRelayItem> vRelayQueue;
+std::set<CInv> setRelayQueued;
+
+CCriticalSection cs_invRelayStats;
+CInvRelayStats invRelayStats;
+} // anon namespace
+
 // Signals for message handling
 static CNodeSignals g_signals;
 CNodeSignals& GetNodeSignals() { return g_signals; }
@@ -1363,11 +1383,10 @@ void ThreadMessageHandler()
             }
         }
 
-        // Poll the connected nodes for messages
-        CNode* pnodeTrickle = NULL;
-        if (!vNodesCopy.empty())
-            pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
+        // Hand out inventory relayed since the last pass
+        FlushRelayQueue(vNodesCopy);
 
+        // Poll the connected nodes for messages
         bool fSleep = true;
 
         BOOST_FOREACH (CNode* pnode, vNodesCopy) {
@@ -1394,7 +1413,7 @@ void ThreadMessageHandler()
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
-                    g_signals.SendMessages(pnode, pnode == pnodeTrickle || pnode->fWhitelisted);
+                    g_signals.SendMessages(pnode);
             }
             boost::this_thread::interruption_point();
         }
@@ -1676,6 +1695,28 @@ void CExplicitNetCleanup::callCleanup()
     delete tmp; // Stroustrup's gonna kill me for that
 }
 
+static void QueueRelay(const CInv& inv, const boost::shared_ptr<const CTransaction>& ptx)
+{
+    bool fMerged;
+    {
+        LOCK(cs_relayQueue);
+        fMerged = !setRelayQueued.insert(inv).second;
+        if (!fMerged) {
+            CRelayItem item;
+            item.inv = inv;
+            item.ptx = ptx;
+            vRelayQueue.push_back(item);
+        }
+    }
+    {
+        LOCK(cs_invRelayStats);
+        invRelayStats.nQueued++;
+        if (fMerged)
+            invRelayStats.nMerged++;
+    }
+    messageHandlerCondition.notify_one();
+}
+
 void RelayTransaction(const CTransaction& tx)
 {
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
@@ -1699,17 +1740,7 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
         mapRelay.insert(std::make_pair(inv, ss));
         vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
     }
-    LOCK(cs_vNodes);
-    BOOST_FOREACH (CNode* pnode, vNodes) {
-        if (!pnode->fRelayTxes)
-            continue;
-        LOCK(pnode->cs_filter);
-        if (pnode->pfilter) {
-            if (pnode->pfilter->IsRelevantAndUpdate(tx))
-                pnode->PushInventory(inv);
-        } else
-            pnode->PushInventory(inv);
-    }
+    QueueRelay(inv, boost::shared_ptr<const CTransaction>(new CTransaction(tx)));
 }
 
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll)
@@ -1728,12 +1759,67 @@ void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll)
 
 void RelayInv(CInv& inv)
 {
-    LOCK(cs_vNodes);
-    BOOST_FOREACH (CNode* pnode, vNodes){
-    		if((pnode->nServices==NODE_BLOOM_WITHOUT_MN) && inv.IsMasterNodeType())continue;
-        if (pnode->nVersion >= ActiveProtocol())
-            pnode->PushInventory(inv);
+    QueueRelay(inv, boost::shared_ptr<const CTransaction>());
+}
+
+void FlushRelayQueue(const std::vector<CNode*>& vNodesCopy)
+{
+    std::vector<CRelayItem> vQueue;
+    {
+        LOCK(cs_relayQueue);
+        if (vRelayQueue.empty())
+            return;
+        vQueue.swap(vRelayQueue);
+        setRelayQueued.clear();
     }
+
+    int nActiveProtocol = ActiveProtocol();
+    uint64_t nKnown = 0;
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        if (pnode->fDisconnect)
+            continue;
+        LOCK2(pnode->cs_filter, pnode->cs_inventory);
+        BOOST_FOREACH (const CRelayItem& item, vQueue) {
+            if (item.ptx) {
+                if (!pnode->fRelayTxes)
+                    continue;
+                if (pnode->pfilter && !pnode->pfilter->IsRelevantAndUpdate(*item.ptx))
+                    continue;
+            } else {
+                if (pnode->nServices == NODE_BLOOM_WITHOUT_MN && item.inv.IsMasterNodeType())
+                    continue;
+                if (pnode->nVersion < nActiveProtocol)
+                    continue;
+            }
+            if (pnode->filterInventoryKnown.contains(CNode::InventoryKey(item.inv))) {
+                nKnown++;
+                continue;
+            }
+            pnode->vInventoryToSend.push_back(item.inv);
+        }
+    }
+
+    if (nKnown > 0)
+        RecordInvAnnounced(0, 0, nKnown);
+}
+
+int64_t PoissonNextSend(int64_t nNow, int average_interval_seconds)
+{
+    return nNow + (int64_t)(log1p(GetRand(1ULL << 48) * -0.0000000000000035527136788 /* -1/2^48 */) * average_interval_seconds * -1000000.0 + 0.5);
+}
+
+void RecordInvAnnounced(uint64_t nAnnounced, uint64_t nMessages, uint64_t nKnown)
+{
+    LOCK(cs_invRelayStats);
+    invRelayStats.nAnnounced += nAnnounced;
+    invRelayStats.nMessages += nMessages;
+    invRelayStats.nKnown += nKnown;
+}
+
+CInvRelayStats GetInvRelayStats()
+{
+    LOCK(cs_invRelayStats);
+    return invRelayStats;
 }
 
 void CNode::RecordBytesRecv(uint64_t bytes)
@@ -1891,7 +1977,7 @@ bool CAddrDB::Read(CAddrMan& addr)
 unsigned int ReceiveFloodSize() { return 1000 * GetArg("-maxreceivebuffer", 5 * 1000); }
 unsigned int SendBufferSize() { return 1000 * GetArg("-maxsendbuffer", 1 * 1000); }
 
-CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fInboundIn) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000)
+CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fInboundIn) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000), filterInventoryKnown(INVENTORY_KNOWN_SIZE, 0.000001)
 {
     nServices = 0;
     hSocket = hSocketIn;
@@ -1919,13 +2005,17 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nStartingHeight = -1;
     fGetAddr = false;
     fRelayTxes = false;
-    setInventoryKnown.max_size(SendBufferSize() / 1000);
+    fPreferCompactBlocks = false;
+    fSyncDigests = false;
+    nNextInvSend = 0;
+    nNextAddrSend = 0;
     pfilter = new CBloomFilter();
     nPingNonceSent = 0;
     nPingUsecStart = 0;
     nPingUsecTime = 0;
     fPingQueued = false;
     fObfuScationMaster = false;
+    fRelayMasternodeMessages = true;
 
     {
         LOCK(cs_nLastNodeId);
@@ -1954,6 +2044,19 @@ CNode::~CNode()
     GetNodeSignals().FinalizeNode(GetId());
 }
 
+void CNode::PushInventoryNow(const std::vector<CInv>& vInv)
+{
+    {
+        LOCK(cs_inventory);
+        BOOST_FOREACH (const CInv& inv, vInv)
+            filterInventoryKnown.insert(InventoryKey(inv));
+    }
+    for (size_t i = 0; i < vInv.size(); i += 1000) {
+        std::vector<CInv> vBatch(vInv.begin() + i, vInv.begin() + std::min(vInv.size(), i + 1000));
+        PushMessage("inv", vBatch);
+    }
+}
+
 void CNode::AskFor(const CInv& inv)
 {
     if (mapAskFor.size() > MAPASKFOR_MAX_SZ)
@@ -26,6 +26,7 @@
 #include <arpa/inet.h>
 #endif
 
+#include <boost/any.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/foreach.hpp>
 #include <boost/signals2/signal.hpp>
@@ -59,6 +60,13 @@ static const bool DEFAULT_UPNP = false;
 #endif
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
+/** Average delay between trickled inventory announcements to inbound peers, in seconds.
+ *  Outbound peers get half this delay. Blocks and SwiftTX messages are never delayed. */
+static const unsigned int INVENTORY_BROADCAST_INTERVAL = 5;
+/** Average delay between relayed address announcements to a peer, in seconds. */
+static const unsigned int AVG_ADDRESS_BROADCAST_INTERVAL = 30;
+/** Number of recently announced or received inventory items remembered per peer */
+static const unsigned int INVENTORY_KNOWN_SIZE = 50000;
 
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
@@ -84,7 +92,7 @@ typedef int NodeId;
 struct CNodeSignals {
     boost::signals2::signal<int()> GetHeight;
     boost::signals2::signal<bool(CNode*)> ProcessMessages;
-    boost::signals2::signal<bool(CNode*, bool)> SendMessages;
+    boost::signals2::signal<bool(CNode*)> SendMessages;
     boost::signals2::signal<void(NodeId, const CNode*)> InitializeNode;
     boost::signals2::signal<void(NodeId)> FinalizeNode;
 };
@@ -183,6 +191,9 @@ public:
 
     int64_t nTime; // time (in microseconds) of message receipt.
 
+    bool fSignaturesChecked; // Masternode-layer signature verified ahead of processing
+    boost::any decoded;      // Masternode-layer object decoded for that, handed to the handler
+
     CNetMessage(int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), vRecv(nTypeIn, nVersionIn)
     {
         hdrbuf.resize(24);
@@ -190,6 +201,7 @@ public:
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fSignaturesChecked = false;
     }
 
     bool complete() const
@@ -227,6 +239,7 @@ public:
     std::deque<CInv> vRecvGetData;
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
+    boost::any decodedRecvMsg; // CNetMessage::decoded of the message being processed
     uint64_t nRecvBytes;
     int nRecvVersion;
 
@@ -254,12 +267,18 @@ public:
     // b) the peer may tell us in their version message that we should not relay tx invs
     //    until they have initialized their bloom filter.
     bool fRelayTxes;
+    // The peer sent sendcmpct: announce new tips to it as cmpctblock instead of inv
+    bool fPreferCompactBlocks;
+    // The peer sent senddigests: it answers masternode list and budget sync requests carrying digests
+    bool fSyncDigests;
     // Should be 'true' only if we connected to this node to actually mix funds.
     // In this case node will be released automatically via CMasternodeMan::ProcessMasternodeConnections().
     // Connecting to verify connectability/status or connecting for sending/relaying single message
     // (even if it's relative to mixing e.g. for blinding) should NOT set this to 'true'.
     // For such cases node should be released manually (preferably right after corresponding code).
     bool fObfuScationMaster;
+    // Relay the masternode messages the peer sends to the others; false for the masternode simulator's dummy peer
+    bool fRelayMasternodeMessages;
     CSemaphoreGrant grantOutbound;
     CCriticalSection cs_filter;
     CBloomFilter* pfilter;
@@ -292,10 +311,15 @@ public:
     bool fGetAddr;
     std::set<uint256> setKnown;
 
-    // inventory based relay
-    mruset<CInv> setInventoryKnown;
+    // next time (in usec) relayed addresses are flushed to this peer
+    int64_t nNextAddrSend;
+
+    // inventory based relay, known items are keyed by InventoryKey()
+    CRollingBloomFilter filterInventoryKnown;
     std::vector<CInv> vInventoryToSend;
     CCriticalSection cs_inventory;
+    // next time (in usec) non-urgent inventory is flushed to this peer
+    int64_t nNextInvSend;
     std::multimap<int64_t, CInv> mapAskFor;
     std::vector<uint256> vBlockRequested;
 
@@ -365,6 +389,17 @@ public:
         nRefCount--;
     }
 
+    /** Read the message being processed, taking the object decoded ahead of processing if there is one */
+    template <typename T>
+    void ReadMessage(CDataStream& vRecv, T& obj)
+    {
+        T* pobj = boost::any_cast<T>(&decodedRecvMsg);
+        if (pobj)
+            obj = *pobj;
+        else
+            vRecv >> obj;
+    }
+
 
     void AddAddressKnown(const CAddress& addr)
     {
@@ -386,11 +421,20 @@ public:
     }
 
 
+    // The serialized inventory item: type and hash, so that items of different
+    // types sharing a hash are tracked apart
+    static std::vector<unsigned char> InventoryKey(const CInv& inv)
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << inv;
+        return std::vector<unsigned char>(ss.begin(), ss.end());
+    }
+
     void AddInventoryKnown(const CInv& inv)
     {
         {
             LOCK(cs_inventory);
-            setInventoryKnown.insert(inv);
+            filterInventoryKnown.insert(InventoryKey(inv));
         }
     }
 
@@ -398,11 +442,15 @@ public:
     {
         {
             LOCK(cs_inventory);
-            if (!setInventoryKnown.count(inv))
+            if (!filterInventoryKnown.contains(InventoryKey(inv)))
                 vInventoryToSend.push_back(inv);
         }
     }
 
+    // Announce inventory right away instead of on the trickle timer, ahead of
+    // the messages pushed after it
+    void PushInventoryNow(const std::vector<CInv>& vInv);
+
     void AskFor(const CInv& inv);
 
     // TODO: Document the postcondition of this function.  Is cs_vSend locked?
@@ -658,6 +706,24 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss);
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll = false);
 void RelayInv(CInv& inv);
 
+/**
+ * Relayed inventory is queued and handed to the peers in batches by the
+ * message handler thread, taking each peer's inventory lock once per batch.
+ */
+void FlushRelayQueue(const std::vector<CNode*>& vNodesCopy);
+/** Return a timestamp in the future (in microseconds) for exponentially distributed events. */
+int64_t PoissonNextSend(int64_t nNow, int average_interval_seconds);
+
+struct CInvRelayStats {
+    uint64_t nQueued;      //! items passed to RelayInv/RelayTransaction
+    uint64_t nMerged;      //! duplicates collapsed while waiting in the relay queue
+    uint64_t nKnown;       //! per-peer announcements skipped because the peer already had the item
+    uint64_t nAnnounced;   //! inventory entries sent
+    uint64_t nMessages;    //! inv messages sent
+};
+void RecordInvAnnounced(uint64_t nAnnounced, uint64_t nMessages, uint64_t nKnown);
+CInvRelayStats GetInvRelayStats();
+
 /** Access to the (IP) address database (peers.dat) */
 class CAddrDB
 {
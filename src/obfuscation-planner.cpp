@@ -0,0 +1,344 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "obfuscation-planner.h"
+
+#include "main.h"
+#include "obfuscation.h"
+#include "util.h"
+#include "wallet.h"
+
+#include <boost/foreach.hpp>
+
+const char* ObfuscationPlanStepToString(int nStep)
+{
+    switch (nStep) {
+    case OBFUSCATION_PLAN_NOTHING:
+        return "nothing";
+    case OBFUSCATION_PLAN_NO_INPUTS:
+        return "no_inputs";
+    case OBFUSCATION_PLAN_WAIT_DENOMINATED:
+        return "wait_denominated";
+    case OBFUSCATION_PLAN_DENOMINATE:
+        return "denominate";
+    case OBFUSCATION_PLAN_COLLATERAL:
+        return "collateral";
+    case OBFUSCATION_PLAN_WAIT_COLLATERAL:
+        return "wait_collateral";
+    case OBFUSCATION_PLAN_MIX:
+        return "mix";
+    }
+    return "unknown";
+}
+
+int GetObfuscationDenominationIndex(CAmount nAmount)
+{
+    for (unsigned int c = 0; c < obfuScationDenominations.size(); c++)
+        if (obfuScationDenominations[c] == nAmount)
+            return c;
+    return -1;
+}
+
+CObfuscationPlanner::CObfuscationPlanner()
+{
+    Clear();
+}
+
+void CObfuscationPlanner::Clear()
+{
+    mapCoins.clear();
+    mapBuckets.clear();
+    mapTrustedByRounds.clear();
+    nDenominatedConfirmed = 0;
+    nDenominatedUnconfirmed = 0;
+    nNonDenominated = 0;
+    nCollateral = 0;
+    nCollateralUnconfirmed = 0;
+    setLocked.clear();
+    setDirty.clear();
+    setPending.clear();
+    pindexLast = NULL;
+}
+
+void CObfuscationPlanner::AddCoin(const COutPoint& outpoint, const CCoin& coin)
+{
+    mapCoins[outpoint] = coin;
+
+    if ((coin.nFlags & (COIN_SPENDABLE | COIN_TRUSTED | COIN_MASTERNODE)) == (COIN_SPENDABLE | COIN_TRUSTED))
+        mapTrustedByRounds[coin.nRounds] += coin.nValue;
+
+    if ((coin.nFlags & COIN_SPENDABLE) && GetObfuscationDenominationIndex(coin.nValue) >= 0) {
+        if (coin.nFlags & COIN_DENOM_CONFIRMED) nDenominatedConfirmed += coin.nValue;
+        if (coin.nFlags & COIN_DENOM_UNCONFIRMED) nDenominatedUnconfirmed += coin.nValue;
+    }
+
+    if (coin.nRounds == -3) {
+        if (coin.nFlags & COIN_AVAILABLE) nCollateral++;
+        if (coin.nFlags & COIN_AVAILABLE_UNCONFIRMED) nCollateralUnconfirmed++;
+    } else if ((coin.nFlags & COIN_AVAILABLE) && !(coin.nFlags & COIN_MASTERNODE) && coin.nValue >= CENT) {
+        if (coin.nRounds == -2)
+            nNonDenominated += coin.nValue;
+        else if (coin.nRounds >= 0)
+            mapBuckets[std::make_pair(GetObfuscationDenominationIndex(coin.nValue), coin.nRounds)].insert(outpoint);
+    }
+}
+
+void CObfuscationPlanner::RemoveCoin(std::map<COutPoint, CCoin>::iterator it)
+{
+    const COutPoint& outpoint = it->first;
+    const CCoin& coin = it->second;
+
+    if ((coin.nFlags & (COIN_SPENDABLE | COIN_TRUSTED | COIN_MASTERNODE)) == (COIN_SPENDABLE | COIN_TRUSTED)) {
+        std::map<int, CAmount>::iterator itRounds = mapTrustedByRounds.find(coin.nRounds);
+        itRounds->second -= coin.nValue;
+        if (itRounds->second == 0) mapTrustedByRounds.erase(itRounds);
+    }
+
+    if ((coin.nFlags & COIN_SPENDABLE) && GetObfuscationDenominationIndex(coin.nValue) >= 0) {
+        if (coin.nFlags & COIN_DENOM_CONFIRMED) nDenominatedConfirmed -= coin.nValue;
+        if (coin.nFlags & COIN_DENOM_UNCONFIRMED) nDenominatedUnconfirmed -= coin.nValue;
+    }
+
+    if (coin.nRounds == -3) {
+        if (coin.nFlags & COIN_AVAILABLE) nCollateral--;
+        if (coin.nFlags & COIN_AVAILABLE_UNCONFIRMED) nCollateralUnconfirmed--;
+    } else if ((coin.nFlags & COIN_AVAILABLE) && !(coin.nFlags & COIN_MASTERNODE) && coin.nValue >= CENT) {
+        if (coin.nRounds == -2) {
+            nNonDenominated -= coin.nValue;
+        } else if (coin.nRounds >= 0) {
+            std::map<std::pair<int, int>, std::set<COutPoint> >::iterator itBucket = mapBuckets.find(std::make_pair(GetObfuscationDenominationIndex(coin.nValue), coin.nRounds));
+            itBucket->second.erase(outpoint);
+            if (itBucket->second.empty()) mapBuckets.erase(itBucket);
+        }
+    }
+
+    mapCoins.erase(it);
+}
+
+void CObfuscationPlanner::ReadTransaction(const CWallet& wallet, const uint256& hash)
+{
+    // forget what was known of the transaction
+    std::map<COutPoint, CCoin>::iterator it = mapCoins.lower_bound(COutPoint(hash, 0));
+    while (it != mapCoins.end() && it->first.hash == hash)
+        RemoveCoin(it++);
+    setPending.erase(hash);
+
+    std::map<uint256, CWalletTx>::const_iterator mi = wallet.mapWallet.find(hash);
+    if (mi == wallet.mapWallet.end())
+        return;
+    const CWalletTx& wtx = mi->second;
+
+    // the same tests as the balance functions and AvailableCoins()
+    int nDepth = wtx.GetDepthInMainChain(false);
+    bool fTrusted = wtx.IsTrusted();
+    bool fFinal = CheckFinalTx(wtx);
+    bool fImmature = wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0;
+    bool fImmatureStake = (wtx.IsCoinBase() || wtx.IsCoinStake()) && wtx.GetBlocksToMaturity() > 0;
+
+    if (nDepth < 1 || fImmatureStake || !fFinal)
+        setPending.insert(hash);
+
+    int nFlagsTx = 0;
+    if (fTrusted && !fImmature)
+        nFlagsTx |= COIN_TRUSTED;
+    if (fFinal && !fImmatureStake && (nDepth != 0 || wtx.InMempool())) {
+        nFlagsTx |= COIN_AVAILABLE_UNCONFIRMED;
+        if (fTrusted) nFlagsTx |= COIN_AVAILABLE;
+    }
+    if (!fImmature && nDepth >= 0)
+        nFlagsTx |= (!IsFinalTx(wtx) || (!fTrusted && nDepth == 0)) ? COIN_DENOM_UNCONFIRMED : COIN_DENOM_CONFIRMED;
+
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (wallet.IsSpent(hash, i))
+            continue;
+        isminetype mine = wallet.IsMine(wtx.vout[i]);
+        if (mine == ISMINE_NO)
+            continue;
+
+        CCoin coin;
+        coin.nValue = wtx.vout[i].nValue;
+        coin.nRounds = wallet.GetRealInputObfuscationRounds(CTxIn(hash, i), 0);
+        coin.nFlags = nFlagsTx;
+        if (mine & ISMINE_SPENDABLE) coin.nFlags |= COIN_SPENDABLE;
+        if (fMasterNode && coin.nValue == CurMnCost * COIN) coin.nFlags |= COIN_MASTERNODE;
+        AddCoin(COutPoint(hash, i), coin);
+    }
+}
+
+void CObfuscationPlanner::TransactionChanged(const uint256& hash)
+{
+    LOCK(cs);
+    setDirty.insert(hash);
+}
+
+bool CObfuscationPlanner::Refresh(CWallet& wallet)
+{
+    TRY_LOCK(cs_main, lockMain);
+    if (!lockMain) {
+        LOCK(cs);
+        return setDirty.empty() && pindexLast != NULL && pindexLast == chainActive.Tip();
+    }
+
+    LOCK2(wallet.cs_wallet, cs);
+
+    std::set<uint256> setRead;
+    if (pindexLast == NULL || !chainActive.Contains(pindexLast)) {
+        // first refresh or reorganization, read the whole wallet
+        Clear();
+        for (std::map<uint256, CWalletTx>::const_iterator it = wallet.mapWallet.begin(); it != wallet.mapWallet.end(); ++it)
+            setRead.insert(it->first);
+    } else {
+        setRead.swap(setDirty);
+        if (pindexLast != chainActive.Tip())
+            setRead.insert(setPending.begin(), setPending.end());
+    }
+    setDirty.clear();
+
+    // a transaction spends (or stops spending) the outputs of its inputs
+    std::set<uint256> setPrev;
+    BOOST_FOREACH (const uint256& hash, setRead) {
+        std::map<uint256, CWalletTx>::const_iterator mi = wallet.mapWallet.find(hash);
+        if (mi == wallet.mapWallet.end()) continue;
+        BOOST_FOREACH (const CTxIn& txin, mi->second.vin)
+            if (wallet.mapWallet.count(txin.prevout.hash))
+                setPrev.insert(txin.prevout.hash);
+    }
+    setRead.insert(setPrev.begin(), setPrev.end());
+
+    BOOST_FOREACH (const uint256& hash, setRead)
+        ReadTransaction(wallet, hash);
+
+    std::vector<COutPoint> vLocked;
+    wallet.ListLockedCoins(vLocked);
+    setLocked = std::set<COutPoint>(vLocked.begin(), vLocked.end());
+
+    pindexLast = chainActive.Tip();
+
+    if (!setRead.empty())
+        LogPrint("obfuscation", "CObfuscationPlanner::Refresh - read %u transactions, %u coins\n", setRead.size(), mapCoins.size());
+    return true;
+}
+
+CObfuscationBalances CObfuscationPlanner::GetBalances() const
+{
+    LOCK(cs);
+
+    CObfuscationBalances balances;
+    for (std::map<int, CAmount>::const_iterator it = mapTrustedByRounds.begin(); it != mapTrustedByRounds.end(); ++it) {
+        if (it->first >= nObfuscationRounds)
+            balances.nAnonymized += it->second;
+        else if (it->first >= -2)
+            balances.nAnonymizable += it->second;
+    }
+    balances.nDenominatedConfirmed = nDenominatedConfirmed;
+    balances.nDenominatedUnconfirmed = nDenominatedUnconfirmed;
+    balances.nNonDenominated = nNonDenominated;
+
+    // locked coins are neither available nor anonymizable
+    int nCollateralLeft = nCollateral;
+    int nCollateralUnconfirmedLeft = nCollateralUnconfirmed;
+    BOOST_FOREACH (const COutPoint& outpoint, setLocked) {
+        std::map<COutPoint, CCoin>::const_iterator it = mapCoins.find(outpoint);
+        if (it == mapCoins.end()) continue;
+        const CCoin& coin = it->second;
+
+        if ((coin.nFlags & (COIN_SPENDABLE | COIN_TRUSTED | COIN_MASTERNODE)) == (COIN_SPENDABLE | COIN_TRUSTED) &&
+            coin.nRounds >= -2 && coin.nRounds < nObfuscationRounds)
+            balances.nAnonymizable -= coin.nValue;
+
+        if (coin.nRounds == -3) {
+            if (coin.nFlags & COIN_AVAILABLE) nCollateralLeft--;
+            if (coin.nFlags & COIN_AVAILABLE_UNCONFIRMED) nCollateralUnconfirmedLeft--;
+        } else if (coin.nRounds == -2 && (coin.nFlags & COIN_AVAILABLE) && !(coin.nFlags & COIN_MASTERNODE) && coin.nValue >= CENT) {
+            balances.nNonDenominated -= coin.nValue;
+        }
+    }
+    balances.fCollateral = nCollateralLeft > 0;
+    balances.fCollateralUnconfirmed = nCollateralUnconfirmedLeft > 0;
+
+    // denominations are listed from the largest
+    for (int c = (int)obfuScationDenominations.size() - 1; c >= 0 && balances.nSmallestMixable == 0; c--) {
+        if (HasDenominatedCoins(1 << c, 0, nObfuscationRounds))
+            balances.nSmallestMixable = obfuScationDenominations[c];
+    }
+
+    return balances;
+}
+
+bool CObfuscationPlanner::HasDenominatedCoins(int nDenom, int nRoundsMin, int nRoundsMax) const
+{
+    LOCK(cs);
+
+    bool fAny = false;
+    for (int c = 0; c < (int)obfuScationDenominations.size(); c++) {
+        if (!(nDenom & (1 << c))) continue;
+
+        bool fFound = false;
+        std::map<std::pair<int, int>, std::set<COutPoint> >::const_iterator it = mapBuckets.lower_bound(std::make_pair(c, nRoundsMin));
+        for (; !fFound && it != mapBuckets.end() && it->first.first == c && it->first.second < nRoundsMax; ++it) {
+            BOOST_FOREACH (const COutPoint& outpoint, it->second) {
+                if (!setLocked.count(outpoint)) {
+                    fFound = true;
+                    break;
+                }
+            }
+        }
+        if (!fFound) return false;
+        fAny = true;
+    }
+
+    return fAny;
+}
+
+size_t CObfuscationPlanner::size() const
+{
+    LOCK(cs);
+    return mapCoins.size();
+}
+
+int CObfuscationPlanner::PlanStep(const CObfuscationBalances& balances, CAmount nTargetAmount, CAmount& nAmountRet)
+{
+    nAmountRet = 0;
+
+    // should not be less than fees in OBFUSCATION_COLLATERAL + few (lets say 5) smallest denoms
+    CAmount nLowestDenom = OBFUSCATION_COLLATERAL + obfuScationDenominations.back() * 5;
+
+    // if there are no OBF collateral inputs yet, should have some additional amount for them
+    if (!balances.fCollateral)
+        nLowestDenom += OBFUSCATION_COLLATERAL * 4;
+
+    CAmount nBalanceNeedsAnonymized = nTargetAmount - balances.nAnonymized;
+    if (nBalanceNeedsAnonymized > OBFUSCATION_POOL_MAX) nBalanceNeedsAnonymized = OBFUSCATION_POOL_MAX;
+    if (nBalanceNeedsAnonymized > balances.nAnonymizable) nBalanceNeedsAnonymized = balances.nAnonymizable;
+
+    if (nBalanceNeedsAnonymized < nLowestDenom)
+        return OBFUSCATION_PLAN_NOTHING;
+
+    CAmount nOnlyDenominatedBalance = balances.nDenominatedUnconfirmed + balances.nDenominatedConfirmed - balances.nAnonymized;
+    CAmount nBalanceNeedsDenominated = nBalanceNeedsAnonymized - nOnlyDenominatedBalance;
+
+    // nothing to mix that fits, denominate what is not denominated yet
+    if (balances.nSmallestMixable == 0 || balances.nSmallestMixable > nBalanceNeedsAnonymized) {
+        if (balances.nNonDenominated == 0)
+            return OBFUSCATION_PLAN_NO_INPUTS;
+        if (nBalanceNeedsDenominated > balances.nNonDenominated) nBalanceNeedsDenominated = balances.nNonDenominated;
+        if (nBalanceNeedsDenominated < nLowestDenom)
+            return OBFUSCATION_PLAN_WAIT_DENOMINATED;
+        nAmountRet = nBalanceNeedsDenominated;
+        return OBFUSCATION_PLAN_DENOMINATE;
+    }
+
+    // check if we have should create more denominated inputs
+    if (nBalanceNeedsDenominated > nOnlyDenominatedBalance) {
+        nAmountRet = nBalanceNeedsDenominated;
+        return OBFUSCATION_PLAN_DENOMINATE;
+    }
+
+    // check if we have the collateral sized inputs
+    if (!balances.fCollateral)
+        return balances.fCollateralUnconfirmed ? OBFUSCATION_PLAN_WAIT_COLLATERAL : OBFUSCATION_PLAN_COLLATERAL;
+
+    nAmountRet = nBalanceNeedsAnonymized;
+    return OBFUSCATION_PLAN_MIX;
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef OBFUSCATION_PLANNER_H
+#define OBFUSCATION_PLANNER_H
+
+#include "amount.h"
+#include "primitives/transaction.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+#include <set>
+#include <utility>
+
+class CBlockIndex;
+class CWallet;
+
+/** Next step of automatic denominating, see CObfuscationPlanner::PlanStep() */
+enum ObfuscationPlanStep {
+    OBFUSCATION_PLAN_NOTHING = 0,      // nothing left to anonymize
+    OBFUSCATION_PLAN_NO_INPUTS,        // neither mixable nor denominatable inputs
+    OBFUSCATION_PLAN_WAIT_DENOMINATED, // waiting for denominations to confirm
+    OBFUSCATION_PLAN_DENOMINATE,       // create denominated outputs
+    OBFUSCATION_PLAN_COLLATERAL,       // create collateral outputs
+    OBFUSCATION_PLAN_WAIT_COLLATERAL,  // waiting for collateral outputs to confirm
+    OBFUSCATION_PLAN_MIX               // join or start a mixing session
+};
+
+const char* ObfuscationPlanStepToString(int nStep);
+
+/** Index of an amount in obfuScationDenominations (bit of a denomination mask), -1 if not denominated */
+int GetObfuscationDenominationIndex(CAmount nAmount);
+
+/** The wallet balances automatic denominating decides on */
+struct CObfuscationBalances {
+    CAmount nAnonymized;             // GetAnonymizedBalance()
+    CAmount nAnonymizable;           // GetAnonymizableBalance()
+    CAmount nDenominatedConfirmed;   // GetDenominatedBalance()
+    CAmount nDenominatedUnconfirmed; // GetDenominatedBalance(true)
+    CAmount nNonDenominated;         // what SelectCoinsDark() finds with rounds [-2, 0)
+    CAmount nSmallestMixable;        // smallest coin SelectCoinsDark() finds with rounds [0, nObfuscationRounds), 0 if none
+    bool fCollateral;                // HasCollateralInputs()
+    bool fCollateralUnconfirmed;     // HasCollateralInputs(false)
+
+    CObfuscationBalances() : nAnonymized(0), nAnonymizable(0), nDenominatedConfirmed(0), nDenominatedUnconfirmed(0),
+                             nNonDenominated(0), nSmallestMixable(0), fCollateral(false), fCollateralUnconfirmed(false) {}
+};
+
+/**
+ * Wallet-side view of the coins automatic denominating works with.
+ *
+ * DoAutomaticDenominating() used to walk the whole wallet a dozen times per
+ * attempt (every balance, every coin selection and every queue it looked at)
+ * with cs_main held. The planner keeps the unspent outputs of the wallet with
+ * their rounds, running totals for the balances and the confirmed denominated
+ * coins bucketed by denomination and rounds. AddToWallet() marks transactions
+ * dirty, and Refresh() only re-reads those, their inputs and the transactions
+ * whose confirmation state can still change when the tip moves.
+ *
+ * Planning a step is then a lookup; the coins are only selected from the
+ * wallet when a step is taken.
+ */
+class CObfuscationPlanner
+{
+private:
+    enum {
+        COIN_SPENDABLE = 1,             // ISMINE_SPENDABLE, counted in the balances
+        COIN_TRUSTED = 2,               // counted in GetAnonymized/AnonymizableBalance()
+        COIN_AVAILABLE = 4,             // returned by AvailableCoins()
+        COIN_AVAILABLE_UNCONFIRMED = 8, // returned by AvailableCoins(false)
+        COIN_DENOM_CONFIRMED = 16,      // counted in GetDenominatedBalance()
+        COIN_DENOM_UNCONFIRMED = 32,    // counted in GetDenominatedBalance(true)
+        COIN_MASTERNODE = 64            // masternode-like output of a masternode, never mixed
+    };
+
+    struct CCoin {
+        CAmount nValue;
+        int nRounds; // real rounds, -2 non-denominated, -3 collateral
+        int nFlags;
+    };
+
+    mutable CCriticalSection cs;
+    std::map<COutPoint, CCoin> mapCoins;
+    //! available denominated coins by (denomination index, rounds)
+    std::map<std::pair<int, int>, std::set<COutPoint> > mapBuckets;
+    //! trusted spendable credit by rounds
+    std::map<int, CAmount> mapTrustedByRounds;
+    CAmount nDenominatedConfirmed;
+    CAmount nDenominatedUnconfirmed;
+    CAmount nNonDenominated;
+    int nCollateral;
+    int nCollateralUnconfirmed;
+
+    std::set<COutPoint> setLocked;
+    //! transactions added or updated since the last refresh
+    std::set<uint256> setDirty;
+    //! transactions whose state depends on the tip (unconfirmed, immature or not final)
+    std::set<uint256> setPending;
+    const CBlockIndex* pindexLast;
+
+    void AddCoin(const COutPoint& outpoint, const CCoin& coin);
+    void RemoveCoin(std::map<COutPoint, CCoin>::iterator it);
+    void ReadTransaction(const CWallet& wallet, const uint256& hash);
+    void Clear();
+
+public:
+    CObfuscationPlanner();
+
+    /** Mark a wallet transaction as added or updated */
+    void TransactionChanged(const uint256& hash);
+
+    /**
+     * Bring the planner up to date with the wallet. Does not wait for cs_main:
+     * returns false if it is busy and the planner is not up to date already.
+     */
+    bool Refresh(CWallet& wallet);
+
+    CObfuscationBalances GetBalances() const;
+
+    /** Are there available coins of every denomination of nDenom (a GetDenominations() mask) with rounds [nRoundsMin, nRoundsMax) */
+    bool HasDenominatedCoins(int nDenom, int nRoundsMin, int nRoundsMax) const;
+
+    size_t size() const;
+
+    /**
+     * Decide the next step of automatic denominating towards nTargetAmount
+     * anonymized. nAmountRet is the amount to denominate or to mix.
+     */
+    static int PlanStep(const CObfuscationBalances& balances, CAmount nTargetAmount, CAmount& nAmountRet);
+};
+
+#endif // OBFUSCATION_PLANNER_H
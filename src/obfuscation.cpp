@@ -5,10 +5,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "obfuscation.h"
+#include "checkqueue.h"
 #include "coincontrol.h"
 #include "init.h"
 #include "main.h"
+#include "masternode-budget.h"
+#include "masternode-payments.h"
 #include "masternodeman.h"
+#include "scheduler.h"
 #include "script/sign.h"
 #include "swifttx.h"
 #include "ui_interface.h"
@@ -17,6 +21,8 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
 
 #include <algorithm>
 #include <boost/assign/list_of.hpp>
@@ -38,6 +44,57 @@ map<uint256, CObfuscationBroadcastTx> mapObfuscationBroadcastTxes;
 // Keep track of the active Masternode
 CActiveMasternode activeMasternode;
 
+namespace
+{
+/**
+ * Valid Masternode-layer message signatures. The same broadcast, ping or vote
+ * arrives from many peers, and the message signature check queue verifies
+ * signatures ahead of the messages being processed.
+ */
+class CMessageSignatureCache
+{
+private:
+    //! sigdata_type is (message hash, signature, signer)
+    typedef boost::tuple<uint256, std::vector<unsigned char>, CKeyID> sigdata_type;
+    std::set<sigdata_type> setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    bool Get(const uint256& hash, const std::vector<unsigned char>& vchSig, const CKeyID& keyID)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.count(sigdata_type(hash, vchSig, keyID)) > 0;
+    }
+
+    void Set(const uint256& hash, const std::vector<unsigned char>& vchSig, const CKeyID& keyID)
+    {
+        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+
+        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize) {
+            // Evict a random entry, like the script signature cache
+            std::vector<unsigned char> unused;
+            std::set<sigdata_type>::iterator it = setValid.lower_bound(sigdata_type(GetRandHash(), unused, CKeyID()));
+            if (it == setValid.end())
+                it = setValid.begin();
+            setValid.erase(it);
+        }
+
+        setValid.insert(sigdata_type(hash, vchSig, keyID));
+    }
+};
+}
+
+static CMessageSignatureCache messageSignatureCache;
+static CCheckQueue<CSignedMessageCheck> messagecheckqueue(128);
+// CCheckQueue takes one master at a time
+static CCriticalSection cs_messagecheckqueue;
+
+/** Most signatures collected from a node's queued messages at once */
+static const unsigned int MAX_QUEUED_SIGNATURE_CHECKS = 1000;
+
 /* *** BEGIN OBFUSCATION MAGIC - SAVIOUR **********
     Copyright (c) 2014-2015, Dash Developers
         eduffield - evan@dashpay.io
@@ -82,7 +139,7 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
 
         if (sessionUsers == 0) {
             if (pmn->nLastDsq != 0 &&
-                pmn->nLastDsq + mnodeman.CountEnabled(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
+                pmn->nLastDsq + mnodeman.CountEnabledAtTip(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
                 LogPrintf("dsa -- last dsq too recent, must wait. %s \n", pfrom->addr.ToString());
                 errorID = ERR_RECENT;
                 pfrom->PushMessage("dssu", sessionID, GetState(), GetEntriesCount(), MASTERNODE_REJECTED, errorID);
@@ -109,7 +166,7 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
         }
 
         CObfuscationQueue dsq;
-        vRecv >> dsq;
+        pfrom->ReadMessage(vRecv, dsq);
 
         CService addr;
         if (!dsq.GetAddress(addr)) return;
@@ -140,7 +197,7 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
             LogPrint("obfuscation", "dsq last %d last2 %d count %d\n", pmn->nLastDsq, pmn->nLastDsq + mnodeman.size() / 5, mnodeman.nDsqCount);
             //don't allow a few nodes to dominate the queuing process
             if (pmn->nLastDsq != 0 &&
-                pmn->nLastDsq + mnodeman.CountEnabled(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
+                pmn->nLastDsq + mnodeman.CountEnabledAtTip(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
                 LogPrint("obfuscation", "dsq -- Masternode sending too many dsq messages. %s \n", pmn->addr.ToString());
                 return;
             }
@@ -1417,71 +1474,41 @@ bool CObfuscationPool::DoAutomaticDenominating(bool fDryRun)
         return false;
     }
 
-    // ** find the coins we'll use
-    std::vector<CTxIn> vCoins;
+    // ** plan the next step from the wallet's coins
+    if (!pwalletMain->obfuscationPlanner.Refresh(*pwalletMain)) {
+        LogPrint("obfuscation", "CObfuscationPool::DoAutomaticDenominating - wallet busy, will plan next time\n");
+        return false;
+    }
+
+    CObfuscationBalances balances = pwalletMain->obfuscationPlanner.GetBalances();
     CAmount nValueMin = CENT;
     CAmount nValueIn = 0;
+    CAmount nAmount = 0;
+    int nStep = CObfuscationPlanner::PlanStep(balances, nAnonymizeSaviourAmount * COIN, nAmount);
 
-    CAmount nOnlyDenominatedBalance;
-    CAmount nBalanceNeedsDenominated;
-
-    // should not be less than fees in OBFUSCATION_COLLATERAL + few (lets say 5) smallest denoms
-    CAmount nLowestDenom = OBFUSCATION_COLLATERAL + obfuScationDenominations[obfuScationDenominations.size() - 1] * 5;
-
-    // if there are no OBF collateral inputs yet
-    if (!pwalletMain->HasCollateralInputs())
-        // should have some additional amount for them
-        nLowestDenom += OBFUSCATION_COLLATERAL * 4;
-
-    CAmount nBalanceNeedsAnonymized = nAnonymizeSaviourAmount * COIN - pwalletMain->GetAnonymizedBalance();
-
-    // if balanceNeedsAnonymized is more than pool max, take the pool max
-    if (nBalanceNeedsAnonymized > OBFUSCATION_POOL_MAX) nBalanceNeedsAnonymized = OBFUSCATION_POOL_MAX;
-
-    // if balanceNeedsAnonymized is more than non-anonymized, take non-anonymized
-    CAmount nAnonymizableBalance = pwalletMain->GetAnonymizableBalance();
-    if (nBalanceNeedsAnonymized > nAnonymizableBalance) nBalanceNeedsAnonymized = nAnonymizableBalance;
+    LogPrint("obfuscation", "DoAutomaticDenominating : step=%s, nAmount=%d\n", ObfuscationPlanStepToString(nStep), nAmount);
 
-    if (nBalanceNeedsAnonymized < nLowestDenom) {
+    if (nStep == OBFUSCATION_PLAN_NOTHING) {
         LogPrintf("DoAutomaticDenominating : No funds detected in need of denominating \n");
         strAutoDenomResult = _("No funds detected in need of denominating.");
         return false;
     }
 
-    LogPrint("obfuscation", "DoAutomaticDenominating : nLowestDenom=%d, nBalanceNeedsAnonymized=%d\n", nLowestDenom, nBalanceNeedsAnonymized);
-
-    // select coins that should be given to the pool
-    if (!pwalletMain->SelectCoinsDark(nValueMin, nBalanceNeedsAnonymized, vCoins, nValueIn, 0, nObfuscationRounds)) {
-        nValueIn = 0;
-        vCoins.clear();
-
-        if (pwalletMain->SelectCoinsDark(nValueMin, 9999999 * COIN, vCoins, nValueIn, -2, 0)) {
-            nOnlyDenominatedBalance = pwalletMain->GetDenominatedBalance(true) + pwalletMain->GetDenominatedBalance() - pwalletMain->GetAnonymizedBalance();
-            nBalanceNeedsDenominated = nBalanceNeedsAnonymized - nOnlyDenominatedBalance;
-
-            if (nBalanceNeedsDenominated > nValueIn) nBalanceNeedsDenominated = nValueIn;
-
-            if (nBalanceNeedsDenominated < nLowestDenom) return false; // most likely we just waiting for denoms to confirm
-            if (!fDryRun) return CreateDenominated(nBalanceNeedsDenominated);
-
-            return true;
-        } else {
-            LogPrintf("DoAutomaticDenominating : Can't denominate - no compatible inputs left\n");
-            strAutoDenomResult = _("Can't denominate: no compatible inputs left.");
-            return false;
-        }
+    if (nStep == OBFUSCATION_PLAN_NO_INPUTS) {
+        LogPrintf("DoAutomaticDenominating : Can't denominate - no compatible inputs left\n");
+        strAutoDenomResult = _("Can't denominate: no compatible inputs left.");
+        return false;
     }
 
-    if (fDryRun) return true;
+    if (nStep == OBFUSCATION_PLAN_WAIT_DENOMINATED) return false; // most likely we just waiting for denoms to confirm
 
-    nOnlyDenominatedBalance = pwalletMain->GetDenominatedBalance(true) + pwalletMain->GetDenominatedBalance() - pwalletMain->GetAnonymizedBalance();
-    nBalanceNeedsDenominated = nBalanceNeedsAnonymized - nOnlyDenominatedBalance;
+    if (fDryRun) return true;
 
-    //check if we have should create more denominated inputs
-    if (nBalanceNeedsDenominated > nOnlyDenominatedBalance) return CreateDenominated(nBalanceNeedsDenominated);
+    if (nStep == OBFUSCATION_PLAN_DENOMINATE) return CreateDenominated(nAmount);
+    if (nStep == OBFUSCATION_PLAN_COLLATERAL) return MakeCollateralAmounts();
+    if (nStep == OBFUSCATION_PLAN_WAIT_COLLATERAL) return false;
 
-    //check if we have the collateral sized inputs
-    if (!pwalletMain->HasCollateralInputs()) return !pwalletMain->HasCollateralInputs(false) && MakeCollateralAmounts();
+    CAmount nBalanceNeedsAnonymized = nAmount;
 
     std::vector<CTxOut> vOut;
 
@@ -1494,7 +1521,7 @@ bool CObfuscationPool::DoAutomaticDenominating(bool fDryRun)
         int nUseQueue = rand() % 100;
         UpdateState(POOL_STATUS_ACCEPTING_ENTRIES);
 
-        if (pwalletMain->GetDenominatedBalance(true) > 0) { //get denominated unconfirmed inputs
+        if (balances.nDenominatedUnconfirmed > 0) { //get denominated unconfirmed inputs
             LogPrintf("DoAutomaticDenominating -- Found unconfirmed denominated outputs, will wait till they confirm to continue.\n");
             strAutoDenomResult = _("Found unconfirmed denominated outputs, will wait till they confirm to continue.");
             return false;
@@ -1519,7 +1546,7 @@ bool CObfuscationPool::DoAutomaticDenominating(bool fDryRun)
         }
 
         //if we've used 90% of the Masternode list then drop all the oldest first
-        int nThreshold = (int)(mnodeman.CountEnabled(ActiveProtocol()) * 0.9);
+        int nThreshold = (int)(mnodeman.CountEnabledAtTip(ActiveProtocol()) * 0.9);
         LogPrint("obfuscation", "Checking vecMasternodesUsed size %d threshold %d\n", (int)vecMasternodesUsed.size(), nThreshold);
         while ((int)vecMasternodesUsed.size() > nThreshold) {
             vecMasternodesUsed.erase(vecMasternodesUsed.begin());
@@ -1553,6 +1580,9 @@ bool CObfuscationPool::DoAutomaticDenominating(bool fDryRun)
                 }
                 if (fUsed) continue;
 
+                // skip the queues we have no coins for without selecting them from the wallet
+                if (!pwalletMain->obfuscationPlanner.HasDenominatedCoins(dsq.nDenom, 0, nObfuscationRounds)) continue;
+
                 std::vector<CTxIn> vTempCoins;
                 std::vector<COutput> vTempCoins2;
                 // Try to match their denominations if possible
@@ -1594,6 +1624,14 @@ bool CObfuscationPool::DoAutomaticDenominating(bool fDryRun)
         // do not initiate queue if we are a liquidity proveder to avoid useless inter-mixing
         if (nLiquidityProvider) return false;
 
+        // select coins that should be given to the pool
+        std::vector<CTxIn> vCoins;
+        if (!pwalletMain->SelectCoinsDark(nValueMin, nBalanceNeedsAnonymized, vCoins, nValueIn, 0, nObfuscationRounds)) {
+            LogPrintf("DoAutomaticDenominating : Can't select coins to mix\n");
+            strAutoDenomResult = _("Can't denominate: no compatible inputs left.");
+            return false;
+        }
+
         int i = 0;
 
         // otherwise, try one randomly
@@ -1606,7 +1644,7 @@ bool CObfuscationPool::DoAutomaticDenominating(bool fDryRun)
             }
 
             if (pmn->nLastDsq != 0 &&
-                pmn->nLastDsq + mnodeman.CountEnabled(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
+                pmn->nLastDsq + mnodeman.CountEnabledAtTip(ActiveProtocol()) / 5 > mnodeman.nDsqCount) {
                 i++;
                 continue;
             }
@@ -1966,7 +2004,7 @@ int CObfuscationPool::GetDenominations(const std::vector<CTxOut>& vout, bool fSi
         denomUsed.push_back(make_pair(d, 0));
 
     // look for denominations and update uses to 1
-    BOOST_FOREACH (CTxOut out, vout) {
+    BOOST_FOREACH (const CTxOut& out, vout) {
         bool found = false;
         BOOST_FOREACH (PAIRTYPE(int64_t, int) & s, denomUsed) {
             if (out.nValue == s.first) {
@@ -2108,8 +2146,14 @@ bool CObfuScationSigner::IsVinAssociatedWithPubkey(CTxIn& vin, CPubKey& pubkey)
 
     CTransaction txVin;
     uint256 hash;
-    if (GetTransaction(vin.prevout.hash, txVin, hash, true)) {
-        BOOST_FOREACH (CTxOut out, txVin.vout) {
+    std::vector<CTxOut> vout;
+    CCoins coins;
+    if (GetTransaction(vin.prevout.hash, txVin, hash, true))
+        vout = txVin.vout;
+    else if (fHavePruned && GetUnspentTransactionOutputs(vin.prevout.hash, coins, hash))
+        vout = coins.vout; // the collateral is unspent, so it is still in the UTXO set
+    if (!vout.empty()) {
+        BOOST_FOREACH (CTxOut out, vout) {
             //if (out.nValue == 1000 * COIN) {
 			if (out.nValue == CurMnCost * COIN) { 
                 if (out.scriptPubKey == payee2) return true;
@@ -2162,29 +2206,175 @@ bool CObfuScationSigner::SignMessage(std::string strMessage, std::string& errorM
     return true;
 }
 
-bool CObfuScationSigner::VerifyMessage(CPubKey pubkey, vector<unsigned char>& vchSig, std::string strMessage, std::string& errorMessage)
+/** Hash signed by SignMessage and checked by VerifyMessage */
+static uint256 GetSignedMessageHash(const std::string& strMessage)
 {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
+    return ss.GetHash();
+}
+
+bool IsMessageSignatureCached(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage)
+{
+    return messageSignatureCache.Get(GetSignedMessageHash(strMessage), vchSig, pubkey.GetID());
+}
+
+bool CObfuScationSigner::VerifyMessage(CPubKey pubkey, vector<unsigned char>& vchSig, std::string strMessage, std::string& errorMessage)
+{
+    uint256 hash = GetSignedMessageHash(strMessage);
+
+    if (messageSignatureCache.Get(hash, vchSig, pubkey.GetID()))
+        return true;
 
     CPubKey pubkey2;
-    if (!pubkey2.RecoverCompact(ss.GetHash(), vchSig)) {
+    if (!pubkey2.RecoverCompact(hash, vchSig)) {
         errorMessage = _("Error recovering public key.");
         return false;
     }
 
-    if (fDebug && pubkey2.GetID() != pubkey.GetID())
-        LogPrintf("CObfuScationSigner::VerifyMessage -- keys don't match: %s %s\n", pubkey2.GetID().ToString(), pubkey.GetID().ToString());
+    if (pubkey2.GetID() != pubkey.GetID()) {
+        if (fDebug)
+            LogPrintf("CObfuScationSigner::VerifyMessage -- keys don't match: %s %s\n", pubkey2.GetID().ToString(), pubkey.GetID().ToString());
+        return false;
+    }
+
+    messageSignatureCache.Set(hash, vchSig, pubkey.GetID());
+    return true;
+}
+
+bool CSignedMessageCheck::operator()()
+{
+    // A bad signature must not stop the rest of the batch from being checked,
+    // it is rejected when its message is processed
+    std::string strError;
+    obfuScationSigner.VerifyMessage(pubkey, vchSig, strMessage, strError);
+    return true;
+}
+
+void CheckSignedMessages(std::vector<CSignedMessageCheck>& vChecks)
+{
+    if (vChecks.empty() || !nScriptCheckThreads)
+        return;
+
+    LOCK(cs_messagecheckqueue);
+    CCheckQueueControl<CSignedMessageCheck> control(&messagecheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+/**
+ * Add the signature of a Masternode-layer message to vChecks. The decoded
+ * object is kept in decoded, so the handler doesn't decode it again.
+ */
+static void GetMessageSignatureChecks(const std::string& strCommand, CDataStream& vRecv, boost::any& decoded, std::vector<CSignedMessageCheck>& vChecks)
+{
+    if (strCommand == "mnb") {
+        CMasternodeBroadcast mnb;
+        vRecv >> mnb;
+        vChecks.push_back(CSignedMessageCheck(mnb.pubKeyCollateralAddress, mnb.sig, mnb.GetSignatureMessage()));
+        if (!mnb.lastPing.vchSig.empty())
+            vChecks.push_back(CSignedMessageCheck(mnb.pubKeyMasternode, mnb.lastPing.vchSig, mnb.lastPing.GetSignatureMessage()));
+        decoded = mnb;
+        return;
+    }
+
+    // everything else is signed by a Masternode we know already
+    CTxIn vin;
+    std::vector<unsigned char> vchSig;
+    std::string strMessage;
+    if (strCommand == "mnp") {
+        CMasternodePing mnp;
+        vRecv >> mnp;
+        vin = mnp.vin;
+        vchSig = mnp.vchSig;
+        strMessage = mnp.GetSignatureMessage();
+        decoded = mnp;
+    } else if (strCommand == "mnw") {
+        CMasternodePaymentWinner winner;
+        vRecv >> winner;
+        vin = winner.vinMasternode;
+        vchSig = winner.vchSig;
+        strMessage = winner.GetSignatureMessage();
+        decoded = winner;
+    } else if (strCommand == "mvote") {
+        CBudgetVote vote;
+        vRecv >> vote;
+        vin = vote.vin;
+        vchSig = vote.vchSig;
+        strMessage = vote.GetSignatureMessage();
+        decoded = vote;
+    } else if (strCommand == "fbvote") {
+        CFinalizedBudgetVote vote;
+        vRecv >> vote;
+        vin = vote.vin;
+        vchSig = vote.vchSig;
+        strMessage = vote.GetSignatureMessage();
+        decoded = vote;
+    } else if (strCommand == "txlvote") {
+        CConsensusVote vote;
+        vRecv >> vote;
+        vin = vote.vinMasternode;
+        vchSig = vote.vchMasterNodeSignature;
+        strMessage = vote.GetSignatureMessage();
+        decoded = vote;
+    } else if (strCommand == "dsq") {
+        CObfuscationQueue dsq;
+        vRecv >> dsq;
+        vin = dsq.vin;
+        vchSig = dsq.vchSig;
+        strMessage = dsq.GetSignatureMessage();
+        decoded = dsq;
+    } else
+        return;
 
-    return (pubkey2.GetID() == pubkey.GetID());
+    CMasternode* pmn = mnodeman.Find(vin);
+    if (pmn != NULL)
+        vChecks.push_back(CSignedMessageCheck(pmn->pubKeyMasternode, vchSig, strMessage));
+}
+
+void CheckQueuedMessageSignatures(CNode* pfrom)
+{
+    if (!nScriptCheckThreads)
+        return;
+
+    // New messages are appended, so the ones not looked at yet are at the end
+    std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.end();
+    while (it != pfrom->vRecvMsg.begin() && !(it - 1)->fSignaturesChecked)
+        --it;
+
+    std::vector<CSignedMessageCheck> vChecks;
+    for (; it != pfrom->vRecvMsg.end() && vChecks.size() < MAX_QUEUED_SIGNATURE_CHECKS; ++it) {
+        CNetMessage& msg = *it;
+        if (!msg.complete())
+            break;
+        msg.fSignaturesChecked = true;
+
+        try {
+            CDataStream vRecv(msg.vRecv);
+            GetMessageSignatureChecks(msg.hdr.GetCommand(), vRecv, msg.decoded, vChecks);
+        } catch (std::exception& e) {
+            // malformed messages are dealt with when they are processed
+            msg.decoded = boost::any();
+        }
+    }
+
+    // a single signature is as fast to check inline
+    if (vChecks.size() > 1)
+        CheckSignedMessages(vChecks);
+}
+
+void ThreadMessageSignatureCheck()
+{
+    RenameThread("saviour-mnsigcheck");
+    messagecheckqueue.Thread();
 }
 
 bool CObfuscationQueue::Sign()
 {
     if (!fMasterNode) return false;
 
-    std::string strMessage = vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(time) + boost::lexical_cast<std::string>(ready);
+    std::string strMessage = GetSignatureMessage();
 
     CKey key2;
     CPubKey pubkey2;
@@ -2219,12 +2409,17 @@ bool CObfuscationQueue::Relay()
     return true;
 }
 
+std::string CObfuscationQueue::GetSignatureMessage() const
+{
+    return vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(time) + boost::lexical_cast<std::string>(ready);
+}
+
 bool CObfuscationQueue::CheckSignature()
 {
     CMasternode* pmn = mnodeman.Find(vin);
 
     if (pmn != NULL) {
-        std::string strMessage = vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(time) + boost::lexical_cast<std::string>(ready);
+        std::string strMessage = GetSignatureMessage();
 
         std::string errorMessage = "";
         if (!obfuScationSigner.VerifyMessage(pmn->pubKeyMasternode, vchSig, strMessage, errorMessage)) {
@@ -2280,45 +2475,63 @@ void CObfuscationPool::RelayCompletedTransaction(const int sessionID, const bool
         pnode->PushMessage("dsc", sessionID, error, errorID);
 }
 
-//TODO: Rename/move to core
-void ThreadCheckObfuScationPool()
+namespace
 {
-    if (fLiteMode) return; //disable all Obfuscation/Masternode related functionality
-
-    // Make this thread recognisable as the wallet flushing thread
-    RenameThread("saviour-obfuscation");
-
-    unsigned int c = 0;
-
-    while (true) {
-        MilliSleep(1000);
-        //LogPrintf("ThreadCheckObfuScationPool::check timeout\n");
+// Activate the masternode once synced and ping it every MASTERNODE_PING_SECONDS after that
+void ManageMasternodeStatus(CScheduler* pscheduler)
+{
+    int64_t nDelayMs = 1000;
+    if (masternodeSync.IsBlockchainSynced()) {
+        activeMasternode.ManageStatus();
+        nDelayMs = MASTERNODE_PING_SECONDS * 1000;
+    }
+    pscheduler->scheduleFromNow(boost::bind(&ManageMasternodeStatus, pscheduler), nDelayMs);
+}
 
-        // try to sync from all available nodes, one step at a time
-        masternodeSync.Process();
+void CheckObfuScationPool()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    obfuScationPool.CheckTimeout();
+    obfuScationPool.CheckForCompleteQueue();
+}
 
-        if (masternodeSync.IsBlockchainSynced()) {
-            c++;
+void CleanMasternodeLists()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    mnodeman.CheckAndRemove();
+    mnodeman.ProcessMasternodeConnections();
+    masternodePayments.CleanPaymentList();
+    txLockManager.Clean();
+}
 
-            // check if we should activate or ping every few minutes,
-            // start right after sync is considered to be done
-            if (c % MASTERNODE_PING_SECONDS == 1) activeMasternode.ManageStatus();
+void DumpMasternodeCaches()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    // only the records that changed are written, so flushing often is cheap
+    DumpMasternodes();
+    DumpBudgets();
+    DumpMasternodePayments();
+}
 
-            if (c % 60 == 0) {
-                mnodeman.CheckAndRemove();
-                mnodeman.ProcessMasternodeConnections();
-                masternodePayments.CleanPaymentList();
-                CleanTransactionLocksList();
-            }
+void AutomaticDenominating()
+{
+    if (!masternodeSync.IsBlockchainSynced()) return;
+    if (obfuScationPool.GetState() == POOL_STATUS_IDLE)
+        obfuScationPool.DoAutomaticDenominating();
+}
+} // anonymous namespace
 
-            //if(c % MASTERNODES_DUMP_SECONDS == 0) DumpMasternodes();
+//TODO: Rename/move to core
+void StartObfuScationPoolChecks(CScheduler& scheduler)
+{
+    if (fLiteMode) return; //disable all Obfuscation/Masternode related functionality
 
-            obfuScationPool.CheckTimeout();
-            obfuScationPool.CheckForCompleteQueue();
+    // each stage of the masternode sync follows right after the previous one completes
+    masternodeSync.StartSync(scheduler);
 
-            if (obfuScationPool.GetState() == POOL_STATUS_IDLE && c % 15 == 0) {
-                obfuScationPool.DoAutomaticDenominating();
-            }
-        }
-    }
+    scheduler.scheduleFromNow(boost::bind(&ManageMasternodeStatus, &scheduler), 1000);
+    scheduler.scheduleEvery(&CheckObfuScationPool, 1000);
+    scheduler.scheduleEvery(&CleanMasternodeLists, 60 * 1000);
+    scheduler.scheduleEvery(&DumpMasternodeCaches, MASTERNODES_DUMP_SECONDS * 1000);
+    scheduler.scheduleEvery(&AutomaticDenominating, 15 * 1000);
 }
@@ -14,6 +14,7 @@
 #include "obfuscation-relay.h"
 #include "sync.h"
 
+class CScheduler;
 class CTxIn;
 class CObfuscationPool;
 class CObfuScationSigner;
@@ -230,6 +231,9 @@ public:
 
     /// Check if we have a valid Masternode address
     bool CheckSignature();
+
+    /// The message the Masternode signs
+    std::string GetSignatureMessage() const;
 };
 
 /** Helper class to store Obfuscation transaction (tx) information.
@@ -260,6 +264,39 @@ public:
     bool VerifyMessage(CPubKey pubkey, std::vector<unsigned char>& vchSig, std::string strMessage, std::string& errorMessage);
 };
 
+/** A Masternode-layer message signature, to be verified on the message signature check queue
+ */
+class CSignedMessageCheck
+{
+private:
+    CPubKey pubkey;
+    std::vector<unsigned char> vchSig;
+    std::string strMessage;
+
+public:
+    CSignedMessageCheck() {}
+    CSignedMessageCheck(const CPubKey& pubkeyIn, const std::vector<unsigned char>& vchSigIn, const std::string& strMessageIn) : pubkey(pubkeyIn), vchSig(vchSigIn), strMessage(strMessageIn) {}
+
+    /// Verify the signature; valid signatures end up in the signature cache
+    bool operator()();
+
+    void swap(CSignedMessageCheck& check)
+    {
+        std::swap(pubkey, check.pubkey);
+        vchSig.swap(check.vchSig);
+        strMessage.swap(check.strMessage);
+    }
+};
+
+/// Whether a valid signature of strMessage by pubkey is in the signature cache
+bool IsMessageSignatureCached(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage);
+/// Verify a batch of signatures on the worker threads, so the VerifyMessage calls made while processing their messages hit the signature cache
+void CheckSignedMessages(std::vector<CSignedMessageCheck>& vChecks);
+/// Verify the signatures of the Masternode-layer messages a node has queued, in parallel, ahead of processing them
+void CheckQueuedMessageSignatures(CNode* pfrom);
+/// Run a message signature check worker
+void ThreadMessageSignatureCheck();
+
 /** Used to keep track of current status of Obfuscation pool
  */
 class CObfuscationPool
@@ -512,6 +549,7 @@ public:
     void RelayCompletedTransaction(const int sessionID, const bool error, const int errorID);
 };
 
-void ThreadCheckObfuScationPool();
+/** Schedule the masternode sync and the periodic masternode and Obfuscation maintenance */
+void StartObfuScationPoolChecks(CScheduler& scheduler);
 
 #endif
@@ -5,6 +5,7 @@
 
 #include "primitives/block.h"
 
+#include "crypto/sha256.h"
 #include "hash.h"
 #include "script/standard.h"
 #include "script/sign.h"
@@ -12,11 +13,41 @@
 #include "utilstrencodings.h"
 #include "util.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 uint256 CBlockHeader::GetHash() const
 {
     return HashQuark(BEGIN(nVersion), END(nNonce));
 }
 
+static void GetBlockHeaderHashRange(const std::vector<CBlockHeader>* pvHeaders, size_t nBegin, size_t nEnd, std::vector<uint256>* pvHashes)
+{
+    for (size_t i = nBegin; i < nEnd; i++)
+        (*pvHashes)[i] = (*pvHeaders)[i].GetHash();
+}
+
+void GetBlockHeaderHashes(const std::vector<CBlockHeader>& vHeaders, std::vector<uint256>& vHashes)
+{
+    // Below this many headers per thread, starting the thread costs more
+    // than it saves
+    static const size_t MIN_HEADERS_PER_THREAD = 256;
+
+    vHashes.resize(vHeaders.size());
+    size_t nThreads = std::min((size_t)boost::thread::hardware_concurrency(), vHeaders.size() / MIN_HEADERS_PER_THREAD);
+    if (nThreads <= 1) {
+        GetBlockHeaderHashRange(&vHeaders, 0, vHeaders.size(), &vHashes);
+        return;
+    }
+
+    size_t nPerThread = (vHeaders.size() + nThreads - 1) / nThreads;
+    boost::thread_group threads;
+    for (size_t nBegin = nPerThread; nBegin < vHeaders.size(); nBegin += nPerThread)
+        threads.create_thread(boost::bind(&GetBlockHeaderHashRange, &vHeaders, nBegin, std::min(nBegin + nPerThread, vHeaders.size()), &vHashes));
+    GetBlockHeaderHashRange(&vHeaders, 0, nPerThread, &vHashes);
+    threads.join_all();
+}
+
 uint256 CBlock::BuildMerkleTree(bool* fMutated) const
 {
     /* WARNING! If you're reading this because you're learning about crypto
@@ -62,15 +93,18 @@ uint256 CBlock::BuildMerkleTree(bool* fMutated) const
     bool mutated = false;
     for (int nSize = vtx.size(); nSize > 1; nSize = (nSize + 1) / 2)
     {
-        for (int i = 0; i < nSize; i += 2)
-        {
-            int i2 = std::min(i+1, nSize-1);
-            if (i2 == i + 1 && i2 + 1 == nSize && vMerkleTree[j+i] == vMerkleTree[j+i2]) {
-                // Two identical hashes at the end of the list at a particular level.
-                mutated = true;
-            }
-            vMerkleTree.push_back(Hash(BEGIN(vMerkleTree[j+i]),  END(vMerkleTree[j+i]),
-                                       BEGIN(vMerkleTree[j+i2]), END(vMerkleTree[j+i2])));
+        if ((nSize & 1) == 0 && vMerkleTree[j+nSize-2] == vMerkleTree[j+nSize-1]) {
+            // Two identical hashes at the end of the list at a particular level.
+            mutated = true;
+        }
+        // Adjacent pairs are already laid out as 64-byte inputs, so all of them
+        // are hashed in one batch; an odd last hash is paired with itself.
+        int nPairs = nSize / 2;
+        vMerkleTree.resize(j + nSize + (nSize + 1) / 2);
+        SHA256D64(vMerkleTree[j+nSize].begin(), vMerkleTree[j].begin(), nPairs);
+        if (nSize & 1) {
+            const uint256& last = vMerkleTree[j+nSize-1];
+            vMerkleTree.back() = Hash(BEGIN(last), END(last), BEGIN(last), END(last));
         }
         j += nSize;
     }
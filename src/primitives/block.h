@@ -74,6 +74,13 @@ public:
     }
 };
 
+/**
+ * Hash many headers at once. The Quark hashes are independent, so large
+ * batches are split over the available cores; hashing every header of the
+ * block index at startup is what this is for.
+ */
+void GetBlockHeaderHashes(const std::vector<CBlockHeader>& vHeaders, std::vector<uint256>& vHashes);
+
 
 class CBlock : public CBlockHeader
 {
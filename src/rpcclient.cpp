@@ -95,6 +95,11 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"prioritisetransaction", 1},
         {"prioritisetransaction", 2},
         {"spork", 1},
+        {"mnsimulate", 0},
+        {"mnsimulate", 1},
+        {"mnsimulate", 2},
+        {"mnsimulate", 3},
+        {"mnsimulate", 4},
         {"mnbudget", 3},
         {"mnbudget", 4},
         {"mnbudget", 6},
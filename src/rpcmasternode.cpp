@@ -14,6 +14,7 @@
 #include "masternodeconfig.h"
 #include "masternodeman.h"
 #include "rpcserver.h"
+#include "swifttx.h"
 #include "utilmoneystr.h"
 
 #include <boost/tokenizer.hpp>
@@ -127,6 +128,45 @@ Value getpoolinfo(const Array& params, bool fHelp)
     return obj;
 }
 
+Value getswifttxinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getswifttxinfo\n"
+            "\nReturns the state of the SwiftTX transaction locks\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"requests\": xxxx,        (numeric) Lock requests held\n"
+            "  \"rejected\": xxxx,        (numeric) Lock requests that failed to enter the mempool\n"
+            "  \"votes\": xxxx,           (numeric) Lock votes held\n"
+            "  \"locks\": xxxx,           (numeric) Transaction locks held\n"
+            "  \"locked_inputs\": xxxx,   (numeric) Inputs spent by complete locks\n"
+            "  \"completed\": xxxx,       (numeric) Locks completed\n"
+            "  \"lock_ms_avg\": xxxx,     (numeric) Average time from first seeing a lock to completing it\n"
+            "  \"lock_ms_max\": xxxx,     (numeric) Longest time to complete a lock\n"
+            "  \"lock_ms_last\": xxxx,    (numeric) Time to complete the last lock\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getswifttxinfo", "") + HelpExampleRpc("getswifttxinfo", ""));
+
+    CTransactionLockStats stats;
+    txLockManager.GetStats(stats);
+
+    Object obj;
+    obj.push_back(Pair("requests", (uint64_t)stats.nLockRequests));
+    obj.push_back(Pair("rejected", (uint64_t)stats.nRejectedLockRequests));
+    obj.push_back(Pair("votes", (uint64_t)stats.nVotes));
+    obj.push_back(Pair("locks", (uint64_t)stats.nLocks));
+    obj.push_back(Pair("locked_inputs", (uint64_t)stats.nLockedInputs));
+    obj.push_back(Pair("completed", stats.nLocksCompleted));
+    obj.push_back(Pair("lock_ms_avg", stats.nLocksCompleted ? stats.nLockTimeTotal / stats.nLocksCompleted : 0));
+    obj.push_back(Pair("lock_ms_max", stats.nLockTimeMax));
+    obj.push_back(Pair("lock_ms_last", stats.nLockTimeLast));
+    return obj;
+}
+
 // This command is retained for backwards compatibility, but is depreciated.
 // Future removal of this command is planned to keep things clean.
 Value masternode(const Array& params, bool fHelp)
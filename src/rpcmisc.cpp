@@ -10,7 +10,11 @@
 #include "clientversion.h"
 #include "init.h"
 #include "main.h"
+#include "masternode-budget.h"
+#include "masternode-payments.h"
+#include "masternode-simulator.h"
 #include "masternode-sync.h"
+#include "masternodeman.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpcserver.h"
@@ -186,6 +190,152 @@ Value mnsync(const Array& params, bool fHelp)
     return "failure";
 }
 
+static Object MemoryUsageToJSON(const std::map<std::string, std::pair<size_t, size_t> >& mapUsage, size_t& nTotal)
+{
+    Object obj;
+    for (std::map<std::string, std::pair<size_t, size_t> >::const_iterator it = mapUsage.begin(); it != mapUsage.end(); ++it) {
+        Object entry;
+        entry.push_back(Pair("entries", (uint64_t)it->second.first));
+        entry.push_back(Pair("usage", (uint64_t)it->second.second));
+        obj.push_back(Pair(it->first, entry));
+        nTotal += it->second.second;
+    }
+    return obj;
+}
+
+Value getmemoryinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns the number of entries and the approximate memory usage of the masternode, budget and payment maps.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"masternodes\": {                (object) Masternode list maps\n"
+            "    \"name\": {                     (object) One entry per map\n"
+            "      \"entries\": n,               (numeric) Number of entries\n"
+            "      \"usage\": n                  (numeric) Approximate memory usage in bytes, with the expiry index\n"
+            "    }, ...\n"
+            "  },\n"
+            "  \"budget\": { ... },              (object) Budget maps\n"
+            "  \"payments\": { ... },            (object) Masternode payment maps\n"
+            "  \"sync\": { ... },                (object) Masternode sync maps\n"
+            "  \"usage\": n                      (numeric) Approximate memory usage of all of the above in bytes\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getmemoryinfo", "") + HelpExampleRpc("getmemoryinfo", ""));
+
+    size_t nTotal = 0;
+    Object obj;
+    std::map<std::string, std::pair<size_t, size_t> > mapUsage;
+
+    mnodeman.GetMemoryUsage(mapUsage);
+    obj.push_back(Pair("masternodes", MemoryUsageToJSON(mapUsage, nTotal)));
+
+    mapUsage.clear();
+    budget.GetMemoryUsage(mapUsage);
+    obj.push_back(Pair("budget", MemoryUsageToJSON(mapUsage, nTotal)));
+
+    mapUsage.clear();
+    masternodePayments.GetMemoryUsage(mapUsage);
+    obj.push_back(Pair("payments", MemoryUsageToJSON(mapUsage, nTotal)));
+
+    mapUsage.clear();
+    masternodeSync.GetMemoryUsage(mapUsage);
+    obj.push_back(Pair("sync", MemoryUsageToJSON(mapUsage, nTotal)));
+
+    obj.push_back(Pair("usage", (uint64_t)nTotal));
+    return obj;
+}
+
+Value mnsimulate(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 5)
+        throw runtime_error(
+            "mnsimulate count ( proposals rate keep seed )\n"
+            "\nFeed the masternode subsystems signed traffic from virtual masternodes (-regtest only).\n"
+            "None of the traffic is relayed to peers, and everything it added is removed again afterwards unless keep is set.\n"
+
+            "\nArguments:\n"
+            "1. count         (numeric, required) Number of virtual masternodes\n"
+            "2. proposals     (numeric, optional, default=10) Number of budget proposals to vote on\n"
+            "3. rate          (numeric, optional, default=0) Messages per second, 0 for as fast as possible\n"
+            "4. keep          (boolean, optional, default=false) Leave the masternodes, proposals and votes in place\n"
+            "5. seed          (numeric, optional, default=0) Derive keys and proposals from this seed instead of at random,\n"
+            "                 so nodes with the same seed and mock time hold the same masternodes\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"masternodes\": n,              (numeric) Number of virtual masternodes\n"
+            "  \"proposals\": n,                (numeric) Number of budget proposals\n"
+            "  \"mnb\": {                       (object) One entry per message type (mnb, mnp, mnw, mvote)\n"
+            "    \"sent\": n,                   (numeric) Messages sent\n"
+            "    \"accepted\": n,               (numeric) Messages that changed the state of the node\n"
+            "    \"seconds\": n.nnn,            (numeric) Time spent in the handlers\n"
+            "    \"per_second\": n,             (numeric) Messages handled per second\n"
+            "    \"latency_avg_us\": n,         (numeric) Average time per message in microseconds\n"
+            "    \"latency_max_us\": n          (numeric) Time of the slowest message in microseconds\n"
+            "  }, ...\n"
+            "  \"memory\": {                    (object) One entry per subsystem (masternodes, budget, payments, sync)\n"
+            "    \"name\": {\n"
+            "      \"entries_before\": n,       (numeric) Number of entries before the traffic\n"
+            "      \"usage_before\": n,         (numeric) Approximate memory usage in bytes before the traffic\n"
+            "      \"entries_after\": n,        (numeric) Number of entries after the traffic\n"
+            "      \"usage_after\": n           (numeric) Approximate memory usage in bytes after the traffic\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("mnsimulate", "200") + HelpExampleRpc("mnsimulate", "200, 10, 0"));
+
+    if (!Params().MineBlocksOnDemand())
+        throw runtime_error("mnsimulate for regression testing (-regtest mode) only");
+
+    int nMasternodes = params[0].get_int();
+    int nProposals = params.size() > 1 ? params[1].get_int() : 10;
+    int nRate = params.size() > 2 ? params[2].get_int() : 0;
+    bool fKeep = params.size() > 3 ? params[3].get_bool() : false;
+    int64_t nSeed = params.size() > 4 ? params[4].get_int64() : 0;
+    if (nMasternodes < 1 || nProposals < 0 || nRate < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, expected positive count and non-negative proposals and rate");
+
+    CMasternodeSimulator simulator(nMasternodes, nProposals, nRate, fKeep, nSeed);
+    std::string strError;
+    if (!simulator.Run(strError))
+        throw runtime_error(strError);
+
+    Object obj;
+    obj.push_back(Pair("masternodes", nMasternodes));
+    obj.push_back(Pair("proposals", nProposals));
+
+    BOOST_FOREACH (const CMasternodeSimulatorTraffic& traffic, simulator.GetTraffic()) {
+        Object entry;
+        entry.push_back(Pair("sent", traffic.nSent));
+        entry.push_back(Pair("accepted", traffic.nAccepted));
+        entry.push_back(Pair("seconds", traffic.nTimeTotal / 1000000.0));
+        entry.push_back(Pair("per_second", traffic.nTimeTotal > 0 ? (int64_t)(traffic.nSent * 1000000LL / traffic.nTimeTotal) : (int64_t)0));
+        entry.push_back(Pair("latency_avg_us", traffic.nSent > 0 ? traffic.nTimeTotal / traffic.nSent : (int64_t)0));
+        entry.push_back(Pair("latency_max_us", traffic.nTimeMax));
+        obj.push_back(Pair(traffic.strCommand, entry));
+    }
+
+    Object memory;
+    BOOST_FOREACH (const CMasternodeSimulatorUsage& usage, simulator.GetUsage()) {
+        Object entry;
+        entry.push_back(Pair("entries_before", (uint64_t)usage.nEntriesBefore));
+        entry.push_back(Pair("usage_before", (uint64_t)usage.nUsageBefore));
+        entry.push_back(Pair("entries_after", (uint64_t)usage.nEntriesAfter));
+        entry.push_back(Pair("usage_after", (uint64_t)usage.nUsageAfter));
+        memory.push_back(Pair(usage.strSubsystem, entry));
+    }
+    obj.push_back(Pair("memory", memory));
+
+    return obj;
+}
+
 #ifdef ENABLE_WALLET
 class DescribeAddressVisitor : public boost::static_visitor<Object>
 {
@@ -16,6 +16,9 @@
 #include "timedata.h"
 #include "util.h"
 #include "version.h"
+#if ENABLE_ZMQ
+#include "zmq/zmqnotificationinterface.h"
+#endif
 
 #include <boost/foreach.hpp>
 
@@ -314,7 +317,15 @@ Value getnettotals(const Array& params, bool fHelp)
             "{\n"
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
-            "  \"timemillis\": t        (numeric) Total cpu time\n"
+            "  \"timemillis\": t,       (numeric) Total cpu time\n"
+            "  \"inventory\": {         (json object) Inventory relay since startup\n"
+            "    \"queued\": n,         (numeric) Items queued for relay\n"
+            "    \"merged\": n,         (numeric) Duplicate items merged while queued\n"
+            "    \"known\": n,          (numeric) Announcements skipped because the peer already had the item\n"
+            "    \"announced\": n,      (numeric) Inventory entries sent\n"
+            "    \"messages\": n,       (numeric) inv messages sent\n"
+            "    \"bytessaved\": n      (numeric) Estimated bytes not sent thanks to deduplication and batching\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getnettotals", "") + HelpExampleRpc("getnettotals", ""));
@@ -323,6 +334,17 @@ Value getnettotals(const Array& params, bool fHelp)
     obj.push_back(Pair("totalbytesrecv", CNode::GetTotalBytesRecv()));
     obj.push_back(Pair("totalbytessent", CNode::GetTotalBytesSent()));
     obj.push_back(Pair("timemillis", GetTimeMillis()));
+
+    // A skipped entry saves 36 bytes, an entry sharing an inv message with others saves a 24 byte header
+    CInvRelayStats invStats = GetInvRelayStats();
+    Object inventory;
+    inventory.push_back(Pair("queued", invStats.nQueued));
+    inventory.push_back(Pair("merged", invStats.nMerged));
+    inventory.push_back(Pair("known", invStats.nKnown));
+    inventory.push_back(Pair("announced", invStats.nAnnounced));
+    inventory.push_back(Pair("messages", invStats.nMessages));
+    inventory.push_back(Pair("bytessaved", invStats.nKnown * 36 + (invStats.nAnnounced - invStats.nMessages) * 24));
+    obj.push_back(Pair("inventory", inventory));
     return obj;
 }
 
@@ -405,3 +427,63 @@ Value getnetworkinfo(const Array& params, bool fHelp)
     obj.push_back(Pair("localaddresses", localAddresses));
     return obj;
 }
+
+#if ENABLE_ZMQ
+Value getzmqnotifications(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getzmqnotifications\n"
+            "\nReturns the active ZMQ notifiers and the state of the publisher queue.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"queue\": {\n"
+            "    \"size\": n,          (numeric) Messages waiting for the publisher thread\n"
+            "    \"maxsize\": n,       (numeric) Queue capacity (-zmqqueuesize)\n"
+            "    \"highwater\": n,     (numeric) Largest queue size seen since startup\n"
+            "    \"dropped\": n        (numeric) Messages dropped because the queue was full\n"
+            "  },\n"
+            "  \"notifiers\": [\n"
+            "    {\n"
+            "      \"type\": \"pubtype\",   (string) Type of notification\n"
+            "      \"address\": \"...\",    (string) Address of the publisher\n"
+            "      \"enabled\": true|false, (boolean) False after a failed publish\n"
+            "      \"published\": n,      (numeric) Messages handed to ZMQ\n"
+            "      \"dropped\": n,        (numeric) Messages dropped because the queue was full\n"
+            "      \"failed\": n          (numeric) Messages that could not be built or sent\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getzmqnotifications", "") + HelpExampleRpc("getzmqnotifications", ""));
+
+    std::vector<CZMQPublishStats> vStats;
+    CZMQPublishQueueStats queueStats = CZMQPublishQueueStats();
+    if (pzmqNotificationInterface)
+        pzmqNotificationInterface->GetStats(vStats, queueStats);
+
+    Object queue;
+    queue.push_back(Pair("size", (uint64_t)queueStats.nSize));
+    queue.push_back(Pair("maxsize", (uint64_t)queueStats.nMaxSize));
+    queue.push_back(Pair("highwater", (uint64_t)queueStats.nHighWater));
+    queue.push_back(Pair("dropped", queueStats.nDropped));
+
+    Array notifiers;
+    BOOST_FOREACH (const CZMQPublishStats& stats, vStats) {
+        Object obj;
+        obj.push_back(Pair("type", stats.type));
+        obj.push_back(Pair("address", stats.address));
+        obj.push_back(Pair("enabled", stats.fEnabled));
+        obj.push_back(Pair("published", stats.nPublished));
+        obj.push_back(Pair("dropped", stats.nDropped));
+        obj.push_back(Pair("failed", stats.nFailed));
+        notifiers.push_back(obj);
+    }
+
+    Object obj;
+    obj.push_back(Pair("queue", queue));
+    obj.push_back(Pair("notifiers", notifiers));
+    return obj;
+}
+#endif
@@ -247,6 +247,9 @@ static const CRPCCommand vRPCCommands[] =
         {"network", "getnettotals", &getnettotals, true, true, false},
         {"network", "getpeerinfo", &getpeerinfo, true, false, false},
         {"network", "ping", &ping, true, false, false},
+#if ENABLE_ZMQ
+        {"network", "getzmqnotifications", &getzmqnotifications, true, true, false},
+#endif
 
         /* Block chain and UTXO */
         {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false},
@@ -299,6 +302,7 @@ static const CRPCCommand vRPCCommands[] =
         {"hidden", "invalidateblock", &invalidateblock, true, true, false},
         {"hidden", "reconsiderblock", &reconsiderblock, true, true, false},
         {"hidden", "setmocktime", &setmocktime, true, false, false},
+        {"hidden", "mnsimulate", &mnsimulate, true, true, false},
 
         /* Saviour features */
         {"saviour", "masternode", &masternode, true, true, false},
@@ -326,8 +330,10 @@ static const CRPCCommand vRPCCommands[] =
         {"saviour", "mnfinalbudget", &mnfinalbudget, true, true, false},
         {"saviour", "checkbudgets", &checkbudgets, true, true, false},
         {"saviour", "mnsync", &mnsync, true, true, false},
+        {"saviour", "getmemoryinfo", &getmemoryinfo, true, true, false},
         {"saviour", "spork", &spork, true, true, false},
         {"saviour", "getpoolinfo", &getpoolinfo, true, true, false},
+        {"saviour", "getswifttxinfo", &getswifttxinfo, true, true, false},
 #ifdef ENABLE_WALLET
         {"saviour", "obfuscation", &obfuscation, false, false, true}, /* not threadSafe because of SendMoney */
 
@@ -0,0 +1,81 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SCHEDULER_H
+#define BITCOIN_SCHEDULER_H
+
+#include <map>
+
+#include <stdint.h>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread_time.hpp>
+
+/**
+ * Simple class for background tasks that should be run
+ * periodically or once "after a while"
+ *
+ * Usage:
+ *
+ * CScheduler* s = new CScheduler();
+ * s->scheduleFromNow(doSomething, 11); // Assuming a: void doSomething() { }
+ * s->scheduleFromNow(boost::bind(Class::func, this, argument), 3);
+ * boost::thread* t = new boost::thread(boost::bind(CScheduler::serviceQueue, s));
+ *
+ * ... then at program shutdown, clean up the thread running serviceQueue:
+ * s->stop();
+ * t->join();
+ * delete t;
+ * delete s; // Must be done after thread is interrupted/joined.
+ */
+class CScheduler
+{
+public:
+    CScheduler();
+    ~CScheduler();
+
+    typedef boost::function<void(void)> Function;
+
+    // Call func at/after time t
+    void schedule(Function f, boost::system_time t);
+
+    // Convenience method: call f once deltaMilliSeconds from now
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+
+    // Another convenience method: call f approximately
+    // every deltaMilliSeconds forever, starting deltaMilliSeconds from now.
+    // To be more precise: every time f is finished, it
+    // is rescheduled to run deltaMilliSeconds later. If you
+    // need more accurate scheduling, don't use this method.
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+
+    // To keep things as simple as possible, there is no unschedule.
+
+    // Services the queue 'forever'. Should be run in a thread,
+    // and interrupted using boost::interrupt_thread
+    void serviceQueue();
+
+    // Tell any threads running serviceQueue to stop as soon as they're
+    // done servicing whatever task they're currently servicing (drain=false)
+    // or when there is no work left to be done (drain=true)
+    void stop(bool drain = false);
+
+    // Returns number of tasks waiting to be serviced,
+    // and first and last task times
+    size_t getQueueInfo(boost::system_time& first, boost::system_time& last) const;
+
+private:
+    std::multimap<boost::system_time, Function> taskQueue;
+    boost::condition_variable newTaskScheduled;
+    mutable boost::mutex newTaskMutex;
+    int nThreadsServicingQueue;
+    bool stopRequested;
+    bool stopWhenEmpty;
+    bool shouldStop() { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
+};
+
+#endif // BITCOIN_SCHEDULER_H
@@ -14,6 +14,8 @@
 #include "script/script.h"
 #include "uint256.h"
 
+#include <algorithm>
+
 using namespace std;
 
 typedef vector<unsigned char> valtype;
@@ -57,7 +59,42 @@ bool CastToBool(const valtype& vch)
  */
 #define stacktop(i)  (stack.at(stack.size()+(i)))
 #define altstacktop(i)  (altstack.at(altstack.size()+(i)))
-static inline void popstack(vector<valtype>& stack)
+void CScriptStack::erase(iterator first, iterator last)
+{
+    // Rotate the removed elements past the live part; swapping vectors moves
+    // no data
+    std::rotate(first, last, end());
+    nSize -= last - first;
+}
+
+void CScriptStack::insert(iterator pos, const valtype& vch)
+{
+    size_t nPos = pos - begin();
+    push_back(vch);
+    std::rotate(begin() + nPos, end() - 1, end());
+}
+
+void CScriptStack::assign(const CScriptStack& other)
+{
+    nSize = 0;
+    for (size_t i = 0; i < other.nSize; i++)
+        PushSlot().assign(other.vStorage[i].begin(), other.vStorage[i].end());
+}
+
+void CScriptStack::swap(std::vector<valtype>& vOther)
+{
+    vStorage.resize(nSize);
+    vStorage.swap(vOther);
+    nSize = vStorage.size();
+}
+
+void CScriptStack::swap(CScriptStack& other)
+{
+    vStorage.swap(other.vStorage);
+    std::swap(nSize, other.nSize);
+}
+
+static inline void popstack(CScriptStack& stack)
 {
     if (stack.empty())
         throw runtime_error("popstack() : stack empty");
@@ -235,7 +272,16 @@ bool static CheckMinimalPush(const valtype& data, opcodetype opcode) {
     return true;
 }
 
-bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+bool EvalScript(vector<vector<unsigned char> >& vStack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+{
+    CScriptStack stack;
+    stack.swap(vStack);
+    bool fResult = EvalScript(stack, script, flags, checker, serror);
+    stack.swap(vStack);
+    return fResult;
+}
+
+bool EvalScript(CScriptStack& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
 {
     static const CScriptNum bnZero(0);
     static const CScriptNum bnOne(1);
@@ -251,7 +297,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
     opcodetype opcode;
     valtype vchPushValue;
     vector<bool> vfExec;
-    vector<valtype> altstack;
+    CScriptStack altstack;
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
     if (script.size() > 10000)
         return set_error(serror, SCRIPT_ERR_SCRIPT_SIZE);
@@ -437,10 +483,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- x1 x2 x1 x2)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch1 = stacktop(-2);
-                    valtype vch2 = stacktop(-1);
-                    stack.push_back(vch1);
-                    stack.push_back(vch2);
+                    stack.push_back(stacktop(-2));
+                    stack.push_back(stacktop(-2));
                 }
                 break;
 
@@ -449,12 +493,9 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 x3 -- x1 x2 x3 x1 x2 x3)
                     if (stack.size() < 3)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch1 = stacktop(-3);
-                    valtype vch2 = stacktop(-2);
-                    valtype vch3 = stacktop(-1);
-                    stack.push_back(vch1);
-                    stack.push_back(vch2);
-                    stack.push_back(vch3);
+                    stack.push_back(stacktop(-3));
+                    stack.push_back(stacktop(-3));
+                    stack.push_back(stacktop(-3));
                 }
                 break;
 
@@ -463,10 +504,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 x3 x4 -- x1 x2 x3 x4 x1 x2)
                     if (stack.size() < 4)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch1 = stacktop(-4);
-                    valtype vch2 = stacktop(-3);
-                    stack.push_back(vch1);
-                    stack.push_back(vch2);
+                    stack.push_back(stacktop(-4));
+                    stack.push_back(stacktop(-4));
                 }
                 break;
 
@@ -475,11 +514,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 x3 x4 x5 x6 -- x3 x4 x5 x6 x1 x2)
                     if (stack.size() < 6)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch1 = stacktop(-6);
-                    valtype vch2 = stacktop(-5);
-                    stack.erase(stack.end()-6, stack.end()-4);
-                    stack.push_back(vch1);
-                    stack.push_back(vch2);
+                    std::rotate(stack.end()-6, stack.end()-4, stack.end());
                 }
                 break;
 
@@ -498,9 +533,8 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x - 0 | x x)
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-1);
-                    if (CastToBool(vch))
-                        stack.push_back(vch);
+                    if (CastToBool(stacktop(-1)))
+                        stack.push_back(stacktop(-1));
                 }
                 break;
 
@@ -526,8 +560,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x -- x x)
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-1);
-                    stack.push_back(vch);
+                    stack.push_back(stacktop(-1));
                 }
                 break;
 
@@ -545,8 +578,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- x1 x2 x1)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-2);
-                    stack.push_back(vch);
+                    stack.push_back(stacktop(-2));
                 }
                 break;
 
@@ -561,10 +593,10 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     popstack(stack);
                     if (n < 0 || n >= (int)stack.size())
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-n-1);
                     if (opcode == OP_ROLL)
-                        stack.erase(stack.end()-n-1);
-                    stack.push_back(vch);
+                        std::rotate(stack.end()-n-1, stack.end()-n, stack.end());
+                    else
+                        stack.push_back(stacktop(-n-1));
                 }
                 break;
 
@@ -594,8 +626,7 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     // (x1 x2 -- x2 x1 x2)
                     if (stack.size() < 2)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-                    valtype vch = stacktop(-1);
-                    stack.insert(stack.end()-2, vch);
+                    stack.insert(stack.end()-2, stacktop(-1));
                 }
                 break;
 
@@ -759,19 +790,20 @@ bool EvalScript(vector<vector<unsigned char> >& stack, const CScript& script, un
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
                     valtype& vch = stacktop(-1);
-                    valtype vchHash((opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32);
+                    unsigned char vchHash[32];
+                    size_t nHashSize = (opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32;
                     if (opcode == OP_RIPEMD160)
-                        CRIPEMD160().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CRIPEMD160().Write(begin_ptr(vch), vch.size()).Finalize(vchHash);
                     else if (opcode == OP_SHA1)
-                        CSHA1().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CSHA1().Write(begin_ptr(vch), vch.size()).Finalize(vchHash);
                     else if (opcode == OP_SHA256)
-                        CSHA256().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CSHA256().Write(begin_ptr(vch), vch.size()).Finalize(vchHash);
                     else if (opcode == OP_HASH160)
-                        CHash160().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CHash160().Write(begin_ptr(vch), vch.size()).Finalize(vchHash);
                     else if (opcode == OP_HASH256)
-                        CHash256().Write(begin_ptr(vch), vch.size()).Finalize(begin_ptr(vchHash));
+                        CHash256().Write(begin_ptr(vch), vch.size()).Finalize(vchHash);
                     popstack(stack);
-                    stack.push_back(vchHash);
+                    stack.push_back(vchHash, vchHash + nHashSize);
                 }
                 break;                                   
 
@@ -1031,9 +1063,86 @@ public:
     }
 };
 
+/** Serializes straight into a SHA256 state, so hashing can resume from a midstate */
+class CSHA256Writer
+{
+private:
+    CSHA256& ctx;
+
+public:
+    int nType;
+    int nVersion;
+
+    CSHA256Writer(CSHA256& ctxIn, int nTypeIn, int nVersionIn) : ctx(ctxIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    CSHA256Writer& write(const char* pch, size_t size)
+    {
+        ctx.Write((const unsigned char*)pch, size);
+        return (*this);
+    }
+
+    template <typename T>
+    CSHA256Writer& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Serializes by appending to a byte vector */
+class CByteVectorWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+
+public:
+    int nType;
+    int nVersion;
+
+    CByteVectorWriter(std::vector<unsigned char>& vchIn, int nTypeIn, int nVersionIn) : vch(vchIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    CByteVectorWriter& write(const char* pch, size_t size)
+    {
+        vch.insert(vch.end(), (const unsigned char*)pch, (const unsigned char*)pch + size);
+        return (*this);
+    }
+
+    template <typename T>
+    CByteVectorWriter& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+/** Blanked inputs serialize to a fixed size: prevout, empty script, nSequence */
+const size_t BLANKED_INPUT_SIZE = 36 + 1 + 4;
+
 } // anon namespace
 
-uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType)
+PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+{
+    vchBlankedInputs.reserve(BLANKED_INPUT_SIZE * txTo.vin.size());
+    CByteVectorWriter ssInputs(vchBlankedInputs, SER_GETHASH, 0);
+    for (unsigned int i = 0; i < txTo.vin.size(); i++)
+        ssInputs << txTo.vin[i].prevout << CScript() << txTo.vin[i].nSequence;
+    assert(vchBlankedInputs.size() == BLANKED_INPUT_SIZE * txTo.vin.size());
+
+    CByteVectorWriter ssOutputs(vchOutputs, SER_GETHASH, 0);
+    ssOutputs << txTo.vout << txTo.nLockTime;
+
+    CSHA256 ctx;
+    CSHA256Writer ss(ctx, SER_GETHASH, 0);
+    ss << txTo.nVersion;
+    ::WriteCompactSize(ss, txTo.vin.size());
+    vMidstates.reserve(txTo.vin.size());
+    for (unsigned int i = 0; i < txTo.vin.size(); i++) {
+        vMidstates.push_back(ctx);
+        ctx.Write(&vchBlankedInputs[i * BLANKED_INPUT_SIZE], BLANKED_INPUT_SIZE);
+    }
+}
+
+uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* txdata)
 {
     if (nIn >= txTo.vin.size()) {
         //  nIn out of range
@@ -1051,6 +1160,26 @@ uint256 SignatureHash(const CScript& scriptCode, const CTransaction& txTo, unsig
     // Wrapper to serialize only the necessary parts of the transaction being signed
     CTransactionSignatureSerializer txTmp(txTo, scriptCode, nIn, nHashType);
 
+    // Anything that serializes like SIGHASH_ALL resumes from the input's
+    // midstate and appends the cached pieces
+    bool fLikeAll = !(nHashType & SIGHASH_ANYONECANPAY) && (nHashType & 0x1f) != SIGHASH_SINGLE && (nHashType & 0x1f) != SIGHASH_NONE;
+    if (txdata && fLikeAll && nIn < txdata->vMidstates.size()) {
+        CSHA256 ctx(txdata->vMidstates[nIn]);
+        CSHA256Writer ss(ctx, SER_GETHASH, 0);
+        txTmp.SerializeInput(ss, nIn, SER_GETHASH, 0);
+        size_t nOffset = (nIn + 1) * BLANKED_INPUT_SIZE;
+        if (nOffset < txdata->vchBlankedInputs.size())
+            ctx.Write(&txdata->vchBlankedInputs[nOffset], txdata->vchBlankedInputs.size() - nOffset);
+        ctx.Write(&txdata->vchOutputs[0], txdata->vchOutputs.size());
+        ss << nHashType;
+
+        uint256 hash;
+        unsigned char buf[CSHA256::OUTPUT_SIZE];
+        ctx.Finalize(buf);
+        CSHA256().Write(buf, CSHA256::OUTPUT_SIZE).Finalize((unsigned char*)&hash);
+        return hash;
+    }
+
     // Serialize and hash
     CHashWriter ss(SER_GETHASH, 0);
     ss << txTmp << nHashType;
@@ -1075,7 +1204,7 @@ bool TransactionSignatureChecker::CheckSig(const vector<unsigned char>& vchSigIn
     int nHashType = vchSig.back();
     vchSig.pop_back();
 
-    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType);
+    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType, txdata);
 
     if (!VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -1083,7 +1212,7 @@ bool TransactionSignatureChecker::CheckSig(const vector<unsigned char>& vchSigIn
     return true;
 }
 
-bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror)
+bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* serror, CScriptStackArena* arena)
 {
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
 
@@ -1091,12 +1220,21 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
         return set_error(serror, SCRIPT_ERR_SIG_PUSHONLY);
     }
 
-    vector<vector<unsigned char> > stack, stackCopy;
+    CScriptStackArena arenaLocal;
+    if (!arena)
+        arena = &arenaLocal;
+    CScriptStack& stack = arena->stack;
+    CScriptStack& stackCopy = arena->stackCopy;
+    stack.clear();
+    stackCopy.clear();
+
     if (!EvalScript(stack, scriptSig, flags, checker, serror))
         // serror is set
         return false;
-    if (flags & SCRIPT_VERIFY_P2SH)
-        stackCopy = stack;
+    // Only pay-to-script-hash spends need the stack as left by scriptSig
+    bool fP2SH = (flags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash();
+    if (fP2SH)
+        stackCopy.assign(stack);
     if (!EvalScript(stack, scriptPubKey, flags, checker, serror))
         // serror is set
         return false;
@@ -1107,7 +1245,7 @@ bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigne
         return set_error(serror, SCRIPT_ERR_EVAL_FALSE);
 
     // Additional validation for spend-to-script-hash transactions:
-    if ((flags & SCRIPT_VERIFY_P2SH) && scriptPubKey.IsPayToScriptHash())
+    if (fP2SH)
     {
         // scriptSig must be literals-only or validation fails
         if (!scriptSig.IsPushOnly())
@@ -6,9 +6,11 @@
 #ifndef BITCOIN_SCRIPT_INTERPRETER_H
 #define BITCOIN_SCRIPT_INTERPRETER_H
 
+#include "crypto/sha256.h"
 #include "script_error.h"
 #include "primitives/transaction.h"
 
+#include <stdexcept>
 #include <vector>
 #include <stdint.h>
 #include <string>
@@ -72,7 +74,28 @@ enum
 
 };
 
-uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType);
+/**
+ * The parts of a transaction's SIGHASH_ALL serialization that are the same
+ * for every input, prepared once so that checking all inputs of a
+ * transaction no longer reserializes it per input. The signature hash
+ * itself is unchanged: only the input being signed and the blanked inputs
+ * after it are hashed per input, the rest is resumed from a SHA256
+ * midstate. Read-only once built, so it is shared by the script check
+ * threads.
+ */
+struct PrecomputedTransactionData
+{
+    //! SHA256 state after nVersion, the input count and inputs [0, i) blanked, for each input i
+    std::vector<CSHA256> vMidstates;
+    //! All inputs serialized with their scriptSig blanked
+    std::vector<unsigned char> vchBlankedInputs;
+    //! The outputs followed by nLockTime
+    std::vector<unsigned char> vchOutputs;
+
+    PrecomputedTransactionData(const CTransaction& tx);
+};
+
+uint256 SignatureHash(const CScript &scriptCode, const CTransaction& txTo, unsigned int nIn, int nHashType, const PrecomputedTransactionData* txdata = NULL);
 
 class BaseSignatureChecker
 {
@@ -90,12 +113,13 @@ class TransactionSignatureChecker : public BaseSignatureChecker
 private:
     const CTransaction* txTo;
     unsigned int nIn;
+    const PrecomputedTransactionData* txdata;
 
 protected:
     virtual bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 
 public:
-    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn) : txTo(txToIn), nIn(nInIn) {}
+    TransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const PrecomputedTransactionData* txdataIn = NULL) : txTo(txToIn), nIn(nInIn), txdata(txdataIn) {}
     bool CheckSig(const std::vector<unsigned char>& scriptSig, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode) const;
 };
 
@@ -108,7 +132,80 @@ public:
     MutableTransactionSignatureChecker(const CMutableTransaction* txToIn, unsigned int nInIn) : TransactionSignatureChecker(&txTo, nInIn), txTo(*txToIn) {}
 };
 
+/**
+ * The script evaluation stack. Popped elements keep their buffers and later
+ * pushes copy into them, so once a stack has warmed up, evaluating ordinary
+ * scripts no longer allocates per push. Only the live part [0, size()) is
+ * visible; it behaves like the std::vector it replaces.
+ */
+class CScriptStack
+{
+public:
+    typedef std::vector<unsigned char> valtype;
+    typedef std::vector<valtype>::iterator iterator;
+
+private:
+    std::vector<valtype> vStorage;
+    size_t nSize;
+
+    valtype& PushSlot()
+    {
+        if (nSize == vStorage.size())
+            vStorage.push_back(valtype());
+        return vStorage[nSize++];
+    }
+
+public:
+    CScriptStack() : nSize(0) {}
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+    void clear() { nSize = 0; }
+
+    iterator begin() { return vStorage.begin(); }
+    iterator end() { return vStorage.begin() + nSize; }
+
+    valtype& at(size_t i)
+    {
+        if (i >= nSize)
+            throw std::out_of_range("CScriptStack::at() : out of range");
+        return vStorage[i];
+    }
+    valtype& back() { return at(nSize - 1); }
+
+    void push_back(const valtype& vch)
+    {
+        if (nSize == vStorage.size()) {
+            // vch may live in vStorage, which is about to grow
+            valtype vchCopy(vch);
+            PushSlot().swap(vchCopy);
+        } else
+            PushSlot().assign(vch.begin(), vch.end());
+    }
+    void push_back(const unsigned char* pbegin, const unsigned char* pend) { PushSlot().assign(pbegin, pend); }
+    void pop_back() { nSize--; }
+
+    //! Remove [first, last), keeping the removed buffers for reuse
+    void erase(iterator first, iterator last);
+    void erase(iterator pos) { erase(pos, pos + 1); }
+    void insert(iterator pos, const valtype& vch);
+
+    //! Make the live elements a copy of another stack's
+    void assign(const CScriptStack& other);
+    //! Exchange the live elements with a plain vector
+    void swap(std::vector<valtype>& vOther);
+    void swap(CScriptStack& other);
+};
+
+/** Stacks kept by a script checking thread from one VerifyScript to the next */
+struct CScriptStackArena
+{
+    CScriptStack stack;
+    CScriptStack stackCopy;
+};
+
 bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* error = NULL);
-bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* error = NULL);
+bool EvalScript(CScriptStack& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* error = NULL);
+bool VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey, unsigned int flags, const BaseSignatureChecker& checker, ScriptError* error = NULL, CScriptStackArena* arena = NULL);
 
 #endif // BITCOIN_SCRIPT_INTERPRETER_H
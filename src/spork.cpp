@@ -12,6 +12,7 @@
 #include "protocol.h"
 #include "sync.h"
 #include "util.h"
+#include "validationinterface.h"
 #include <boost/lexical_cast.hpp>
 
 using namespace std;
@@ -59,6 +60,7 @@ void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
         mapSporks[hash] = spork;
         mapSporksActive[spork.nSporkID] = spork;
         sporkManager.Relay(spork);
+        GetMainSignals().NotifySpork(spork);
 
         //does a task if needed
         ExecuteSpork(spork.nSporkID, spork.nValue);
@@ -227,6 +229,7 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue)
         Relay(msg);
         mapSporks[msg.GetHash()] = msg;
         mapSporksActive[nSporkID] = msg;
+        GetMainSignals().NotifySpork(msg);
         return true;
     }
 
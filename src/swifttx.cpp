@@ -17,12 +17,7 @@
 using namespace std;
 using namespace boost;
 
-std::map<uint256, CTransaction> mapTxLockReq;
-std::map<uint256, CTransaction> mapTxLockReqRejected;
-std::map<uint256, CConsensusVote> mapTxLockVote;
-std::map<uint256, CTransactionLock> mapTxLocks;
-std::map<COutPoint, uint256> mapLockedInputs;
-std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
+CTransactionLockManager txLockManager;
 int nCompleteTXLocks;
 
 //txlock - Locks transaction
@@ -47,7 +42,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+        if (txLockManager.HasLockRequest(tx.GetHash())) {
             return;
         }
 
@@ -79,7 +74,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+            txLockManager.AddLockRequest(tx);
 
             LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
@@ -88,7 +83,7 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
             return;
 
         } else {
-            mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
+            bool fReprocess = txLockManager.AddRejectedLockRequest(tx);
 
             // can we get the conflicting transaction as proof?
 
@@ -96,25 +91,11 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
                 tx.GetHash().ToString().c_str());
 
-            BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(make_pair(in.prevout, tx.GetHash()));
-                }
-            }
+            if (fReprocess) {
+                LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
 
-            // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
-            if (i != mapTxLocks.end()) {
-                //we only care if we have a complete tx lock
-                if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-                    if (!CheckForConflictingLocks(tx)) {
-                        LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
-
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
-                    }
-                }
+                //reprocess the last 15 blocks
+                ReprocessBlocks(15);
             }
 
             return;
@@ -122,17 +103,15 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
     } else if (strCommand == "txlvote") //SwiftTX Lock Consensus Votes
     {
         CConsensusVote ctx;
-        vRecv >> ctx;
+        pfrom->ReadMessage(vRecv, ctx);
 
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
+        if (!txLockManager.AddVote(ctx)) {
             return;
         }
 
-        mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx));
-
         if (ProcessConsensusVote(pfrom, ctx)) {
             //Spam/Dos protection
             /*
@@ -140,20 +119,11 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 This tracks those messages and allows it at the same rate of the rest of the network, if
                 a peer violates it, it will simply be ignored
             */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
-                if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
-                }
-
-                if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
-                    LogPrintf("ProcessMessageSwiftTX::ix - masternode is spamming transaction votes: %s %s\n",
-                        ctx.vinMasternode.ToString().c_str(),
-                        ctx.txHash.ToString().c_str());
-                    return;
-                } else {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
-                }
+            if (!txLockManager.CheckUnknownVote(ctx)) {
+                LogPrintf("ProcessMessageSwiftTX::ix - masternode is spamming transaction votes: %s %s\n",
+                    ctx.vinMasternode.ToString().c_str(),
+                    ctx.txHash.ToString().c_str());
+                return;
             }
             RelayInv(inv);
         }
@@ -228,20 +198,7 @@ int64_t CreateNewLock(CTransaction tx)
     */
     int nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
 
-    if (!mapTxLocks.count(tx.GetHash())) {
-        LogPrintf("CreateNewLock - New Transaction Lock %s !\n", tx.GetHash().ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = nBlockHeight;
-        newLock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = tx.GetHash();
-        mapTxLocks.insert(make_pair(tx.GetHash(), newLock));
-    } else {
-        mapTxLocks[tx.GetHash()].nBlockHeight = nBlockHeight;
-        LogPrint("swifttx", "CreateNewLock - Transaction Lock Exists %s !\n", tx.GetHash().ToString().c_str());
-    }
-
+    txLockManager.SetLockHeight(tx.GetHash(), nBlockHeight);
 
     return nBlockHeight;
 }
@@ -251,15 +208,10 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 {
     if (!fMasterNode) return;
 
-    int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    int n = txLockManager.GetMasternodeRank(activeMasternode.vin, nBlockHeight);
 
     if (n == -1) {
-        LogPrint("swifttx", "SwiftTX::DoConsensusVote - Unknown Masternode\n");
-        return;
-    }
-
-    if (n > SWIFTTX_SIGNATURES_TOTAL) {
-        LogPrint("swifttx", "SwiftTX::DoConsensusVote - Masternode not in the top %d (%d)\n", SWIFTTX_SIGNATURES_TOTAL, n);
+        LogPrint("swifttx", "SwiftTX::DoConsensusVote - Masternode not in the top %d\n", SWIFTTX_SIGNATURES_TOTAL);
         return;
     }
     /*
@@ -281,7 +233,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    txLockManager.AddVote(ctx);
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
@@ -290,21 +242,21 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 //received a consensus vote
 bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
 {
-    int n = mnodeman.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    int n = txLockManager.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight);
 
     CMasternode* pmn = mnodeman.Find(ctx.vinMasternode);
     if (pmn != NULL)
         LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Masternode ADDR %s %d\n", pmn->addr.ToString().c_str(), n);
 
-    if (n == -1) {
+    if (pmn == NULL) {
         //can be caused by past versions trying to vote with an invalid protocol
         LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Unknown Masternode\n");
         mnodeman.AskForMN(pnode, ctx.vinMasternode);
         return false;
     }
 
-    if (n > SWIFTTX_SIGNATURES_TOTAL) {
-        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Masternode not in the top %d (%d) - %s\n", SWIFTTX_SIGNATURES_TOTAL, n, ctx.GetHash().ToString().c_str());
+    if (n == -1) {
+        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Masternode not in the top %d - %s\n", SWIFTTX_SIGNATURES_TOTAL, ctx.GetHash().ToString().c_str());
         return false;
     }
 
@@ -315,71 +267,219 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         return false;
     }
 
-    if (!mapTxLocks.count(ctx.txHash)) {
-        LogPrintf("SwiftTX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
-
-        CTransactionLock newLock;
-        newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime() + (60 * 60);
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(make_pair(ctx.txHash, newLock));
-    } else
-        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
-
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end()) {
-        (*i).second.AddSignature(ctx);
+    bool fComplete = false;
+    bool fReprocess = false;
+    txLockManager.ProcessVote(ctx, fComplete, fReprocess);
 
+#ifdef ENABLE_WALLET
+    if (pwalletMain) {
+        //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
+        if (pwalletMain->mapRequestCount.count(ctx.txHash))
+            pwalletMain->mapRequestCount[ctx.txHash]++;
+    }
+#endif
+
+    if (fComplete) {
 #ifdef ENABLE_WALLET
         if (pwalletMain) {
-            //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
-            if (pwalletMain->mapRequestCount.count(ctx.txHash))
-                pwalletMain->mapRequestCount[ctx.txHash]++;
+            if (pwalletMain->UpdatedTransaction(ctx.txHash)) {
+                nCompleteTXLocks++;
+            }
         }
 #endif
 
-        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", (*i).second.CountSignatures(), ctx.GetHash().ToString().c_str());
+        // resolve conflicts
 
-        if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-            LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
+        //if this tx lock was rejected, we need to remove the conflicting blocks
+        if (fReprocess) {
+            //reprocess the last 15 blocks
+            ReprocessBlocks(15);
+        }
+    }
 
-            CTransaction& tx = mapTxLockReq[ctx.txHash];
-            if (!CheckForConflictingLocks(tx)) {
-#ifdef ENABLE_WALLET
-                if (pwalletMain) {
-                    if (pwalletMain->UpdatedTransaction((*i).second.txHash)) {
-                        nCompleteTXLocks++;
-                    }
-                }
-#endif
+    return true;
+}
 
-                if (mapTxLockReq.count(ctx.txHash)) {
-                    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-                        if (!mapLockedInputs.count(in.prevout)) {
-                            mapLockedInputs.insert(make_pair(in.prevout, ctx.txHash));
-                        }
-                    }
-                }
+CTransactionLockManager::CTransactionLockManager() : nLocksCompleted(0), nLockTimeTotal(0), nLockTimeMax(0), nLockTimeLast(0)
+{
+}
 
-                // resolve conflicts
+bool CTransactionLockManager::HasLockRequest(const uint256& txHash) const
+{
+    LOCK(cs);
+    return mapTxLockReq.count(txHash) || mapTxLockReqRejected.count(txHash);
+}
 
-                //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash)) {
-                    //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
-                }
+bool CTransactionLockManager::GetLockRequest(const uint256& txHash, CTransaction& tx) const
+{
+    LOCK(cs);
+    std::map<uint256, CTransaction>::const_iterator it = mapTxLockReq.find(txHash);
+    if (it == mapTxLockReq.end())
+        return false;
+    tx = it->second;
+    return true;
+}
+
+void CTransactionLockManager::AddLockRequest(const CTransaction& tx)
+{
+    LOCK(cs);
+    mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+}
+
+bool CTransactionLockManager::AddRejectedLockRequest(const CTransaction& tx)
+{
+    LOCK(cs);
+    mapTxLockReqRejected.insert(make_pair(tx.GetHash(), tx));
+
+    BOOST_FOREACH (const CTxIn& in, tx.vin) {
+        if (!mapLockedInputs.count(in.prevout)) {
+            mapLockedInputs.insert(make_pair(in.prevout, tx.GetHash()));
+        }
+    }
+
+    // resolve conflicts
+    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
+    if (i != mapTxLocks.end()) {
+        //we only care if we have a complete tx lock
+        if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
+            if (!CheckForConflictingLocks(tx)) {
+                mapTxLockReq.insert(make_pair(tx.GetHash(), tx));
+                return true;
             }
         }
+    }
+
+    return false;
+}
+
+bool CTransactionLockManager::HasVote(const uint256& hash) const
+{
+    LOCK(cs);
+    return mapTxLockVote.count(hash);
+}
+
+bool CTransactionLockManager::GetVote(const uint256& hash, CConsensusVote& ctx) const
+{
+    LOCK(cs);
+    std::map<uint256, CConsensusVote>::const_iterator it = mapTxLockVote.find(hash);
+    if (it == mapTxLockVote.end())
+        return false;
+    ctx = it->second;
+    return true;
+}
+
+bool CTransactionLockManager::AddVote(const CConsensusVote& ctx)
+{
+    LOCK(cs);
+    return mapTxLockVote.insert(make_pair(ctx.GetHash(), ctx)).second;
+}
+
+bool CTransactionLockManager::CheckUnknownVote(const CConsensusVote& ctx)
+{
+    LOCK(cs);
+    if (mapTxLockReq.count(ctx.txHash) || mapTxLockReqRejected.count(ctx.txHash))
         return true;
+
+    const uint256& hashMasternode = ctx.vinMasternode.prevout.hash;
+    if (!mapUnknownVotes.count(hashMasternode)) {
+        mapUnknownVotes[hashMasternode] = GetTime() + (60 * 10);
     }
 
+    if (mapUnknownVotes[hashMasternode] > GetTime() &&
+        mapUnknownVotes[hashMasternode] - GetAverageVoteTime() > 60 * 10) {
+        return false;
+    }
 
-    return false;
+    mapUnknownVotes[hashMasternode] = GetTime() + (60 * 10);
+    return true;
 }
 
-bool CheckForConflictingLocks(CTransaction& tx)
+CTransactionLock& CTransactionLockManager::GetOrCreateLock(const uint256& txHash)
+{
+    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(txHash);
+    if (i != mapTxLocks.end())
+        return i->second;
+
+    CTransactionLock& newLock = mapTxLocks[txHash];
+    newLock.nBlockHeight = 0;
+    newLock.nExpiration = GetTime() + (60 * 60); //locks expire after 60 minutes (24 confirmations)
+    newLock.nTimeout = GetTime() + (60 * 5);
+    newLock.txHash = txHash;
+    newLock.nTimeCreated = GetTimeMillis();
+    return newLock;
+}
+
+void CTransactionLockManager::SetLockHeight(const uint256& txHash, int nBlockHeight)
+{
+    LOCK(cs);
+    if (!mapTxLocks.count(txHash))
+        LogPrintf("CreateNewLock - New Transaction Lock %s !\n", txHash.ToString().c_str());
+    else
+        LogPrint("swifttx", "CreateNewLock - Transaction Lock Exists %s !\n", txHash.ToString().c_str());
+
+    GetOrCreateLock(txHash).nBlockHeight = nBlockHeight;
+}
+
+void CTransactionLockManager::ProcessVote(const CConsensusVote& ctx, bool& fComplete, bool& fReprocess)
+{
+    fComplete = false;
+    fReprocess = false;
+
+    // the listeners of NotifyTransactionLock take their own locks, so they are told after cs is released
+    bool fNotify = false;
+    CTransaction txLocked;
+    {
+        LOCK(cs);
+
+        if (!mapTxLocks.count(ctx.txHash))
+            LogPrintf("SwiftTX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
+        else
+            LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
+
+        CTransactionLock& lock = GetOrCreateLock(ctx.txHash);
+        lock.AddSignature(ctx);
+
+        int nSignatures = lock.CountSignatures();
+        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", nSignatures, ctx.GetHash().ToString().c_str());
+        if (nSignatures < SWIFTTX_SIGNATURES_REQUIRED)
+            return;
+
+        LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", lock.txHash.ToString().c_str());
+
+        std::map<uint256, CTransaction>::iterator itReq = mapTxLockReq.find(ctx.txHash);
+        if (itReq != mapTxLockReq.end()) {
+            if (CheckForConflictingLocks(itReq->second))
+                return;
+            BOOST_FOREACH (const CTxIn& in, itReq->second.vin) {
+                if (!mapLockedInputs.count(in.prevout)) {
+                    mapLockedInputs.insert(make_pair(in.prevout, ctx.txHash));
+                }
+            }
+        }
+
+        fComplete = true;
+        fReprocess = mapTxLockReqRejected.count(ctx.txHash);
+
+        if (!lock.fComplete) {
+            lock.fComplete = true;
+            nLockTimeLast = GetTimeMillis() - lock.nTimeCreated;
+            nLockTimeTotal += nLockTimeLast;
+            nLockTimeMax = std::max(nLockTimeMax, nLockTimeLast);
+            nLocksCompleted++;
+            LogPrint("swifttx", "SwiftTX::ProcessConsensusVote - Transaction %s locked in %dms\n", ctx.txHash.ToString().c_str(), nLockTimeLast);
+            if (itReq != mapTxLockReq.end()) {
+                fNotify = true;
+                txLocked = itReq->second;
+            }
+        }
+    }
+
+    if (fNotify)
+        GetMainSignals().NotifyTransactionLock(txLocked);
+}
+
+bool CTransactionLockManager::CheckForConflictingLocks(const CTransaction& tx)
 {
     /*
         It's possible (very unlikely though) to get 2 conflicting transaction locks approved by the network.
@@ -389,20 +489,61 @@ bool CheckForConflictingLocks(CTransaction& tx)
         rescan the blocks and find they're acceptable and then take the chain with the most work.
     */
     BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                LogPrintf("SwiftTX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if (mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
-                if (mapTxLocks.count(mapLockedInputs[in.prevout])) mapTxLocks[mapLockedInputs[in.prevout]].nExpiration = GetTime();
-                return true;
-            }
+        std::map<COutPoint, uint256>::iterator it = mapLockedInputs.find(in.prevout);
+        if (it != mapLockedInputs.end() && it->second != tx.GetHash()) {
+            LogPrintf("SwiftTX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), it->second.ToString().c_str());
+            if (mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
+            if (mapTxLocks.count(it->second)) mapTxLocks[it->second].nExpiration = GetTime();
+            return true;
         }
     }
 
     return false;
 }
 
-int64_t GetAverageVoteTime()
+int CTransactionLockManager::CountSignatures(const uint256& txHash) const
+{
+    LOCK(cs);
+    std::map<uint256, CTransactionLock>::const_iterator i = mapTxLocks.find(txHash);
+    if (i == mapTxLocks.end())
+        return -1;
+    return i->second.CountSignatures();
+}
+
+bool CTransactionLockManager::IsLockTimedOut(const uint256& txHash) const
+{
+    LOCK(cs);
+    std::map<uint256, CTransactionLock>::const_iterator i = mapTxLocks.find(txHash);
+    if (i == mapTxLocks.end())
+        return false;
+    return GetTime() > i->second.nTimeout;
+}
+
+bool CTransactionLockManager::HasConflictingLock(const CTransaction& tx, uint256& hashLock) const
+{
+    LOCK(cs);
+    if (mapLockedInputs.empty())
+        return false;
+
+    BOOST_FOREACH (const CTxIn& in, tx.vin) {
+        std::map<COutPoint, uint256>::const_iterator it = mapLockedInputs.find(in.prevout);
+        if (it != mapLockedInputs.end() && it->second != tx.GetHash()) {
+            hashLock = it->second;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int CTransactionLockManager::GetMasternodeRank(const CTxIn& vin, int nBlockHeight)
+{
+    // the ranking of a height is shared by the burst of votes for it
+    int n = mnodeman.GetMasternodeRank(vin, nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    return n > SWIFTTX_SIGNATURES_TOTAL ? -1 : n;
+}
+
+int64_t CTransactionLockManager::GetAverageVoteTime()
 {
     std::map<uint256, int64_t>::iterator it = mapUnknownVotes.begin();
     int64_t total = 0;
@@ -414,31 +555,31 @@ int64_t GetAverageVoteTime()
         it++;
     }
 
-    return total / count;
+    return count ? total / count : 0;
 }
 
-void CleanTransactionLocksList()
+void CTransactionLockManager::Clean()
 {
     if (chainActive.Tip() == NULL) return;
 
+    LOCK(cs);
     std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
 
     while (it != mapTxLocks.end()) {
         if (GetTime() > it->second.nExpiration) { //keep them for an hour
             LogPrintf("Removing old transaction lock %s\n", it->second.txHash.ToString().c_str());
 
-            if (mapTxLockReq.count(it->second.txHash)) {
-                CTransaction& tx = mapTxLockReq[it->second.txHash];
-
-                BOOST_FOREACH (const CTxIn& in, tx.vin)
+            std::map<uint256, CTransaction>::iterator itReq = mapTxLockReq.find(it->second.txHash);
+            if (itReq != mapTxLockReq.end()) {
+                BOOST_FOREACH (const CTxIn& in, itReq->second.vin)
                     mapLockedInputs.erase(in.prevout);
 
-                mapTxLockReq.erase(it->second.txHash);
-                mapTxLockReqRejected.erase(it->second.txHash);
-
-                BOOST_FOREACH (CConsensusVote& v, it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
+                mapTxLockReq.erase(itReq);
             }
+            mapTxLockReqRejected.erase(it->second.txHash);
+
+            BOOST_FOREACH (CConsensusVote& v, it->second.vecConsensusVotes)
+                mapTxLockVote.erase(v.GetHash());
 
             mapTxLocks.erase(it++);
         } else {
@@ -447,16 +588,35 @@ void CleanTransactionLocksList()
     }
 }
 
+void CTransactionLockManager::GetStats(CTransactionLockStats& stats) const
+{
+    LOCK(cs);
+    stats.nLockRequests = mapTxLockReq.size();
+    stats.nRejectedLockRequests = mapTxLockReqRejected.size();
+    stats.nVotes = mapTxLockVote.size();
+    stats.nLocks = mapTxLocks.size();
+    stats.nLockedInputs = mapLockedInputs.size();
+    stats.nLocksCompleted = nLocksCompleted;
+    stats.nLockTimeTotal = nLockTimeTotal;
+    stats.nLockTimeMax = nLockTimeMax;
+    stats.nLockTimeLast = nLockTimeLast;
+}
+
 uint256 CConsensusVote::GetHash() const
 {
     return vinMasternode.prevout.hash + vinMasternode.prevout.n + txHash;
 }
 
 
+std::string CConsensusVote::GetSignatureMessage() const
+{
+    return txHash.ToString() + boost::lexical_cast<std::string>(nBlockHeight);
+}
+
 bool CConsensusVote::SignatureValid()
 {
     std::string errorMessage;
-    std::string strMessage = txHash.ToString().c_str() + boost::lexical_cast<std::string>(nBlockHeight);
+    std::string strMessage = GetSignatureMessage();
     //LogPrintf("verify strMessage %s \n", strMessage.c_str());
 
     CMasternode* pmn = mnodeman.Find(vinMasternode);
@@ -480,7 +640,7 @@ bool CConsensusVote::Sign()
 
     CKey key2;
     CPubKey pubkey2;
-    std::string strMessage = txHash.ToString().c_str() + boost::lexical_cast<std::string>(nBlockHeight);
+    std::string strMessage = GetSignatureMessage();
     //LogPrintf("signing strMessage %s \n", strMessage.c_str());
     //LogPrintf("signing privkey %s \n", strMasterNodePrivKey.c_str());
 
@@ -506,15 +666,10 @@ bool CConsensusVote::Sign()
 bool CTransactionLock::SignaturesValid()
 {
     BOOST_FOREACH (CConsensusVote vote, vecConsensusVotes) {
-        int n = mnodeman.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+        int n = txLockManager.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight);
 
         if (n == -1) {
-            LogPrintf("CTransactionLock::SignaturesValid() - Unknown Masternode\n");
-            return false;
-        }
-
-        if (n > SWIFTTX_SIGNATURES_TOTAL) {
-            LogPrintf("CTransactionLock::SignaturesValid() - Masternode not in the top %s\n", SWIFTTX_SIGNATURES_TOTAL);
+            LogPrintf("CTransactionLock::SignaturesValid() - Masternode not in the top %d\n", SWIFTTX_SIGNATURES_TOTAL);
             return false;
         }
 
@@ -527,12 +682,12 @@ bool CTransactionLock::SignaturesValid()
     return true;
 }
 
-void CTransactionLock::AddSignature(CConsensusVote& cv)
+void CTransactionLock::AddSignature(const CConsensusVote& cv)
 {
     vecConsensusVotes.push_back(cv);
 }
 
-int CTransactionLock::CountSignatures()
+int CTransactionLock::CountSignatures() const
 {
     /*
         Only count signatures where the BlockHeight matches the transaction's blockheight.
@@ -542,7 +697,7 @@ int CTransactionLock::CountSignatures()
     if (nBlockHeight == 0) return -1;
 
     int n = 0;
-    BOOST_FOREACH (CConsensusVote v, vecConsensusVotes) {
+    BOOST_FOREACH (const CConsensusVote& v, vecConsensusVotes) {
         if (v.nBlockHeight == nBlockHeight) {
             n++;
         }
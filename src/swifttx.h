@@ -36,11 +36,6 @@ class CTransactionLock;
 
 static const int MIN_SWIFTTX_PROTO_VERSION = 70103;
 
-extern map<uint256, CTransaction> mapTxLockReq;
-extern map<uint256, CTransaction> mapTxLockReqRejected;
-extern map<uint256, CConsensusVote> mapTxLockVote;
-extern map<uint256, CTransactionLock> mapTxLocks;
-extern std::map<COutPoint, uint256> mapLockedInputs;
 extern int nCompleteTXLocks;
 
 
@@ -48,9 +43,6 @@ int64_t CreateNewLock(CTransaction tx);
 
 bool IsIXTXValid(const CTransaction& txCollateral);
 
-// if two conflicting locks are approved by the network, they will cancel out
-bool CheckForConflictingLocks(CTransaction& tx);
-
 void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
 //check if we need to vote on this transaction
@@ -59,11 +51,6 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight);
 //process consensus vote message
 bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx);
 
-// keep transaction locks in memory for an hour
-void CleanTransactionLocksList();
-
-int64_t GetAverageVoteTime();
-
 class CConsensusVote
 {
 public:
@@ -76,6 +63,7 @@ public:
 
     bool SignatureValid();
     bool Sign();
+    std::string GetSignatureMessage() const;
 
     ADD_SERIALIZE_METHODS;
 
@@ -99,8 +87,14 @@ public:
     int nTimeout;
 
     bool SignaturesValid();
-    int CountSignatures();
-    void AddSignature(CConsensusVote& cv);
+    int CountSignatures() const;
+    void AddSignature(const CConsensusVote& cv);
+
+    //! when the lock was first seen and whether it completed since (GetTimeMillis)
+    int64_t nTimeCreated;
+    bool fComplete;
+
+    CTransactionLock() : nBlockHeight(0), nExpiration(0), nTimeout(0), nTimeCreated(0), fComplete(false) {}
 
     uint256 GetHash()
     {
@@ -108,5 +102,89 @@ public:
     }
 };
 
+/** Counters of the lock manager, for getswifttxinfo */
+struct CTransactionLockStats {
+    size_t nLockRequests;
+    size_t nRejectedLockRequests;
+    size_t nVotes;
+    size_t nLocks;
+    size_t nLockedInputs;
+    int64_t nLocksCompleted;
+    int64_t nLockTimeTotal;
+    int64_t nLockTimeMax;
+    int64_t nLockTimeLast;
+};
+
+/**
+ * SwiftTX state: the lock requests, the votes, the locks they compile into and
+ * the inputs of complete locks, guarded by a lock of its own instead of
+ * cs_main. The lock is never held while calling into the wallet, the
+ * masternode manager or block processing, so it can be taken from under any
+ * of their locks.
+ */
+class CTransactionLockManager
+{
+private:
+    mutable CCriticalSection cs;
+
+    std::map<uint256, CTransaction> mapTxLockReq;
+    std::map<uint256, CTransaction> mapTxLockReqRejected;
+    std::map<uint256, CConsensusVote> mapTxLockVote;
+    std::map<uint256, CTransactionLock> mapTxLocks;
+    //! input -> transaction lock spending it
+    std::map<COutPoint, uint256> mapLockedInputs;
+    //! track votes with no tx for DOS
+    std::map<uint256, int64_t> mapUnknownVotes;
+    int64_t nLocksCompleted;
+    int64_t nLockTimeTotal;
+    int64_t nLockTimeMax;
+    int64_t nLockTimeLast;
+
+    CTransactionLock& GetOrCreateLock(const uint256& txHash);
+    // if two conflicting locks are approved by the network, they will cancel out
+    bool CheckForConflictingLocks(const CTransaction& tx);
+    int64_t GetAverageVoteTime();
+
+public:
+    CTransactionLockManager();
+
+    bool HasLockRequest(const uint256& txHash) const;
+    bool GetLockRequest(const uint256& txHash, CTransaction& tx) const;
+    void AddLockRequest(const CTransaction& tx);
+    /// Record a request that failed to enter the mempool; returns true when it completes a lock and blocks need reprocessing
+    bool AddRejectedLockRequest(const CTransaction& tx);
+
+    bool HasVote(const uint256& hash) const;
+    bool GetVote(const uint256& hash, CConsensusVote& ctx) const;
+    /// Returns false if the vote is known already
+    bool AddVote(const CConsensusVote& ctx);
+    /// Rate limit votes for transactions we don't know; returns false if the masternode is spamming them
+    bool CheckUnknownVote(const CConsensusVote& ctx);
+
+    /// Create the lock of a transaction or move it to nBlockHeight
+    void SetLockHeight(const uint256& txHash, int nBlockHeight);
+    /**
+     * Count a valid vote into its lock. fComplete is set when the lock has
+     * enough signatures and no conflict, fReprocess when it locks a transaction
+     * we rejected and the recent blocks need to be checked again.
+     */
+    void ProcessVote(const CConsensusVote& ctx, bool& fComplete, bool& fReprocess);
+
+    /// Signatures of the lock of a transaction, -1 if there is none
+    int CountSignatures(const uint256& txHash) const;
+    bool IsLockTimedOut(const uint256& txHash) const;
+    /// Whether an input of tx is locked by another transaction, which is returned in hashLock
+    bool HasConflictingLock(const CTransaction& tx, uint256& hashLock) const;
+
+    /// Rank of a masternode among the top SWIFTTX_SIGNATURES_TOTAL at a height, -1 if it is not one of them
+    static int GetMasternodeRank(const CTxIn& vin, int nBlockHeight);
+
+    // keep transaction locks in memory for an hour
+    void Clean();
+    void GetStats(CTransactionLockStats& stats) const;
+};
+
+extern CTransactionLockManager txLockManager;
+
 
 #endif
@@ -0,0 +1,190 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+#include "main.h"
+#include "random.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "version.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockencodings_tests)
+
+static CBlock BuildBlockTestCase(bool fProofOfStake)
+{
+    CBlock block;
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_11;
+    coinbase.vout.resize(1);
+    if (fProofOfStake)
+        coinbase.vout[0].SetEmpty();
+    else {
+        coinbase.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        coinbase.vout[0].nValue = 42;
+    }
+    block.vtx.push_back(coinbase);
+
+    if (fProofOfStake) {
+        CMutableTransaction coinstake;
+        coinstake.vin.resize(1);
+        coinstake.vin[0].prevout.hash = GetRandHash();
+        coinstake.vin[0].prevout.n = 0;
+        coinstake.vout.resize(2);
+        coinstake.vout[0].SetEmpty();
+        coinstake.vout[1].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        coinstake.vout[1].nValue = 42;
+        block.vtx.push_back(coinstake);
+        block.vchBlockSig.assign(72, 0x42);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_11;
+        tx.vin[0].prevout.hash = GetRandHash();
+        tx.vin[0].prevout.n = 0;
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx.vout[0].nValue = 11000LL * (i + 1);
+        block.vtx.push_back(tx);
+    }
+
+    block.nVersion = 42;
+    block.hashPrevBlock = GetRandHash();
+    block.nBits = 0x207fffff;
+    block.nTime = 1500000000;
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+static CBlockHeaderAndShortTxIDs RoundTrip(const CBlockHeaderAndShortTxIDs& cmpctblock)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << cmpctblock;
+    CBlockHeaderAndShortTxIDs result;
+    stream >> result;
+    return result;
+}
+
+BOOST_AUTO_TEST_CASE(SimpleRoundTripTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlockTestCase(true));
+    BOOST_CHECK(block.IsProofOfStake());
+
+    // Everything but the coinbase and coinstake is in the mempool
+    for (size_t i = 2; i < block.vtx.size(); i++)
+        pool.addUnchecked(block.vtx[i].GetHash(), CTxMemPoolEntry(block.vtx[i], 0, 0, 0.0, 1));
+
+    CBlockHeaderAndShortTxIDs cmpctblock = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+    BOOST_CHECK_EQUAL(cmpctblock.BlockTxCount(), block.vtx.size());
+    BOOST_CHECK_EQUAL(cmpctblock.PrefilledTxCount(), 2U);
+
+    // The header and coinstake can be checked before the mempool is searched
+    CBlock blockHead;
+    cmpctblock.GetBlockHead(blockHead);
+    BOOST_CHECK_EQUAL(blockHead.GetHash().ToString(), block.GetHash().ToString());
+    BOOST_CHECK_EQUAL(blockHead.vtx.size(), 2U);
+    BOOST_CHECK(blockHead.IsProofOfStake());
+    BOOST_CHECK(blockHead.vchBlockSig == block.vchBlockSig);
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(cmpctblock) == READ_STATUS_OK);
+    for (size_t i = 0; i < block.vtx.size(); i++)
+        BOOST_CHECK(partialBlock.IsTxAvailable(i));
+    BOOST_CHECK_EQUAL(partialBlock.GetMempoolCount(), 3U);
+
+    CBlock block2;
+    std::vector<CTransaction> vtx_missing;
+    BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+    BOOST_CHECK_EQUAL(block.hashMerkleRoot.ToString(), block2.BuildMerkleTree().ToString());
+    BOOST_CHECK(block2.IsProofOfStake());
+    BOOST_CHECK(block.vchBlockSig == block2.vchBlockSig);
+
+    // The compact form is much smaller than the block itself
+    size_t nFullSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    size_t nCompactSize = ::GetSerializeSize(cmpctblock, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(nCompactSize < nFullSize);
+}
+
+BOOST_AUTO_TEST_CASE(MissingTransactionsTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block(BuildBlockTestCase(false));
+    BOOST_CHECK(block.IsProofOfWork());
+
+    // Only the last transaction made it into our mempool
+    pool.addUnchecked(block.vtx[3].GetHash(), CTxMemPoolEntry(block.vtx[3], 0, 0, 0.0, 1));
+
+    CBlockHeaderAndShortTxIDs cmpctblock = RoundTrip(CBlockHeaderAndShortTxIDs(block));
+    BOOST_CHECK_EQUAL(cmpctblock.PrefilledTxCount(), 1U);
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(cmpctblock) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(2));
+    BOOST_CHECK(partialBlock.IsTxAvailable(3));
+
+    // The getblocktxn/blocktxn round trip
+    BlockTransactionsRequest req;
+    req.blockhash = block.GetHash();
+    req.indexes.push_back(1);
+    req.indexes.push_back(2);
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << req;
+    BlockTransactionsRequest req2;
+    stream >> req2;
+    BOOST_CHECK(req2.blockhash == req.blockhash);
+    BOOST_CHECK(req2.indexes == req.indexes);
+
+    BlockTransactions resp(req2);
+    for (size_t i = 0; i < req2.indexes.size(); i++)
+        resp.txn[i] = block.vtx[req2.indexes[i]];
+
+    CBlock block2;
+    std::vector<CTransaction> vtx_missing;
+    // Too few transactions is the peer's fault
+    BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_INVALID);
+
+    // Wrong transactions give a block with the wrong merkle root
+    vtx_missing.push_back(block.vtx[2]);
+    vtx_missing.push_back(block.vtx[1]);
+    BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_FAILED);
+
+    BOOST_CHECK(partialBlock.FillBlock(block2, resp.txn) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+    BOOST_CHECK_EQUAL(block.hashMerkleRoot.ToString(), block2.BuildMerkleTree().ToString());
+}
+
+BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest)
+{
+    BlockTransactionsRequest req1;
+    req1.blockhash = GetRandHash();
+    req1.indexes.resize(4);
+    req1.indexes[0] = 0;
+    req1.indexes[1] = 1;
+    req1.indexes[2] = 3;
+    req1.indexes[3] = 4;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << req1;
+
+    BlockTransactionsRequest req2;
+    stream >> req2;
+
+    BOOST_CHECK_EQUAL(req1.blockhash.ToString(), req2.blockhash.ToString());
+    BOOST_CHECK_EQUAL(req1.indexes.size(), req2.indexes.size());
+    BOOST_CHECK_EQUAL(req1.indexes[0], req2.indexes[0]);
+    BOOST_CHECK_EQUAL(req1.indexes[1], req2.indexes[1]);
+    BOOST_CHECK_EQUAL(req1.indexes[2], req2.indexes[2]);
+    BOOST_CHECK_EQUAL(req1.indexes[3], req2.indexes[3]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,177 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-budget.h"
+#include "random.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(budget_tests)
+
+BOOST_AUTO_TEST_CASE(budget_proposal_tally)
+{
+    CBudgetProposal proposal("test", "http://test", 0, 100, CScript(), 10 * COIN, GetRandHash());
+    std::vector<CTxIn> vVins;
+    for (int i = 0; i < 10; i++)
+        vVins.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+
+    std::string strError;
+    uint256 nHash = proposal.GetHash();
+    for (int i = 0; i < 10; i++) {
+        CBudgetVote vote(vVins[i], nHash, i < 6 ? VOTE_YES : (i < 9 ? VOTE_NO : VOTE_ABSTAIN));
+        vote.nTime -= BUDGET_VOTE_UPDATE_MIN + 1;
+        BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+    }
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 6);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 3);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 1);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 6.0 / 9.0, 0.0001);
+
+    // A masternode changing its vote moves it between the counts
+    CBudgetVote vote(vVins[0], nHash, VOTE_NO);
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 5);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 4);
+
+    // Copies and a recount agree with the incremental tally
+    CBudgetProposal copy(proposal);
+    BOOST_CHECK_EQUAL(copy.GetYeas(), 5);
+    copy.RecountVotes();
+    BOOST_CHECK_EQUAL(copy.GetYeas(), 5);
+    BOOST_CHECK_EQUAL(copy.GetNays(), 4);
+    BOOST_CHECK_EQUAL(copy.GetAbstains(), 1);
+
+    // None of the voters is a known masternode: every vote stops counting,
+    // except towards the ratio
+    proposal.CleanAndRemove(false);
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 0);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 5.0 / 9.0, 0.0001);
+}
+
+BOOST_AUTO_TEST_CASE(budget_proposal_vote_digest)
+{
+    CBudgetProposal proposal("test", "http://test", 0, 100, CScript(), 10 * COIN, GetRandHash());
+    CBudgetProposal other(proposal);
+    BOOST_CHECK(proposal.GetVoteDigest() == 0);
+
+    std::string strError;
+    uint256 nHash = proposal.GetHash();
+    std::vector<CBudgetVote> vVotes;
+    uint256 nExpected = 0;
+    for (int i = 0; i < 5; i++) {
+        CBudgetVote vote(CTxIn(COutPoint(GetRandHash(), 0)), nHash, VOTE_YES);
+        vote.nTime -= BUDGET_VOTE_UPDATE_MIN + 1;
+        BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+        vVotes.push_back(vote);
+        nExpected ^= vote.GetHash();
+    }
+    BOOST_CHECK(proposal.GetVoteDigest() == nExpected);
+
+    // The digest doesn't depend on the order the votes came in
+    for (int i = 4; i >= 0; i--)
+        BOOST_CHECK(other.AddOrUpdateVote(vVotes[i], strError));
+    BOOST_CHECK(other.GetVoteDigest() == nExpected);
+
+    // A changed vote changes the digest
+    CBudgetVote vote(vVotes[0].vin, nHash, VOTE_NO);
+    BOOST_CHECK(other.AddOrUpdateVote(vote, strError));
+    BOOST_CHECK(other.GetVoteDigest() == (nExpected ^ vVotes[0].GetHash() ^ vote.GetHash()));
+
+    // Only valid votes count: none of the voters is a known masternode
+    proposal.CleanAndRemove(false);
+    BOOST_CHECK(proposal.GetVoteDigest() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(budget_proposal_rank_order)
+{
+    CProposalRank first, second;
+    first.nNetYeas = 5;
+    first.nFeeTXHash = 1;
+    first.nProposalHash = 2;
+    second = first;
+    second.nNetYeas = 3;
+    second.nFeeTXHash = 2;
+
+    // Most net yes votes first
+    BOOST_CHECK(first < second);
+    BOOST_CHECK(!(second < first));
+
+    // then the higher fee transaction hash
+    second.nNetYeas = 5;
+    BOOST_CHECK(second < first);
+    BOOST_CHECK(!(first < second));
+
+    // and the proposal hash, so two proposals never compare equal
+    second.nFeeTXHash = 1;
+    second.nProposalHash = 1;
+    BOOST_CHECK(second < first);
+    second.nProposalHash = 2;
+    BOOST_CHECK(!(second < first) && !(first < second));
+}
+
+BOOST_AUTO_TEST_CASE(budget_proposal_rerank)
+{
+    budget.Clear();
+
+    // proposal i gets i + 1 yes votes
+    std::vector<uint256> vHashes;
+    std::vector<std::vector<CTxIn> > vVoters(3);
+    std::string strError;
+    for (int i = 0; i < 3; i++) {
+        CBudgetProposal proposal("test" + boost::lexical_cast<std::string>(i), "http://test", 0, 100, CScript(), 10 * COIN, 3 - i);
+        uint256 nHash = proposal.GetHash();
+        budget.mapProposals.insert(make_pair(nHash, proposal));
+        vHashes.push_back(nHash);
+        for (int j = 0; j <= i; j++) {
+            vVoters[i].push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+            CBudgetVote vote(vVoters[i][j], nHash, VOTE_YES);
+            vote.nTime -= BUDGET_VOTE_UPDATE_MIN + 1;
+            BOOST_CHECK(budget.UpdateProposal(vote, NULL, strError));
+        }
+    }
+
+    std::vector<CBudgetProposal*> vRanked = budget.GetRankedProposals();
+    BOOST_CHECK_EQUAL(vRanked.size(), 3U);
+    for (int i = 0; i < 3; i++)
+        BOOST_CHECK(vRanked[i]->GetHash() == vHashes[2 - i]);
+
+    // Two votes of the leading proposal turning against it move it to the end
+    for (int j = 1; j < 3; j++) {
+        CBudgetVote vote(vVoters[2][j], vHashes[2], VOTE_NO);
+        BOOST_CHECK(budget.UpdateProposal(vote, NULL, strError));
+    }
+    vRanked = budget.GetRankedProposals();
+    BOOST_CHECK(vRanked[0]->GetHash() == vHashes[1]);
+    BOOST_CHECK(vRanked[1]->GetHash() == vHashes[0]);
+    BOOST_CHECK(vRanked[2]->GetHash() == vHashes[2]);
+
+    // None of the voters is a known masternode, but only the vote of one reported
+    // to have left the list stops counting: the tie goes to the higher fee hash
+    budget.MasternodeChanged(vVoters[1][0]);
+    vRanked = budget.GetRankedProposals();
+    BOOST_CHECK_EQUAL(budget.mapProposals[vHashes[1]].GetYeas(), 1);
+    BOOST_CHECK_EQUAL(budget.mapProposals[vHashes[2]].GetYeas(), 1);
+    BOOST_CHECK(vRanked[0]->GetHash() == vHashes[0]);
+    BOOST_CHECK(vRanked[1]->GetHash() == vHashes[1]);
+    BOOST_CHECK(vRanked[2]->GetHash() == vHashes[2]);
+
+    // Replacing the whole list rechecks every vote
+    budget.MasternodeListReset();
+    vRanked = budget.GetRankedProposals();
+    for (int i = 0; i < 3; i++) {
+        BOOST_CHECK_EQUAL(budget.mapProposals[vHashes[i]].GetYeas(), 0);
+        BOOST_CHECK_EQUAL(budget.mapProposals[vHashes[i]].GetNays(), 0);
+    }
+
+    budget.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "hash.h"
 #include "random.h"
 #include "utilstrencodings.h"
 
@@ -282,4 +283,27 @@ BOOST_AUTO_TEST_CASE(rfc6979_hmac_sha256)
             ("7597887cbd76321f32e30440679a22cf7f8d9d2eac390e581fea091ce202ba94"));
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    // The test setup has already switched to the fastest implementations;
+    // detecting again re-runs their self tests
+    std::string strImpl = SHA256AutoDetect();
+    BOOST_TEST_MESSAGE("SHA256 implementation: " << strImpl);
+
+    // Batch sizes around the 4 and 8 lane widths, compared with Hash()
+    for (int i = 0; i <= 32; i++) {
+        std::vector<unsigned char> in(64 * i), out(32 * i + 32, 0xff), expected(32 * i);
+        for (size_t j = 0; j < in.size(); j++)
+            in[j] = insecure_rand();
+        for (int j = 0; j < i; j++) {
+            uint256 hash = Hash(in.begin() + 64 * j, in.begin() + 64 * j + 64);
+            memcpy(&expected[32 * j], hash.begin(), 32);
+        }
+        SHA256D64(out.empty() ? NULL : &out[0], in.empty() ? NULL : &in[0], i);
+        BOOST_CHECK(std::equal(expected.begin(), expected.end(), out.begin()));
+        // Nothing past the last output is written
+        BOOST_CHECK_EQUAL(out[32 * i], 0xff);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,65 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "expiryindex.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(expiryindex_tests)
+
+BOOST_AUTO_TEST_CASE(expiryindex_buckets)
+{
+    CExpiryIndex<int> index(10);
+    for (int i = 0; i < 100; i++)
+        index.Add(i, i);
+    BOOST_CHECK_EQUAL(index.size(), 100U);
+
+    // Only whole buckets before the time are due
+    std::vector<int> vKeys;
+    index.Expire(25, vKeys);
+    BOOST_CHECK_EQUAL(vKeys.size(), 20U);
+    std::sort(vKeys.begin(), vKeys.end());
+    for (int i = 0; i < 20; i++)
+        BOOST_CHECK_EQUAL(vKeys[i], i);
+    BOOST_CHECK_EQUAL(index.size(), 80U);
+
+    // Nothing new is due until the next bucket has passed
+    vKeys.clear();
+    index.Expire(29, vKeys);
+    BOOST_CHECK(vKeys.empty());
+    index.Expire(30, vKeys);
+    BOOST_CHECK_EQUAL(vKeys.size(), 10U);
+
+    vKeys.clear();
+    index.Expire(1000, vKeys);
+    BOOST_CHECK_EQUAL(vKeys.size(), 70U);
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(expiryindex_readd)
+{
+    // A key whose time moved on is handed out at its old time and indexed again
+    CExpiryIndex<int> index(10);
+    index.Add(1, 5);
+    index.Add(1, 55);
+
+    std::vector<int> vKeys;
+    index.Expire(20, vKeys);
+    BOOST_CHECK_EQUAL(vKeys.size(), 1U);
+    BOOST_CHECK_EQUAL(index.size(), 1U);
+
+    vKeys.clear();
+    index.Expire(60, vKeys);
+    BOOST_CHECK_EQUAL(vKeys.size(), 1U);
+
+    index.Add(2, 5);
+    index.Clear();
+    BOOST_CHECK_EQUAL(index.size(), 0U);
+    BOOST_CHECK_EQUAL(index.DynamicMemoryUsage(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
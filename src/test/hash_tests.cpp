@@ -3,6 +3,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "primitives/block.h"
+#include "random.h"
 #include "utilstrencodings.h"
 
 #include <vector>
@@ -46,4 +48,71 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(siphash)
+{
+    CSipHasher hasher(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(), 0x726fdb47dd0e0e31ull);
+    hasher.Write(0x0706050403020100ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(), 0x93f5f5799a932462ull);
+    hasher.Write(0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(), 0x3f2acc7f57c29bdbull);
+    hasher.Write(0x1716151413121110ULL).Write(0x1F1E1D1C1B1A1918ULL);
+
+    // The uint256 specialization must agree with hashing the same four words
+    uint256 x = uint256S("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100");
+    BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, x), hasher.Finalize());
+    BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, x), 0x7127512f72f27cceull);
+}
+
+static uint256 QuarkOf(const std::vector<unsigned char>& vch)
+{
+    return HashQuark(vch.begin(), vch.end());
+}
+
+BOOST_AUTO_TEST_CASE(quark)
+{
+    std::vector<unsigned char> vch;
+    BOOST_CHECK_EQUAL(QuarkOf(vch).ToString(), "9c7d513ab01c44694f7bc7c6a7e269a3eced7b2be24d8663835bf35a3bf10008");
+    vch.assign(80, 0);
+    BOOST_CHECK_EQUAL(QuarkOf(vch).ToString(), "02067fe51503a2f5ebb46b8a06f185fb8763a5d3d758eee11a3a0ea055823d63");
+    for (int i = 0; i < 80; i++)
+        vch[i] = i;
+    BOOST_CHECK_EQUAL(QuarkOf(vch).ToString(), "ce5ec7b3af68ac039b417096a3aaf87aab5ec285f9843291a2fff881907569ae");
+    vch = ParseHex("616263");
+    BOOST_CHECK_EQUAL(QuarkOf(vch).ToString(), "d0d94903e68ab020e3dec7c1a2d57c631e72cd2862a6be02deaad62d29644ba5");
+}
+
+BOOST_AUTO_TEST_CASE(quark_header_batch)
+{
+    // Enough headers to be split across threads, in uneven parts
+    seed_insecure_rand(true);
+    std::vector<CBlockHeader> vHeaders(1001);
+    for (size_t i = 0; i < vHeaders.size(); i++) {
+        vHeaders[i].nVersion = 1 + insecure_rand() % 4;
+        vHeaders[i].hashPrevBlock = insecure_rand();
+        vHeaders[i].hashMerkleRoot = insecure_rand();
+        vHeaders[i].nTime = insecure_rand();
+        vHeaders[i].nBits = insecure_rand();
+        vHeaders[i].nNonce = insecure_rand();
+    }
+
+    std::vector<uint256> vExpected;
+    for (size_t i = 0; i < vHeaders.size(); i++)
+        vExpected.push_back(vHeaders[i].GetHash());
+
+    std::vector<uint256> vHashes;
+    GetBlockHeaderHashes(vHeaders, vHashes);
+    BOOST_CHECK_EQUAL(vHashes.size(), vHeaders.size());
+    BOOST_CHECK(vHashes == vExpected);
+
+    // Small and empty batches are hashed on the calling thread
+    vHeaders.resize(3);
+    GetBlockHeaderHashes(vHeaders, vHashes);
+    BOOST_CHECK_EQUAL(vHashes.size(), 3U);
+    BOOST_CHECK(vHashes[2] == vExpected[2]);
+    vHeaders.clear();
+    GetBlockHeaderHashes(vHeaders, vHashes);
+    BOOST_CHECK(vHashes.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
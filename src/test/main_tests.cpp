@@ -7,6 +7,7 @@
 
 #include "primitives/transaction.h"
 #include "main.h"
+#include "masternode-budget.h"
 
 #include <boost/test/unit_test.hpp>
 
@@ -49,4 +50,27 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+BOOST_AUTO_TEST_CASE(block_file_pins_test)
+{
+    LOCK(cs_main);
+    const int nWindow = GetBudgetPaymentCycleBlocks() * BUDGET_COLLATERAL_PIN_CYCLES;
+
+    // File numbers no test chain reaches
+    BOOST_CHECK(!IsBlockFilePinned(1000, 100));
+
+    BOOST_CHECK(PinBlockFile(1000, 100));
+    BOOST_CHECK(IsBlockFilePinned(1000, 100));
+    BOOST_CHECK(IsBlockFilePinned(1000, 100 + nWindow - 1));
+    BOOST_CHECK(!IsBlockFilePinned(1000, 100 + nWindow));
+    BOOST_CHECK(!IsBlockFilePinned(1001, 100));
+
+    // Only newer collateral extends a pin
+    BOOST_CHECK(!PinBlockFile(1000, 50));
+    BOOST_CHECK(!PinBlockFile(1000, 100));
+    BOOST_CHECK(!IsBlockFilePinned(1000, 100 + nWindow));
+    BOOST_CHECK(PinBlockFile(1000, 200));
+    BOOST_CHECK(IsBlockFilePinned(1000, 100 + nWindow));
+    BOOST_CHECK(!IsBlockFilePinned(1000, 200 + nWindow));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
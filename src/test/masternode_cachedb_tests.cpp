@@ -0,0 +1,67 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-cachedb.h"
+#include "random.h"
+
+#include <map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternode_cachedb_tests)
+
+BOOST_AUTO_TEST_CASE(masternode_cachedb_incremental)
+{
+    std::map<uint256, int64_t> mapItems;
+    for (int i = 0; i < 100; i++)
+        mapItems[GetRandHash()] = i;
+
+    unsigned int nWritten, nErased;
+    {
+        CMasternodeCacheDB db("cachedb_test");
+        db.WriteRecords('x', mapItems);
+        BOOST_CHECK(db.Commit(nWritten, nErased));
+        BOOST_CHECK_EQUAL(nWritten, 100U);
+        BOOST_CHECK_EQUAL(nErased, 0U);
+
+        // Nothing changed, nothing written
+        db.WriteRecords('x', mapItems);
+        BOOST_CHECK(db.Commit(nWritten, nErased));
+        BOOST_CHECK_EQUAL(nWritten, 0U);
+        BOOST_CHECK_EQUAL(nErased, 0U);
+
+        // Only the changed and the removed items touch the disk
+        mapItems.begin()->second = 1000;
+        mapItems.erase(mapItems.rbegin()->first);
+        db.WriteRecords('x', mapItems);
+        BOOST_CHECK(db.Commit(nWritten, nErased));
+        BOOST_CHECK_EQUAL(nWritten, 1U);
+        BOOST_CHECK_EQUAL(nErased, 1U);
+    }
+
+    // Reopened, the database knows what is on disk already
+    CMasternodeCacheDB db("cachedb_test");
+    std::map<uint256, int64_t> mapRead;
+    BOOST_CHECK(db.ReadRecords('x', mapRead));
+    BOOST_CHECK(mapRead == mapItems);
+
+    std::map<uint256, int64_t> mapOther;
+    BOOST_CHECK(db.ReadRecords('y', mapOther));
+    BOOST_CHECK(mapOther.empty());
+
+    db.WriteRecords('x', mapItems);
+    BOOST_CHECK(db.Commit(nWritten, nErased));
+    BOOST_CHECK_EQUAL(nWritten, 0U);
+    BOOST_CHECK_EQUAL(nErased, 0U);
+
+    // Items not written again are erased
+    BOOST_CHECK(db.Commit(nWritten, nErased));
+    BOOST_CHECK_EQUAL(nWritten, 0U);
+    BOOST_CHECK_EQUAL(nErased, 99U);
+    mapRead.clear();
+    BOOST_CHECK(db.ReadRecords('x', mapRead));
+    BOOST_CHECK(mapRead.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
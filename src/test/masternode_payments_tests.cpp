@@ -0,0 +1,146 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-payments.h"
+#include "memusage.h"
+#include "streams.h"
+
+#include <map>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternode_payments_tests)
+
+static CScript PayeeScript(int n)
+{
+    return CScript() << OP_DUP << OP_HASH160 << n << OP_EQUALVERIFY << OP_CHECKSIG;
+}
+
+BOOST_AUTO_TEST_CASE(payees_window)
+{
+    CMasternodeBlockPayeesWindow window(4);
+    BOOST_CHECK_EQUAL(window.size(), 0U);
+    BOOST_CHECK(!window.Has(1));
+
+    window.Get(100)->AddPayee(PayeeScript(1), 1);
+    window.Get(100)->AddPayee(PayeeScript(2), 1);
+    window.Get(100)->AddPayee(PayeeScript(2), 1);
+    window.Get(103)->AddPayee(PayeeScript(3), 1);
+    BOOST_CHECK_EQUAL(window.size(), 2U);
+    BOOST_CHECK_EQUAL(window.GetOldest(), 100);
+    BOOST_CHECK_EQUAL(window.GetNewest(), 103);
+    BOOST_CHECK(!window.Has(101));
+    BOOST_CHECK(!window.Has(104));
+
+    CScript payee;
+    BOOST_CHECK(window.Find(100)->GetPayee(payee));
+    BOOST_CHECK(payee == PayeeScript(2));
+
+    // Heights beyond the size of the ring grow it and keep what it held
+    window.Get(150)->AddPayee(PayeeScript(4), 1);
+    window.Get(90)->AddPayee(PayeeScript(5), 1);
+    BOOST_CHECK_EQUAL(window.size(), 4U);
+    BOOST_CHECK(window.Find(100)->GetPayee(payee));
+    BOOST_CHECK(payee == PayeeScript(2));
+    BOOST_CHECK(window.Find(103)->GetPayee(payee));
+    BOOST_CHECK(payee == PayeeScript(3));
+    BOOST_CHECK_EQUAL(window.GetOldest(), 90);
+    BOOST_CHECK_EQUAL(window.GetNewest(), 150);
+
+    // Removing the ends moves them to the next heights held
+    window.Erase(150);
+    BOOST_CHECK_EQUAL(window.GetNewest(), 103);
+    window.EraseBelow(101);
+    BOOST_CHECK_EQUAL(window.size(), 1U);
+    BOOST_CHECK_EQUAL(window.GetOldest(), 103);
+    BOOST_CHECK(!window.Has(100));
+
+    // Serialized like the map of heights it replaced
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << window;
+    std::map<int, CMasternodeBlockPayees> mapBlocks;
+    ss >> mapBlocks;
+    BOOST_CHECK_EQUAL(mapBlocks.size(), 1U);
+    BOOST_CHECK_EQUAL(mapBlocks.begin()->first, 103);
+
+    ss << mapBlocks;
+    CMasternodeBlockPayeesWindow window2;
+    ss >> window2;
+    BOOST_CHECK_EQUAL(window2.size(), 1U);
+    BOOST_CHECK(window2.Find(103)->GetPayee(payee));
+    BOOST_CHECK(payee == PayeeScript(3));
+
+    window.EraseBelow(1000);
+    BOOST_CHECK_EQUAL(window.size(), 0U);
+    BOOST_CHECK_EQUAL(window.GetOldest(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(payees_window_replay)
+{
+    // Every block the top ten of a few masternodes vote for the payee ten
+    // blocks ahead and the window keeps the last 25 blocks: it must hold
+    // what the map of heights it replaced holds.
+    const int nMasternodes = 20;
+    const int nBlocks = 200;
+    const int nLimit = 25;
+
+    CMasternodeBlockPayeesWindow window(4);
+    std::map<int, CMasternodeBlockPayees> mapBlocks;
+    for (int nHeight = 1; nHeight <= nBlocks; nHeight++) {
+        for (int i = 0; i < MNPAYMENTS_SIGNATURES_TOTAL; i++) {
+            CScript payee = PayeeScript((nHeight + i % 2) % nMasternodes);
+            window.Get(nHeight + 10)->AddPayee(payee, 1);
+            if (!mapBlocks.count(nHeight + 10))
+                mapBlocks[nHeight + 10] = CMasternodeBlockPayees(nHeight + 10);
+            mapBlocks[nHeight + 10].AddPayee(payee, 1);
+        }
+        for (int h = nHeight; h <= nHeight + 10; h++) {
+            CScript payee, payee2;
+            CMasternodeBlockPayees* pblockPayees = window.Find(h);
+            BOOST_CHECK_EQUAL(pblockPayees != NULL, mapBlocks.count(h) > 0);
+            if (pblockPayees) {
+                BOOST_CHECK(pblockPayees->GetPayee(payee) && mapBlocks[h].GetPayee(payee2));
+                BOOST_CHECK(payee == payee2);
+            }
+        }
+        window.EraseBelow(nHeight - nLimit);
+        mapBlocks.erase(mapBlocks.begin(), mapBlocks.lower_bound(nHeight - nLimit));
+    }
+
+    BOOST_CHECK_EQUAL(window.size(), mapBlocks.size());
+    BOOST_CHECK_EQUAL(window.GetOldest(), mapBlocks.begin()->first);
+    BOOST_CHECK_EQUAL(window.GetNewest(), mapBlocks.rbegin()->first);
+}
+
+BOOST_AUTO_TEST_CASE(payees_window_bounds)
+{
+    // No payee is voted at or below the genesis block
+    CMasternodeBlockPayeesWindow window(4);
+    BOOST_CHECK(window.Get(0) == NULL);
+    BOOST_CHECK(window.Get(-100) == NULL);
+    BOOST_CHECK_EQUAL(window.size(), 0U);
+
+    CMasternodePayments payments;
+    CMasternodePaymentWinner winner;
+    winner.nBlockHeight = 0;
+    BOOST_CHECK(!payments.AddWinningMasternode(winner));
+    winner.nBlockHeight = -10;
+    BOOST_CHECK(!payments.AddWinningMasternode(winner));
+    BOOST_CHECK(payments.mapMasternodePayeeVotes.empty());
+    BOOST_CHECK_EQUAL(payments.masternodeBlocks.size(), 0U);
+
+    // A large span grows the ring, erasing it gives the slots back
+    size_t nUsage = window.DynamicMemoryUsage();
+    window.Get(1)->AddPayee(PayeeScript(1), 1);
+    window.Get(1000)->AddPayee(PayeeScript(2), 1);
+    BOOST_CHECK(window.DynamicMemoryUsage() > nUsage);
+    window.EraseBelow(1000);
+    BOOST_CHECK_EQUAL(window.size(), 1U);
+    BOOST_CHECK_EQUAL(window.DynamicMemoryUsage(), nUsage + memusage::DynamicUsage(window.Find(1000)->vecPayments));
+    window.Clear();
+    BOOST_CHECK_EQUAL(window.DynamicMemoryUsage(), nUsage);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,121 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodeman.h"
+#include "random.h"
+#include "timedata.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternodeman_tests)
+
+BOOST_AUTO_TEST_CASE(masternodeman_rank_invalidation)
+{
+    // rank against a block the test chain doesn't reach
+    const int nHeight = 1;
+    mapCacheBlockHashes[nHeight] = GetRandHash();
+
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(GetRandHash(), 0));
+    mn.unitTest = true;
+    mn.lastPing.vin = mn.vin;
+    mn.lastPing.sigTime = GetAdjustedTime();
+    BOOST_CHECK(mnodeman.Add(mn));
+    CMasternode* pmn = mnodeman.Find(mn.vin);
+    BOOST_CHECK(pmn != NULL);
+    BOOST_CHECK(mnodeman.GetMasternodeByRank(1, nHeight, 0, true) == pmn);
+
+    // Expiring drops the cached ranking of active masternodes
+    pmn->lastPing.sigTime = GetAdjustedTime() - MASTERNODE_EXPIRATION_SECONDS;
+    pmn->Check(true);
+    BOOST_CHECK(!pmn->IsEnabled());
+    BOOST_CHECK(mnodeman.GetMasternodeByRank(1, nHeight, 0, true) == NULL);
+
+    // and so does a ping enabling it again
+    pmn->lastPing.sigTime = GetAdjustedTime();
+    pmn->Check(true);
+    BOOST_CHECK(pmn->IsEnabled());
+    BOOST_CHECK(mnodeman.GetMasternodeByRank(1, nHeight, 0, true) == pmn);
+
+    mnodeman.Clear();
+    mapCacheBlockHashes.erase(nHeight);
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_rank_reorg)
+{
+    const int nHeight = 1;
+    mapCacheBlockHashes[nHeight] = GetRandHash();
+
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(GetRandHash(), 0));
+    mn.unitTest = true;
+    mn.lastPing.vin = mn.vin;
+    mn.lastPing.sigTime = GetAdjustedTime();
+    BOOST_CHECK(mnodeman.Add(mn));
+    CMasternode* pmn = mnodeman.Find(mn.vin);
+    BOOST_CHECK(pmn != NULL);
+    BOOST_CHECK(mnodeman.GetMasternodeByRank(1, nHeight, 0, false) == pmn);
+
+    // Disconnecting the block below forgets its hash, the height no longer ranks
+    ForgetBlockHashes(nHeight);
+    BOOST_CHECK(!mapCacheBlockHashes.count(nHeight));
+    BOOST_CHECK(mnodeman.GetMasternodeByRank(1, nHeight, 0, false) == NULL);
+
+    // until the block replacing it is known
+    mapCacheBlockHashes[nHeight] = GetRandHash();
+    BOOST_CHECK(mnodeman.GetMasternodeByRank(1, nHeight, 0, false) == pmn);
+
+    mnodeman.Clear();
+    mapCacheBlockHashes.erase(nHeight);
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_list_digests)
+{
+    const unsigned int nBuckets = 4;
+    std::vector<uint256> vHashes;
+    std::vector<uint256> vExpected(nBuckets);
+    uint256 nAll = 0;
+    for (int i = 0; i < 20; i++) {
+        CMasternode mn;
+        mn.vin = CTxIn(COutPoint(GetRandHash(), 0));
+        mn.unitTest = true;
+        mn.sigTime = GetAdjustedTime() - 1000 - i;
+        mn.lastPing.vin = mn.vin;
+        mn.lastPing.sigTime = GetAdjustedTime();
+        BOOST_CHECK(mnodeman.Add(mn));
+
+        // each entry goes into the bucket picked by the low bits of its broadcast hash
+        uint256 hash = CMasternodeBroadcast(mn).GetHash();
+        vHashes.push_back(hash);
+        vExpected[hash.GetLow64() % nBuckets] ^= hash;
+        nAll ^= hash;
+    }
+
+    BOOST_CHECK(mnodeman.GetListDigests(0).empty());
+    std::vector<uint256> vOne = mnodeman.GetListDigests(1);
+    BOOST_CHECK_EQUAL(vOne.size(), 1U);
+    BOOST_CHECK(vOne[0] == nAll);
+    std::vector<uint256> vDigests = mnodeman.GetListDigests(nBuckets);
+    BOOST_CHECK(vDigests == vExpected);
+
+    // Losing an entry changes only the digest of its bucket
+    CMasternode* pmn = mnodeman.Find(mnodeman.GetFullMasternodeVector()[0].vin);
+    BOOST_CHECK(pmn != NULL);
+    uint256 hash = CMasternodeBroadcast(*pmn).GetHash();
+    unsigned int nBucket = hash.GetLow64() % nBuckets;
+    pmn->lastPing.sigTime = GetAdjustedTime() - MASTERNODE_EXPIRATION_SECONDS;
+    pmn->Check(true);
+    BOOST_CHECK(!pmn->IsEnabled());
+    std::vector<uint256> vAfter = mnodeman.GetListDigests(nBuckets);
+    for (unsigned int i = 0; i < nBuckets; i++) {
+        if (i == nBucket)
+            BOOST_CHECK(vAfter[i] == (vDigests[i] ^ hash));
+        else
+            BOOST_CHECK(vAfter[i] == vDigests[i]);
+    }
+
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
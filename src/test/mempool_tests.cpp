@@ -3,11 +3,14 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "main.h"
+#include "miner.h"
 #include "txmempool.h"
 #include "util.h"
 
 #include <boost/test/unit_test.hpp>
 #include <list>
+#include <map>
+#include <vector>
 
 BOOST_AUTO_TEST_SUITE(mempool_tests)
 
@@ -99,4 +102,416 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+template <int index>
+void CheckSort(CTxMemPool& pool, std::vector<std::string>& sortedOrder)
+{
+    BOOST_CHECK_EQUAL(pool.size(), sortedOrder.size());
+    typename CTxMemPool::indexed_transaction_set::nth_index<index>::type::iterator it = pool.mapTx.get<index>().begin();
+    int count = 0;
+    for (; it != pool.mapTx.get<index>().end(); ++it, ++count) {
+        BOOST_CHECK_EQUAL(it->GetTx().GetHash().ToString(), sortedOrder[count]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MempoolIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+
+    /* 3rd highest fee */
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 0, 10.0, 1));
+
+    /* highest fee */
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx2.vout[0].nValue = 2 * COIN;
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 20000LL, 0, 9.0, 1));
+
+    /* lowest fee */
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx3.vout[0].nValue = 5 * COIN;
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 0LL, 0, 100.0, 1));
+
+    /* 2nd highest fee */
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx4.vout[0].nValue = 6 * COIN;
+    pool.addUnchecked(tx4.GetHash(), CTxMemPoolEntry(tx4, 15000LL, 0, 1.0, 1));
+
+    /* equal fee rate to tx1, but newer */
+    CMutableTransaction tx5 = CMutableTransaction();
+    tx5.vout.resize(1);
+    tx5.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx5.vout[0].nValue = 11 * COIN;
+    pool.addUnchecked(tx5.GetHash(), CTxMemPoolEntry(tx5, 10000LL, 1, 10.0, 1));
+    BOOST_CHECK_EQUAL(pool.size(), 5);
+
+    std::vector<std::string> sortedOrder;
+    sortedOrder.resize(5);
+    sortedOrder[0] = tx3.GetHash().ToString(); // 0
+    sortedOrder[1] = tx5.GetHash().ToString(); // 10000
+    sortedOrder[2] = tx1.GetHash().ToString(); // 10000
+    sortedOrder[3] = tx4.GetHash().ToString(); // 15000
+    sortedOrder[4] = tx2.GetHash().ToString(); // 20000
+    CheckSort<1>(pool, sortedOrder);
+
+    /* a high-fee child pulls the zero-fee tx3 up with it */
+    CMutableTransaction tx6 = CMutableTransaction();
+    tx6.vin.resize(1);
+    tx6.vin[0].prevout = COutPoint(tx3.GetHash(), 0);
+    tx6.vin[0].scriptSig = CScript() << OP_11;
+    tx6.vout.resize(1);
+    tx6.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx6.vout[0].nValue = 5 * COIN;
+    pool.addUnchecked(tx6.GetHash(), CTxMemPoolEntry(tx6, 200000LL, 2, 10.0, 1));
+    BOOST_CHECK_EQUAL(pool.size(), 6);
+
+    sortedOrder.erase(sortedOrder.begin());
+    sortedOrder.push_back(tx3.GetHash().ToString()); // 200000 over tx3 and tx6
+    sortedOrder.push_back(tx6.GetHash().ToString()); // 200000 over tx6 alone
+    CheckSort<1>(pool, sortedOrder);
+
+    /* entry time */
+    CTxMemPool::indexed_transaction_set::index<entry_time>::type::iterator it = pool.mapTx.get<entry_time>().begin();
+    BOOST_CHECK(it->GetTime() == 0);
+    std::advance(it, 4);
+    BOOST_CHECK_EQUAL(it->GetTx().GetHash().ToString(), tx5.GetHash().ToString());
+    ++it;
+    BOOST_CHECK_EQUAL(it->GetTx().GetHash().ToString(), tx6.GetHash().ToString());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolAncestorIndexingTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 0, 10.0, 1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx2.vout[0].nValue = 2 * COIN;
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 20000LL, 0, 9.0, 1));
+
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx3.vout[0].nValue = 5 * COIN;
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 0LL, 0, 100.0, 1));
+
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx4.vout[0].nValue = 6 * COIN;
+    pool.addUnchecked(tx4.GetHash(), CTxMemPoolEntry(tx4, 15000LL, 0, 1.0, 1));
+
+    /* equal fee rate to tx1: ties are broken by hash */
+    CMutableTransaction tx5 = CMutableTransaction();
+    tx5.vout.resize(1);
+    tx5.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx5.vout[0].nValue = 11 * COIN;
+    pool.addUnchecked(tx5.GetHash(), CTxMemPoolEntry(tx5, 10000LL, 1, 10.0, 1));
+    BOOST_CHECK_EQUAL(pool.size(), 5);
+
+    std::vector<std::string> sortedOrder;
+    sortedOrder.resize(5);
+    sortedOrder[0] = tx2.GetHash().ToString(); // 20000
+    sortedOrder[1] = tx4.GetHash().ToString(); // 15000
+    // tx1 and tx5 are both 10000
+    if (tx1.GetHash() < tx5.GetHash()) {
+        sortedOrder[2] = tx1.GetHash().ToString();
+        sortedOrder[3] = tx5.GetHash().ToString();
+    } else {
+        sortedOrder[2] = tx5.GetHash().ToString();
+        sortedOrder[3] = tx1.GetHash().ToString();
+    }
+    sortedOrder[4] = tx3.GetHash().ToString(); // 0
+    CheckSort<3>(pool, sortedOrder);
+
+    /* the child of tx3 is scored together with tx3, its parent stays at the bottom */
+    CMutableTransaction tx6 = CMutableTransaction();
+    tx6.vin.resize(1);
+    tx6.vin[0].prevout = COutPoint(tx3.GetHash(), 0);
+    tx6.vin[0].scriptSig = CScript() << OP_11;
+    tx6.vout.resize(1);
+    tx6.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx6.vout[0].nValue = 5 * COIN;
+    pool.addUnchecked(tx6.GetHash(), CTxMemPoolEntry(tx6, 200000LL, 2, 10.0, 1));
+
+    sortedOrder.insert(sortedOrder.begin(), tx6.GetHash().ToString());
+    CheckSort<3>(pool, sortedOrder);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolPackageStateTest)
+{
+    // Chain of parent -> child -> grandchild
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(1);
+    txParent.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txParent.vout[0].nValue = 33000LL;
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout = COutPoint(txParent.GetHash(), 0);
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 22000LL;
+    CMutableTransaction txGrandChild;
+    txGrandChild.vin.resize(1);
+    txGrandChild.vin[0].scriptSig = CScript() << OP_11;
+    txGrandChild.vin[0].prevout = COutPoint(txChild.GetHash(), 0);
+    txGrandChild.vout.resize(1);
+    txGrandChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txGrandChild.vout[0].nValue = 11000LL;
+
+    CTxMemPool pool(CFeeRate(0));
+    pool.addUnchecked(txParent.GetHash(), CTxMemPoolEntry(txParent, 1000LL, 0, 0.0, 1));
+    pool.addUnchecked(txChild.GetHash(), CTxMemPoolEntry(txChild, 2000LL, 0, 0.0, 1));
+    pool.addUnchecked(txGrandChild.GetHash(), CTxMemPoolEntry(txGrandChild, 3000LL, 0, 0.0, 1));
+
+    uint64_t nSize = ::GetSerializeSize(txParent, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_EQUAL(nSize, ::GetSerializeSize(txGrandChild, SER_NETWORK, PROTOCOL_VERSION));
+
+    CTxMemPool::txiter itParent = pool.mapTx.find(txParent.GetHash());
+    CTxMemPool::txiter itChild = pool.mapTx.find(txChild.GetHash());
+    CTxMemPool::txiter itGrandChild = pool.mapTx.find(txGrandChild.GetHash());
+    BOOST_CHECK_EQUAL(itParent->GetCountWithDescendants(), 3U);
+    BOOST_CHECK_EQUAL(itParent->GetSizeWithDescendants(), 3 * nSize);
+    BOOST_CHECK_EQUAL(itParent->GetModFeesWithDescendants(), 6000);
+    BOOST_CHECK_EQUAL(itChild->GetCountWithDescendants(), 2U);
+    BOOST_CHECK_EQUAL(itChild->GetCountWithAncestors(), 2U);
+    BOOST_CHECK_EQUAL(itGrandChild->GetCountWithAncestors(), 3U);
+    BOOST_CHECK_EQUAL(itGrandChild->GetSizeWithAncestors(), 3 * nSize);
+    BOOST_CHECK_EQUAL(itGrandChild->GetModFeesWithAncestors(), 6000);
+    BOOST_CHECK(pool.GetMemPoolChildren(itParent).count(itChild));
+    BOOST_CHECK(pool.GetMemPoolParents(itGrandChild).count(itChild));
+
+    // Fee deltas show up in the aggregates of ancestors and descendants
+    pool.PrioritiseTransaction(txChild.GetHash(), txChild.GetHash().ToString(), 0.0, 500);
+    BOOST_CHECK_EQUAL(itChild->GetModifiedFee(), 2500);
+    BOOST_CHECK_EQUAL(itParent->GetModFeesWithDescendants(), 6500);
+    BOOST_CHECK_EQUAL(itGrandChild->GetModFeesWithAncestors(), 6500);
+
+    // Mining the parent leaves the other two with one ancestor less
+    std::list<CTransaction> removed;
+    pool.remove(txParent, removed, false);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    BOOST_CHECK_EQUAL(pool.size(), 2);
+    BOOST_CHECK_EQUAL(itChild->GetCountWithAncestors(), 1U);
+    BOOST_CHECK_EQUAL(itChild->GetModFeesWithAncestors(), 2500);
+    BOOST_CHECK_EQUAL(itGrandChild->GetCountWithAncestors(), 2U);
+    BOOST_CHECK_EQUAL(itGrandChild->GetSizeWithAncestors(), 2 * nSize);
+    BOOST_CHECK(pool.GetMemPoolParents(itChild).empty());
+
+    // Ancestor limits are enforced before anything is added
+    CMutableTransaction txGreatGrandChild;
+    txGreatGrandChild.vin.resize(1);
+    txGreatGrandChild.vin[0].scriptSig = CScript() << OP_11;
+    txGreatGrandChild.vin[0].prevout = COutPoint(txGrandChild.GetHash(), 0);
+    txGreatGrandChild.vout.resize(1);
+    txGreatGrandChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txGreatGrandChild.vout[0].nValue = 10000LL;
+    CTxMemPoolEntry entry(txGreatGrandChild, 1000LL, 0, 0.0, 1);
+    CTxMemPool::setEntries setAncestors;
+    std::string errString;
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(entry, setAncestors, 3, 1000000, 25, 1000000, errString));
+    BOOST_CHECK_EQUAL(setAncestors.size(), 2U);
+    setAncestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(entry, setAncestors, 2, 1000000, 25, 1000000, errString));
+    setAncestors.clear();
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(entry, setAncestors, 25, 1000000, 2, 1000000, errString));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 0, 0.0, 1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 5000LL, 0, 0.0, 1));
+
+    pool.TrimToSize(pool.DynamicMemoryUsage()); // should do nothing
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+    BOOST_CHECK(pool.exists(tx2.GetHash()));
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), 0);
+
+    pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4); // should remove the lower-feerate transaction
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+    BOOST_CHECK(!pool.exists(tx2.GetHash()));
+
+    // A zero-fee parent is evicted together with its child when the package
+    // as a whole pays less than an unrelated transaction
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vin.resize(1);
+    tx3.vin[0].scriptSig = CScript() << OP_3;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    tx3.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 0LL, 0, 0.0, 1));
+
+    CMutableTransaction tx4 = CMutableTransaction();
+    tx4.vin.resize(1);
+    tx4.vin[0].prevout = COutPoint(tx3.GetHash(), 0);
+    tx4.vin[0].scriptSig = CScript() << OP_4;
+    tx4.vout.resize(1);
+    tx4.vout[0].scriptPubKey = CScript() << OP_4 << OP_EQUAL;
+    tx4.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx4.GetHash(), CTxMemPoolEntry(tx4, 12000LL, 0, 0.0, 1));
+
+    uint64_t nPackageSize = ::GetSerializeSize(tx3, SER_NETWORK, PROTOCOL_VERSION) + ::GetSerializeSize(tx4, SER_NETWORK, PROTOCOL_VERSION);
+    CFeeRate maxFeeRateRemoved(CFeeRate(12000, nPackageSize).GetFeePerK() + 1000);
+    BOOST_CHECK(CFeeRate(10000, ::GetSerializeSize(tx1, SER_NETWORK, PROTOCOL_VERSION)) > maxFeeRateRemoved);
+
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK(pool.exists(tx1.GetHash()));
+    BOOST_CHECK(!pool.exists(tx3.GetHash()));
+    BOOST_CHECK(!pool.exists(tx4.GetHash()));
+
+    // The rolling minimum fee is the highest feerate evicted so far, and holds
+    // until the next block
+    SetMockTime(42);
+    SetMockTime(42 + CTxMemPool::ROLLING_FEE_HALFLIFE);
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), maxFeeRateRemoved.GetFeePerK());
+
+    std::vector<CTransaction> vtx;
+    std::list<CTransaction> conflicts;
+    pool.removeForBlock(vtx, 1, conflicts);
+    SetMockTime(42 + 2 * CTxMemPool::ROLLING_FEE_HALFLIFE);
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), maxFeeRateRemoved.GetFeePerK() / 2);
+    // ... then feerate should drop 1/2 each halflife
+
+    SetMockTime(42 + 2 * CTxMemPool::ROLLING_FEE_HALFLIFE + CTxMemPool::ROLLING_FEE_HALFLIFE / 2);
+    BOOST_CHECK_EQUAL(pool.GetMinFee(pool.DynamicMemoryUsage() * 5 / 2).GetFeePerK(), maxFeeRateRemoved.GetFeePerK() / 4);
+    // ... with a 1/2 halflife when mempool is < 1/2 its target size
+
+    SetMockTime(42 + 30 * CTxMemPool::ROLLING_FEE_HALFLIFE);
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), 0);
+    // ... and goes all the way to 0 once it has dropped below half the relay fee
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolExpiryTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx1.GetHash(), CTxMemPoolEntry(tx1, 10000LL, 10, 0.0, 1));
+
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx2.GetHash(), CTxMemPoolEntry(tx2, 10000LL, 30, 0.0, 1));
+
+    // Entered after the cutoff, but goes with its expired parent
+    CMutableTransaction tx3 = CMutableTransaction();
+    tx3.vin.resize(1);
+    tx3.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx3.vin[0].scriptSig = CScript() << OP_3;
+    tx3.vout.resize(1);
+    tx3.vout[0].scriptPubKey = CScript() << OP_3 << OP_EQUAL;
+    tx3.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(tx3.GetHash(), CTxMemPoolEntry(tx3, 10000LL, 40, 0.0, 1));
+
+    BOOST_CHECK_EQUAL(pool.Expire(10), 0);
+    BOOST_CHECK_EQUAL(pool.size(), 3);
+
+    BOOST_CHECK_EQUAL(pool.Expire(20), 2);
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+    BOOST_CHECK(pool.exists(tx2.GetHash()));
+    BOOST_CHECK_EQUAL(pool.GetTotalTxSize(), ::GetSerializeSize(tx2, SER_NETWORK, PROTOCOL_VERSION));
+}
+
+static CTransaction SelectionTestTx(int n, const uint256& hashParent)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    // A null prevout would make it a coinbase, which is never selected
+    tx.vin[0].prevout = COutPoint(hashParent != 0 ? hashParent : uint256(n), 0);
+    tx.vin[0].scriptSig = CScript() << OP_11 << n;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    tx.vout[0].nValue = 10 * COIN;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(MempoolBlockSelectionTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    LOCK(pool.cs);
+
+    // A free parent paid for by its child, two transactions paying less
+    // than that package and one paying nothing
+    CTransaction txParent = SelectionTestTx(1, 0);
+    CTransaction txChild = SelectionTestTx(2, txParent.GetHash());
+    CTransaction txHigh = SelectionTestTx(3, 0);
+    CTransaction txLow = SelectionTestTx(4, 0);
+    CTransaction txFree = SelectionTestTx(5, 0);
+    pool.addUnchecked(txParent.GetHash(), CTxMemPoolEntry(txParent, 0, 0, 0.0, 1));
+    pool.addUnchecked(txChild.GetHash(), CTxMemPoolEntry(txChild, 20000, 0, 0.0, 1));
+    pool.addUnchecked(txHigh.GetHash(), CTxMemPoolEntry(txHigh, 5000, 0, 0.0, 1));
+    pool.addUnchecked(txLow.GetHash(), CTxMemPoolEntry(txLow, 2000, 0, 0.0, 1));
+    pool.addUnchecked(txFree.GetHash(), CTxMemPoolEntry(txFree, 0, 0, 0.0, 1));
+
+    // Best package first, parents before children, free transactions left out
+    std::vector<CTxMemPool::txiter> vSelected;
+    SelectMempoolTransactions(pool, 2, 250000, 0, 0, vSelected);
+    BOOST_CHECK_EQUAL(vSelected.size(), 4U);
+    if (vSelected.size() == 4) {
+        BOOST_CHECK(vSelected[0]->GetTx().GetHash() == txParent.GetHash());
+        BOOST_CHECK(vSelected[1]->GetTx().GetHash() == txChild.GetHash());
+        BOOST_CHECK(vSelected[2]->GetTx().GetHash() == txHigh.GetHash());
+        BOOST_CHECK(vSelected[3]->GetTx().GetHash() == txLow.GetHash());
+    }
+
+    // A block one byte too small for the last transaction leaves it out
+    unsigned int nBlockMaxSize = 1000 + 1;
+    for (size_t i = 0; i < 3 && i < vSelected.size(); i++)
+        nBlockMaxSize += vSelected[i]->GetTxSize();
+    SelectMempoolTransactions(pool, 2, nBlockMaxSize, 0, 0, vSelected);
+    BOOST_CHECK_EQUAL(vSelected.size(), 3U);
+    if (vSelected.size() == 3)
+        BOOST_CHECK(vSelected[2]->GetTx().GetHash() == txHigh.GetHash());
+
+    // Once the parent is mined the child no longer pays for it
+    std::list<CTransaction> removed;
+    pool.removeForBlock(std::vector<CTransaction>(1, txParent), 2, removed);
+    SelectMempoolTransactions(pool, 3, 250000, 0, 0, vSelected);
+    BOOST_CHECK_EQUAL(vSelected.size(), 3U);
+    if (!vSelected.empty())
+        BOOST_CHECK(vSelected[0]->GetTx().GetHash() == txChild.GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,156 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "obfuscation.h"
+#include "obfuscation-planner.h"
+#include "random.h"
+#include "script/standard.h"
+#include "wallet.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(obfuscation_tests)
+
+BOOST_AUTO_TEST_CASE(obfuscation_verify_cached_signatures)
+{
+    CKey key, key2;
+    key.MakeNewKey(true);
+    key2.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    CPubKey pubkey2 = key2.GetPubKey();
+
+    std::vector<CSignedMessageCheck> vChecks;
+    std::vector<std::vector<unsigned char> > vSigs;
+    std::string strError;
+    for (int i = 0; i < 4; i++) {
+        std::vector<unsigned char> vchSig;
+        BOOST_CHECK(obfuScationSigner.SignMessage(strprintf("message %d", i), strError, vchSig, key));
+        BOOST_CHECK(!IsMessageSignatureCached(pubkey, vchSig, strprintf("message %d", i)));
+        vSigs.push_back(vchSig);
+        vChecks.push_back(CSignedMessageCheck(pubkey, vchSig, strprintf("message %d", i)));
+    }
+    // Signed by the wrong key: checked along with the others, but never cached
+    vChecks.push_back(CSignedMessageCheck(pubkey2, vSigs[0], "message 0"));
+    CheckSignedMessages(vChecks);
+
+    for (int i = 0; i < 4; i++) {
+        // the batch filled the cache, so processing the message is a hit
+        BOOST_CHECK(IsMessageSignatureCached(pubkey, vSigs[i], strprintf("message %d", i)));
+        BOOST_CHECK(obfuScationSigner.VerifyMessage(pubkey, vSigs[i], strprintf("message %d", i), strError));
+
+        // a cached signature is only valid for its own message and signer
+        BOOST_CHECK(!obfuScationSigner.VerifyMessage(pubkey2, vSigs[i], strprintf("message %d", i), strError));
+        BOOST_CHECK(!IsMessageSignatureCached(pubkey2, vSigs[i], strprintf("message %d", i)));
+        BOOST_CHECK(!obfuScationSigner.VerifyMessage(pubkey, vSigs[i], strprintf("message %d", i + 1), strError));
+        BOOST_CHECK(!IsMessageSignatureCached(pubkey, vSigs[i], strprintf("message %d", i + 1)));
+    }
+}
+
+static void InitDenominations()
+{
+    if (obfuScationDenominations.empty()) {
+        obfuScationDenominations.push_back((10000 * COIN) + 10000000);
+        obfuScationDenominations.push_back((1000 * COIN) + 1000000);
+        obfuScationDenominations.push_back((100 * COIN) + 100000);
+        obfuScationDenominations.push_back((10 * COIN) + 10000);
+        obfuScationDenominations.push_back((1 * COIN) + 1000);
+        obfuScationDenominations.push_back((.1 * COIN) + 100);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(obfuscation_plan_step)
+{
+    InitDenominations();
+
+    CObfuscationBalances balances;
+    CAmount nAmount;
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 1000 * COIN, nAmount), OBFUSCATION_PLAN_NOTHING);
+
+    // Non-denominated funds are denominated first, up to the target
+    balances.nAnonymizable = 500 * COIN;
+    balances.nNonDenominated = 500 * COIN;
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 1000 * COIN, nAmount), OBFUSCATION_PLAN_DENOMINATE);
+    BOOST_CHECK_EQUAL(nAmount, 500 * COIN);
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 200 * COIN, nAmount), OBFUSCATION_PLAN_DENOMINATE);
+    BOOST_CHECK_EQUAL(nAmount, 200 * COIN);
+
+    // Denominations waiting for confirmation
+    balances.nAnonymizable = 505 * COIN;
+    balances.nNonDenominated = 5 * COIN;
+    balances.nDenominatedUnconfirmed = 500 * COIN;
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 1000 * COIN, nAmount), OBFUSCATION_PLAN_WAIT_DENOMINATED);
+    balances.nNonDenominated = 0;
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 1000 * COIN, nAmount), OBFUSCATION_PLAN_NO_INPUTS);
+
+    // Confirmed denominations need collateral before mixing
+    balances.nAnonymizable = 500 * COIN;
+    balances.nDenominatedUnconfirmed = 0;
+    balances.nDenominatedConfirmed = 500 * COIN;
+    balances.nSmallestMixable = obfuScationDenominations.back();
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 1000 * COIN, nAmount), OBFUSCATION_PLAN_COLLATERAL);
+    balances.fCollateralUnconfirmed = true;
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 1000 * COIN, nAmount), OBFUSCATION_PLAN_WAIT_COLLATERAL);
+    balances.fCollateral = true;
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 1000 * COIN, nAmount), OBFUSCATION_PLAN_MIX);
+    BOOST_CHECK_EQUAL(nAmount, 500 * COIN);
+
+    // Partly anonymized: mix what is left of the target
+    balances.nAnonymized = 200 * COIN;
+    balances.nAnonymizable = 300 * COIN;
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 1000 * COIN, nAmount), OBFUSCATION_PLAN_MIX);
+    BOOST_CHECK_EQUAL(nAmount, 300 * COIN);
+    BOOST_CHECK_EQUAL(CObfuscationPlanner::PlanStep(balances, 200 * COIN, nAmount), OBFUSCATION_PLAN_NOTHING);
+}
+
+static void CheckPlannerBalances(CWallet& wallet)
+{
+    BOOST_CHECK(wallet.obfuscationPlanner.Refresh(wallet));
+    CObfuscationBalances balances = wallet.obfuscationPlanner.GetBalances();
+    BOOST_CHECK_EQUAL(balances.nDenominatedConfirmed, wallet.GetDenominatedBalance());
+    BOOST_CHECK_EQUAL(balances.nDenominatedUnconfirmed, wallet.GetDenominatedBalance(true));
+    BOOST_CHECK_EQUAL(balances.nAnonymizable, wallet.GetAnonymizableBalance());
+    BOOST_CHECK_EQUAL(balances.nAnonymized, wallet.GetAnonymizedBalance());
+}
+
+BOOST_AUTO_TEST_CASE(obfuscation_planner_refresh)
+{
+    InitDenominations();
+
+    CWallet wallet("obfuscation_planner_test.dat");
+    bool fFirstRun;
+    wallet.LoadWallet(fFirstRun);
+    CKey key;
+    key.MakeNewKey(true);
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.AddKeyPubKey(key, key.GetPubKey()));
+    }
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    CheckPlannerBalances(wallet);
+
+    // Received from someone else: unconfirmed, neither denominated nor anonymizable yet
+    CMutableTransaction txReceive;
+    txReceive.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txReceive.vout.push_back(CTxOut(obfuScationDenominations[3], scriptPubKey));
+    txReceive.vout.push_back(CTxOut(5 * COIN, scriptPubKey));
+    wallet.SyncTransaction(txReceive, NULL);
+    BOOST_CHECK(wallet.GetDenominatedBalance(true) > 0);
+    CheckPlannerBalances(wallet);
+
+    // Spending our own output is trusted, and the spent output leaves the balances
+    CMutableTransaction txSpend;
+    txSpend.vin.push_back(CTxIn(COutPoint(txReceive.GetHash(), 1)));
+    txSpend.vout.push_back(CTxOut(obfuScationDenominations[4], scriptPubKey));
+    txSpend.vout.push_back(CTxOut(3 * COIN, scriptPubKey));
+    wallet.SyncTransaction(txSpend, NULL);
+    BOOST_CHECK(wallet.GetDenominatedBalance() > 0);
+    BOOST_CHECK(wallet.GetAnonymizableBalance() > 0);
+    CheckPlannerBalances(wallet);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,65 @@
+// Copyright (c) 2012-2015 The Bitcoin Core developers
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "scheduler.h"
+
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_AUTO_TEST_SUITE(scheduler_tests)
+
+static void Record(boost::mutex& mutex, std::vector<int>& vOrder, int n)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    vOrder.push_back(n);
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_order)
+{
+    CScheduler scheduler;
+    boost::mutex mutex;
+    std::vector<int> vOrder;
+
+    // Scheduled out of order, run by time
+    for (int i = 9; i >= 0; i--)
+        scheduler.scheduleFromNow(boost::bind(&Record, boost::ref(mutex), boost::ref(vOrder), i), 10 * i);
+
+    boost::system_time first, last;
+    BOOST_CHECK_EQUAL(scheduler.getQueueInfo(first, last), 10U);
+    BOOST_CHECK(first < last);
+
+    boost::thread thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    scheduler.stop(true);
+    thread.join();
+
+    BOOST_CHECK_EQUAL(vOrder.size(), 10U);
+    for (int i = 0; i < (int)vOrder.size(); i++)
+        BOOST_CHECK_EQUAL(vOrder[i], i);
+    BOOST_CHECK_EQUAL(scheduler.getQueueInfo(first, last), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(scheduler_every)
+{
+    CScheduler scheduler;
+    boost::mutex mutex;
+    std::vector<int> vOrder;
+
+    scheduler.scheduleEvery(boost::bind(&Record, boost::ref(mutex), boost::ref(vOrder), 1), 5);
+    boost::thread thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    scheduler.stop();
+    thread.join();
+
+    // stop() without draining leaves the next repetition queued
+    boost::system_time first, last;
+    BOOST_CHECK_EQUAL(scheduler.getQueueInfo(first, last), 1U);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    BOOST_CHECK(vOrder.size() >= 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -669,6 +669,66 @@ BOOST_AUTO_TEST_CASE(script_invalid)
     }
 }
 
+BOOST_AUTO_TEST_CASE(script_stack_reuse)
+{
+    typedef CScriptStack::valtype valtype;
+    CScriptStack stack;
+    valtype a(1, 'a'), b(2, 'b'), c(3, 'c');
+    stack.push_back(a);
+    stack.push_back(b);
+    stack.push_back(c);
+
+    // (a b c -- a c b a)
+    stack.insert(stack.end() - 2, stack.at(2));
+    stack.erase(stack.end() - 1);
+    stack.push_back(stack.at(0));
+    std::vector<valtype> vExpected;
+    vExpected.push_back(a);
+    vExpected.push_back(c);
+    vExpected.push_back(b);
+    vExpected.push_back(a);
+    BOOST_CHECK_EQUAL(stack.size(), 4U);
+    for (size_t i = 0; i < vExpected.size(); i++)
+        BOOST_CHECK(stack.at(i) == vExpected[i]);
+    BOOST_CHECK_THROW(stack.at(4), std::out_of_range);
+
+    // Popped buffers are handed to later pushes
+    valtype big(520, 'x');
+    stack.push_back(big);
+    const unsigned char* pBuffer = &stack.back()[0];
+    stack.pop_back();
+    stack.push_back(valtype(500, 'y'));
+    BOOST_CHECK(&stack.back()[0] == pBuffer);
+    BOOST_CHECK(stack.back() == valtype(500, 'y'));
+
+    // Conversion to and from the vector interface keeps the contents
+    std::vector<valtype> vStack;
+    stack.swap(vStack);
+    BOOST_CHECK_EQUAL(vStack.size(), 5U);
+    BOOST_CHECK(stack.empty());
+    stack.swap(vStack);
+    BOOST_CHECK_EQUAL(stack.size(), 5U);
+    BOOST_CHECK(stack.at(1) == c);
+
+    // A reused arena gives the same results as fresh stacks
+    Array tests = read_json(std::string(json_tests::script_valid, json_tests::script_valid + sizeof(json_tests::script_valid)));
+    CScriptStackArena arena;
+    BOOST_FOREACH(Value& tv, tests) {
+        Array test = tv.get_array();
+        if (test.size() < 3)
+            continue;
+        CScript scriptSig = ParseScript(test[0].get_str());
+        CScript scriptPubKey = ParseScript(test[1].get_str());
+        unsigned int flags = ParseScriptFlags(test[2].get_str());
+        CMutableTransaction tx = BuildSpendingTransaction(scriptSig, BuildCreditingTransaction(scriptPubKey));
+        MutableTransactionSignatureChecker checker(&tx, 0);
+        ScriptError err, errArena;
+        BOOST_CHECK(VerifyScript(scriptSig, scriptPubKey, flags, checker, &err));
+        BOOST_CHECK(VerifyScript(scriptSig, scriptPubKey, flags, checker, &errArena, &arena));
+        BOOST_CHECK_EQUAL(err, errArena);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(script_PushData)
 {
     // Check that PUSHDATA1, PUSHDATA2, and PUSHDATA4 create the same value on
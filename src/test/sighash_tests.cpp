@@ -162,6 +162,25 @@ BOOST_AUTO_TEST_CASE(sighash_test)
     #endif
 }
 
+// Goal: check that hashing from PrecomputedTransactionData matches the reference
+BOOST_AUTO_TEST_CASE(sighash_precomputed)
+{
+    seed_insecure_rand(false);
+
+    for (int i=0; i<5000; i++) {
+        int nHashType = (i % 2) ? insecure_rand() : SIGHASH_ALL;
+        CMutableTransaction txTo;
+        RandomTransaction(txTo, (nHashType & 0x1f) == SIGHASH_SINGLE);
+        CTransaction tx(txTo);
+        PrecomputedTransactionData txdata(tx);
+        CScript scriptCode;
+        RandomScript(scriptCode);
+
+        for (unsigned int nIn=0; nIn<tx.vin.size(); nIn++)
+            BOOST_CHECK(SignatureHash(scriptCode, tx, nIn, nHashType, &txdata) == SignatureHashOld(scriptCode, tx, nIn, nHashType));
+    }
+}
+
 // Goal: check that SignatureHash generates correct hash
 BOOST_AUTO_TEST_CASE(sighash_from_data)
 {
@@ -0,0 +1,98 @@
+// Copyright (c) 2015-2018 The SAVIOUR developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "swifttx.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(swifttx_tests)
+
+static CTransaction SpendTx(const COutPoint& prevout, int nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(prevout));
+    tx.vout.push_back(CTxOut(nValue, CScript() << OP_TRUE));
+    return tx;
+}
+
+static CConsensusVote Vote(const uint256& txHash, int n, int nBlockHeight)
+{
+    CConsensusVote ctx;
+    ctx.vinMasternode = CTxIn(COutPoint(uint256(1000 + n), 0));
+    ctx.txHash = txHash;
+    ctx.nBlockHeight = nBlockHeight;
+    return ctx;
+}
+
+BOOST_AUTO_TEST_CASE(lock_completion)
+{
+    CTransactionLockManager manager;
+    COutPoint prevout(uint256(1), 0);
+    CTransaction tx = SpendTx(prevout, 1);
+    CTransaction txDoubleSpend = SpendTx(prevout, 2);
+    uint256 hashLock;
+
+    BOOST_CHECK_EQUAL(manager.CountSignatures(tx.GetHash()), -1);
+    manager.AddLockRequest(tx);
+    manager.SetLockHeight(tx.GetHash(), 100);
+    BOOST_CHECK(manager.HasLockRequest(tx.GetHash()));
+
+    bool fComplete = false;
+    bool fReprocess = false;
+    for (int n = 0; n < SWIFTTX_SIGNATURES_REQUIRED; n++) {
+        BOOST_CHECK(!manager.HasConflictingLock(txDoubleSpend, hashLock));
+        CConsensusVote ctx = Vote(tx.GetHash(), n, 100);
+        BOOST_CHECK(manager.AddVote(ctx));
+        BOOST_CHECK(!manager.AddVote(ctx));
+        manager.ProcessVote(ctx, fComplete, fReprocess);
+        BOOST_CHECK_EQUAL(fComplete, n + 1 == SWIFTTX_SIGNATURES_REQUIRED);
+        BOOST_CHECK(!fReprocess);
+    }
+    BOOST_CHECK_EQUAL(manager.CountSignatures(tx.GetHash()), SWIFTTX_SIGNATURES_REQUIRED);
+
+    // votes for another height don't count
+    manager.ProcessVote(Vote(tx.GetHash(), 99, 101), fComplete, fReprocess);
+    BOOST_CHECK_EQUAL(manager.CountSignatures(tx.GetHash()), SWIFTTX_SIGNATURES_REQUIRED);
+
+    // the complete lock owns its input
+    BOOST_CHECK(!manager.HasConflictingLock(tx, hashLock));
+    BOOST_CHECK(manager.HasConflictingLock(txDoubleSpend, hashLock));
+    BOOST_CHECK(hashLock == tx.GetHash());
+    BOOST_CHECK(!manager.AddRejectedLockRequest(txDoubleSpend));
+    BOOST_CHECK(manager.HasConflictingLock(txDoubleSpend, hashLock));
+
+    CTransactionLockStats stats;
+    manager.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nLocks, 1U);
+    BOOST_CHECK_EQUAL(stats.nLockedInputs, 1U);
+    BOOST_CHECK_EQUAL(stats.nVotes, (size_t)SWIFTTX_SIGNATURES_REQUIRED);
+    BOOST_CHECK_EQUAL(stats.nLocksCompleted, 1);
+    BOOST_CHECK(stats.nLockTimeMax >= stats.nLockTimeLast);
+}
+
+BOOST_AUTO_TEST_CASE(lock_of_rejected_request)
+{
+    CTransactionLockManager manager;
+    CTransaction tx = SpendTx(COutPoint(uint256(2), 0), 1);
+    bool fComplete = false;
+    bool fReprocess = false;
+
+    // votes that arrive before the request still compile into its lock
+    manager.SetLockHeight(tx.GetHash(), 200);
+    for (int n = 0; n < SWIFTTX_SIGNATURES_REQUIRED; n++)
+        manager.ProcessVote(Vote(tx.GetHash(), n, 200), fComplete, fReprocess);
+    BOOST_CHECK(fComplete);
+    BOOST_CHECK(!fReprocess);
+    BOOST_CHECK(!manager.HasLockRequest(tx.GetHash()));
+
+    // a complete lock for a request the mempool rejected means the blocks it conflicted with have to go
+    BOOST_CHECK(manager.AddRejectedLockRequest(tx));
+    CTransaction txLocked;
+    BOOST_CHECK(manager.GetLockRequest(tx.GetHash(), txLocked));
+    manager.ProcessVote(Vote(tx.GetHash(), 50, 200), fComplete, fReprocess);
+    BOOST_CHECK(fComplete);
+    BOOST_CHECK(fReprocess);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #define BOOST_TEST_MODULE Saviour Test Suite
 
+#include "crypto/sha256.h"
 #include "main.h"
 #include "random.h"
 #include "txdb.h"
@@ -31,6 +32,7 @@ struct TestingSetup {
 
     TestingSetup() {
         SetupEnvironment();
+        SHA256AutoDetect();
         fPrintToDebugLog = false; // don't want to write to debug.log file
         fCheckBlockIndex = true;
         SelectParams(CBaseChainParams::UNITTEST);
@@ -2,7 +2,9 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "main.h"
 #include "wallet.h"
+#include "walletdb.h"
 
 #include <set>
 #include <stdint.h>
@@ -305,4 +307,93 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(wallet_rescan)
+{
+    CWallet wallet("wallet_rescan_test.dat");
+    bool fFirstRun;
+    wallet.LoadWallet(fFirstRun);
+
+    CBlockIndex* pindexGenesis;
+    CTransaction txGenesis;
+    {
+        LOCK(cs_main);
+        pindexGenesis = chainActive.Genesis();
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pindexGenesis));
+        txGenesis = block.vtx[0];
+    }
+    {
+        LOCK(wallet.cs_wallet);
+        BOOST_CHECK(wallet.AddWatchOnly(txGenesis.vout[0].scriptPubKey));
+    }
+
+    // A block without data stops the scan and leaves no height to resume from
+    {
+        LOCK(cs_main);
+        pindexGenesis->nStatus &= ~BLOCK_HAVE_DATA;
+    }
+    BOOST_CHECK_EQUAL(wallet.ScanForWalletTransactions(pindexGenesis), 0);
+    {
+        LOCK(cs_main);
+        pindexGenesis->nStatus |= BLOCK_HAVE_DATA;
+    }
+    int nRescanHeight;
+    BOOST_CHECK(!CWalletDB(wallet.strWalletFile).ReadRescanHeight(nRescanHeight));
+    strMiscWarning = "";
+
+    // Outputs to watched scripts are found, and the scan finishes
+    BOOST_CHECK_EQUAL(wallet.ScanForWalletTransactions(pindexGenesis), 1);
+    BOOST_CHECK(!CWalletDB(wallet.strWalletFile).ReadRescanHeight(nRescanHeight));
+    LOCK(wallet.cs_wallet);
+    BOOST_CHECK(wallet.mapWallet.count(txGenesis.GetHash()));
+}
+
+BOOST_AUTO_TEST_CASE(wallet_load_tx_batches)
+{
+    // Enough transactions to be decoded by several threads
+    const int nTxs = 300;
+    const std::string strFile = "wallet_load_test.dat";
+    map<uint256, CWalletTx> mapExpected;
+    {
+        CWalletDB walletdb(strFile, "cr+");
+        for (int i = 0; i < nTxs; i++) {
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout = COutPoint(uint256(i + 1), i % 3);
+            tx.vout.resize(1 + i % 2);
+            for (unsigned int j = 0; j < tx.vout.size(); j++) {
+                tx.vout[j].nValue = 1000 + i;
+                tx.vout[j].scriptPubKey = CScript() << OP_TRUE;
+            }
+            tx.nLockTime = i;
+            CWalletTx wtx(NULL, tx);
+            wtx.nOrderPos = i;
+            wtx.nTimeReceived = 1400000000 + i;
+            wtx.mapValue["comment"] = strprintf("tx %d", i);
+            BOOST_CHECK(walletdb.WriteTx(wtx.GetHash(), wtx));
+            mapExpected[wtx.GetHash()] = wtx;
+        }
+
+        // A record whose key doesn't match its transaction is skipped
+        BOOST_CHECK(walletdb.WriteTx(uint256(nTxs + 1), mapExpected.begin()->second));
+    }
+
+    CWallet walletLoaded(strFile);
+    bool fFirstRun;
+    BOOST_CHECK_EQUAL(walletLoaded.LoadWallet(fFirstRun), DB_NONCRITICAL_ERROR);
+    BOOST_CHECK(GetBoolArg("-rescan", false));
+    mapArgs.erase("-rescan");
+
+    LOCK(walletLoaded.cs_wallet);
+    BOOST_CHECK_EQUAL(walletLoaded.mapWallet.size(), mapExpected.size());
+    for (map<uint256, CWalletTx>::const_iterator it = mapExpected.begin(); it != mapExpected.end(); ++it) {
+        map<uint256, CWalletTx>::const_iterator mi = walletLoaded.mapWallet.find(it->first);
+        BOOST_REQUIRE(mi != walletLoaded.mapWallet.end());
+        BOOST_CHECK_EQUAL(mi->second.nOrderPos, it->second.nOrderPos);
+        BOOST_CHECK_EQUAL(mi->second.nTimeReceived, it->second.nTimeReceived);
+        BOOST_CHECK(mi->second.mapValue == it->second.mapValue);
+        BOOST_CHECK(mi->second.vout == it->second.vout);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
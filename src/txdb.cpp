@@ -181,6 +181,16 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadPinnedBlockFile(int nFile, int& nHeight)
+{
+    return Read(make_pair('p', nFile), nHeight);
+}
+
+bool CBlockTreeDB::WritePinnedBlockFile(int nFile, int nHeight)
+{
+    return Write(make_pair('p', nFile), nHeight);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -203,22 +213,49 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     ssKeySet << make_pair('b', uint256(0));
     pcursor->Seek(ssKeySet.str());
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    // Load mapBlockIndex. Records are read in batches so that their header
+    // hashes, which are most of the work, can be computed in parallel.
+    static const size_t BATCH_SIZE = 4096;
+    std::vector<CDiskBlockIndex> vDiskIndex;
+    std::vector<CBlockHeader> vHeaders;
+    std::vector<uint256> vHashes;
+    vDiskIndex.reserve(BATCH_SIZE);
+    vHeaders.reserve(BATCH_SIZE);
+    bool fDone = false;
+    while (!fDone) {
         boost::this_thread::interruption_point();
         try {
-            leveldb::Slice slKey = pcursor->key();
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
-            char chType;
-            ssKey >> chType;
-            if (chType == 'b') {
+            vDiskIndex.clear();
+            while (vDiskIndex.size() < BATCH_SIZE) {
+                if (!pcursor->Valid()) {
+                    fDone = true;
+                    break;
+                }
+                leveldb::Slice slKey = pcursor->key();
+                CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                char chType;
+                ssKey >> chType;
+                if (chType != 'b') {
+                    fDone = true; // if shutdown requested or finished loading block index
+                    break;
+                }
                 leveldb::Slice slValue = pcursor->value();
                 CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CDiskBlockIndex diskindex;
-                ssValue >> diskindex;
+                vDiskIndex.push_back(CDiskBlockIndex());
+                ssValue >> vDiskIndex.back();
+                pcursor->Next();
+            }
+
+            vHeaders.clear();
+            BOOST_FOREACH (const CDiskBlockIndex& diskindex, vDiskIndex)
+                vHeaders.push_back(diskindex.GetBlockHeader());
+            GetBlockHeaderHashes(vHeaders, vHashes);
+
+            for (size_t i = 0; i < vDiskIndex.size(); i++) {
+                const CDiskBlockIndex& diskindex = vDiskIndex[i];
 
                 // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
+                CBlockIndex* pindexNew = InsertBlockIndex(vHashes[i]);
                 pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
                 pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
                 pindexNew->nHeight = diskindex.nHeight;
@@ -249,10 +286,6 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
                 // ppcoin: build setStakeSeen
                 if (pindexNew->IsProofOfStake())
                     setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
-
-                pcursor->Next();
-            } else {
-                break; // if shutdown requested or finished loading block index
             }
         } catch (std::exception& e) {
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
@@ -23,9 +23,21 @@ void RegisterValidationInterface(CValidationInterface* pwalletIn) {
     g_signals.BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
     g_signals.ScriptForMining.connect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockFound.connect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
+    g_signals.NotifyMasternodeBroadcast.connect(boost::bind(&CValidationInterface::NotifyMasternodeBroadcast, pwalletIn, _1));
+    g_signals.NotifyMasternodePing.connect(boost::bind(&CValidationInterface::NotifyMasternodePing, pwalletIn, _1));
+    g_signals.NotifyBudgetVote.connect(boost::bind(&CValidationInterface::NotifyBudgetVote, pwalletIn, _1));
+    g_signals.NotifyFinalizedBudgetVote.connect(boost::bind(&CValidationInterface::NotifyFinalizedBudgetVote, pwalletIn, _1));
+    g_signals.NotifySpork.connect(boost::bind(&CValidationInterface::NotifySpork, pwalletIn, _1));
+    g_signals.NotifyMasternodeWinner.connect(boost::bind(&CValidationInterface::NotifyMasternodeWinner, pwalletIn, _1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
+    g_signals.NotifyMasternodeWinner.disconnect(boost::bind(&CValidationInterface::NotifyMasternodeWinner, pwalletIn, _1));
+    g_signals.NotifySpork.disconnect(boost::bind(&CValidationInterface::NotifySpork, pwalletIn, _1));
+    g_signals.NotifyFinalizedBudgetVote.disconnect(boost::bind(&CValidationInterface::NotifyFinalizedBudgetVote, pwalletIn, _1));
+    g_signals.NotifyBudgetVote.disconnect(boost::bind(&CValidationInterface::NotifyBudgetVote, pwalletIn, _1));
+    g_signals.NotifyMasternodePing.disconnect(boost::bind(&CValidationInterface::NotifyMasternodePing, pwalletIn, _1));
+    g_signals.NotifyMasternodeBroadcast.disconnect(boost::bind(&CValidationInterface::NotifyMasternodeBroadcast, pwalletIn, _1));
     g_signals.BlockFound.disconnect(boost::bind(&CValidationInterface::ResetRequestCount, pwalletIn, _1));
     g_signals.ScriptForMining.disconnect(boost::bind(&CValidationInterface::GetScriptForMining, pwalletIn, _1));
     g_signals.BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
@@ -39,6 +51,12 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
 }
 
 void UnregisterAllValidationInterfaces() {
+    g_signals.NotifyMasternodeWinner.disconnect_all_slots();
+    g_signals.NotifySpork.disconnect_all_slots();
+    g_signals.NotifyFinalizedBudgetVote.disconnect_all_slots();
+    g_signals.NotifyBudgetVote.disconnect_all_slots();
+    g_signals.NotifyMasternodePing.disconnect_all_slots();
+    g_signals.NotifyMasternodeBroadcast.disconnect_all_slots();
     g_signals.BlockFound.disconnect_all_slots();
     g_signals.ScriptForMining.disconnect_all_slots();
     g_signals.BlockChecked.disconnect_all_slots();
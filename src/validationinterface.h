@@ -12,7 +12,13 @@
 class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
+class CBudgetVote;
+class CFinalizedBudgetVote;
+class CMasternodeBroadcast;
+class CMasternodePaymentWinner;
+class CMasternodePing;
 class CReserveScript;
+class CSporkMessage;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
@@ -42,6 +48,12 @@ protected:
     virtual void BlockChecked(const CBlock&, const CValidationState&) {}
     virtual void GetScriptForMining(boost::shared_ptr<CReserveScript>&) {};
     virtual void ResetRequestCount(const uint256 &hash) {};
+    virtual void NotifyMasternodeBroadcast(const CMasternodeBroadcast &mnb) {}
+    virtual void NotifyMasternodePing(const CMasternodePing &mnp) {}
+    virtual void NotifyBudgetVote(const CBudgetVote &vote) {}
+    virtual void NotifyFinalizedBudgetVote(const CFinalizedBudgetVote &vote) {}
+    virtual void NotifySpork(const CSporkMessage &spork) {}
+    virtual void NotifyMasternodeWinner(const CMasternodePaymentWinner &winner) {}
     friend void ::RegisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
@@ -68,6 +80,18 @@ struct CMainSignals {
     boost::signals2::signal<void (boost::shared_ptr<CReserveScript>&)> ScriptForMining;
     /** Notifies listeners that a block has been successfully mined */
     boost::signals2::signal<void (const uint256 &)> BlockFound;
+    /** Notifies listeners of a new or updated masternode list entry */
+    boost::signals2::signal<void (const CMasternodeBroadcast &)> NotifyMasternodeBroadcast;
+    /** Notifies listeners of an accepted masternode ping */
+    boost::signals2::signal<void (const CMasternodePing &)> NotifyMasternodePing;
+    /** Notifies listeners of an accepted budget proposal vote */
+    boost::signals2::signal<void (const CBudgetVote &)> NotifyBudgetVote;
+    /** Notifies listeners of an accepted finalized budget vote */
+    boost::signals2::signal<void (const CFinalizedBudgetVote &)> NotifyFinalizedBudgetVote;
+    /** Notifies listeners of a new spork value */
+    boost::signals2::signal<void (const CSporkMessage &)> NotifySpork;
+    /** Notifies listeners of an accepted masternode payment vote */
+    boost::signals2::signal<void (const CMasternodePaymentWinner &)> NotifyMasternodeWinner;
 };
 
 CMainSignals& GetMainSignals();
@@ -11,6 +11,7 @@
 #include "base58.h"
 #include "checkpoints.h"
 #include "coincontrol.h"
+#include "init.h"
 #include "kernel.h"
 #include "masternode-budget.h"
 #include "net.h"
@@ -25,6 +26,8 @@
 #include <assert.h>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 
@@ -629,8 +632,9 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
     uint256 hash = wtxIn.GetHash();
 
     if (fFromLoadWallet) {
-        mapWallet[hash] = wtxIn;
-        mapWallet[hash].BindWallet(this);
+        CWalletTx& wtx = mapWallet[hash];
+        wtx = wtxIn;
+        wtx.BindWallet(this);
         AddToSpends(hash);
     } else {
         LOCK(cs_wallet);
@@ -715,6 +719,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
+        obfuscationPlanner.TransactionChanged(hash);
 
         // notify an external script when a wallet transaction comes in or is updated
         std::string strCmd = GetArg("-walletnotify", "");
@@ -1082,41 +1087,198 @@ bool CWalletTx::WriteToDisk()
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
  */
+namespace
+{
+/**
+ * A copy of what makes an output the wallet's own: key ids, redeem scripts
+ * and watch-only scripts, but no private keys. Rescan threads test outputs
+ * against it with ::IsMine() without taking any lock.
+ */
+class CRescanKeyStore : public CKeyStore
+{
+private:
+    std::set<CKeyID> setKeyIDs;
+    ScriptMap mapScripts;
+    WatchOnlySet setWatchOnly;
+
+public:
+    CRescanKeyStore(const std::set<CKeyID>& setKeyIDsIn, const ScriptMap& mapScriptsIn, const WatchOnlySet& setWatchOnlyIn)
+        : setKeyIDs(setKeyIDsIn), mapScripts(mapScriptsIn), setWatchOnly(setWatchOnlyIn) {}
+
+    bool AddKeyPubKey(const CKey& key, const CPubKey& pubkey) { return false; }
+    bool HaveKey(const CKeyID& address) const { return setKeyIDs.count(address) > 0; }
+    bool GetKey(const CKeyID& address, CKey& keyOut) const { return false; }
+    void GetKeys(std::set<CKeyID>& setAddress) const { setAddress = setKeyIDs; }
+
+    bool AddCScript(const CScript& redeemScript) { return false; }
+    bool HaveCScript(const CScriptID& hash) const { return mapScripts.count(hash) > 0; }
+    bool GetCScript(const CScriptID& hash, CScript& redeemScriptOut) const
+    {
+        ScriptMap::const_iterator mi = mapScripts.find(hash);
+        if (mi == mapScripts.end())
+            return false;
+        redeemScriptOut = mi->second;
+        return true;
+    }
+
+    bool AddWatchOnly(const CScript& dest) { return false; }
+    bool RemoveWatchOnly(const CScript& dest) { return false; }
+    bool HaveWatchOnly(const CScript& dest) const { return setWatchOnly.count(dest) > 0; }
+    bool HaveWatchOnly() const { return !setWatchOnly.empty(); }
+};
+
+/**
+ * A block read by a rescan thread, with the transactions that pay the wallet
+ * marked. The position is taken under cs_main when the batch is queued, since
+ * pruning may move on while the threads read.
+ */
+struct CRescanBlock {
+    CBlockIndex* pindex;
+    CDiskBlockPos pos;
+    CBlock block;
+    bool fRead;
+    std::vector<bool> vPaysWallet;
+
+    CRescanBlock() : pindex(NULL), fRead(false) {}
+};
+
+/** Read and filter every nStride'th block of a batch, starting at nStart */
+void ReadRescanBlocks(const CRescanKeyStore* pkeystore, std::vector<CRescanBlock>* pvBlocks, size_t nStart, size_t nStride)
+{
+    for (size_t i = nStart; i < pvBlocks->size(); i += nStride) {
+        CRescanBlock& item = (*pvBlocks)[i];
+        // A file pruned since the batch was queued fails to read or holds another block
+        item.fRead = !item.pos.IsNull() && ReadBlockFromDisk(item.block, item.pos) && item.block.GetHash() == item.pindex->GetBlockHash();
+        if (!item.fRead)
+            continue;
+        item.vPaysWallet.assign(item.block.vtx.size(), false);
+        for (size_t j = 0; j < item.block.vtx.size(); j++) {
+            BOOST_FOREACH (const CTxOut& txout, item.block.vtx[j].vout) {
+                if (::IsMine(*pkeystore, txout.scriptPubKey) != ISMINE_NO) {
+                    item.vPaysWallet[j] = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+} // anonymous namespace
+
+/**
+ * Scan the active chain from pindexStart for transactions that involve the
+ * wallet. Batches of blocks are read from disk and their outputs matched
+ * against a copy of the wallet's keys and scripts in parallel, without holding
+ * cs_main or cs_wallet; the results are then applied in chain order, locking
+ * both only for one block at a time. The height reached is kept in the wallet
+ * so a scan cut short by shutdown resumes from there on the next start.
+ */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     int ret = 0;
     int64_t nNow = GetTime();
 
+    boost::scoped_ptr<CRescanKeyStore> pkeystore;
+    {
+        LOCK2(cs_wallet, cs_KeyStore);
+        std::set<CKeyID> setKeyIDs;
+        GetKeys(setKeyIDs);
+        pkeystore.reset(new CRescanKeyStore(setKeyIDs, mapScripts, setWatchOnly));
+    }
+
+    int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_RESCAN_THREADS));
+    const size_t nBatchSize = nThreads * 16;
+
     CBlockIndex* pindex = pindexStart;
+    CBlockIndex* pindexLast = NULL;
+    double dProgressStart, dProgressTip;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_main);
 
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
             pindex = chainActive.Next(pindex);
 
-        ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
-        double dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
-        while (pindex) {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
-
-            CBlock block;
-            ReadBlockFromDisk(block, pindex);
-            BOOST_FOREACH (CTransaction& tx, block.vtx) {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+        dProgressStart = Checkpoints::GuessVerificationProgress(pindex, false);
+        dProgressTip = Checkpoints::GuessVerificationProgress(chainActive.Tip(), false);
+    }
+    if (pindex && fFileBacked)
+        CWalletDB(strWalletFile).WriteRescanHeight(pindex->nHeight);
+
+    ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+    std::vector<CRescanBlock> vBlocks;
+    while (pindex) {
+        if (ShutdownRequested()) {
+            LogPrintf("Rescan interrupted at block %d, it will resume from there on the next start\n", pindex->nHeight);
+            if (fFileBacked)
+                CWalletDB(strWalletFile).WriteRescanHeight(pindex->nHeight);
+            break;
+        }
+
+        // Queue the next batch of the active chain. After a reorganisation
+        // carry on from where the old branch left it.
+        vBlocks.clear();
+        {
+            LOCK(cs_main);
+            if (pindexLast && !chainActive.Contains(pindexLast))
+                pindex = chainActive.Next(chainActive.FindFork(pindexLast));
+            for (; pindex && vBlocks.size() < nBatchSize; pindex = chainActive.Next(pindex)) {
+                vBlocks.push_back(CRescanBlock());
+                vBlocks.back().pindex = pindex;
+                if (pindex->nStatus & BLOCK_HAVE_DATA)
+                    vBlocks.back().pos = pindex->GetBlockPos();
+            }
+        }
+        if (vBlocks.empty())
+            break;
+        pindexLast = vBlocks.back().pindex;
+
+        boost::thread_group threadGroup;
+        for (int i = 1; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&ReadRescanBlocks, pkeystore.get(), &vBlocks, i, nThreads));
+        ReadRescanBlocks(pkeystore.get(), &vBlocks, 0, nThreads);
+        threadGroup.join_all();
+
+        BOOST_FOREACH (CRescanBlock& item, vBlocks) {
+            if (!item.fRead) {
+                // Retrying from here on every start would fail the same way
+                strMiscWarning = strprintf(_("Warning: wallet rescan stopped at block %d, which could not be read. Transactions after it may be missing from the wallet."), item.pindex->nHeight);
+                LogPrintf("ScanForWalletTransactions() : %s\n", strMiscWarning);
+                if (fFileBacked)
+                    CWalletDB(strWalletFile).EraseRescanHeight();
+                ShowProgress(_("Rescanning..."), 100);
+                return ret;
+            }
+
+            LOCK2(cs_main, cs_wallet);
+            if (item.pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(item.pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+
+            // Only transactions that pay us, spend from us or are already
+            // known need the full checks: inputs are looked up here, in chain
+            // order, so spends of outputs found earlier in the scan are seen
+            for (size_t i = 0; i < item.block.vtx.size(); i++) {
+                const CTransaction& tx = item.block.vtx[i];
+                bool fInvolved = item.vPaysWallet[i] || mapWallet.count(tx.GetHash());
+                for (size_t j = 0; !fInvolved && j < tx.vin.size(); j++)
+                    fInvolved = mapWallet.count(tx.vin[j].prevout.hash) > 0;
+                if (fInvolved && AddToWalletIfInvolvingMe(tx, &item.block, fUpdate))
                     ret++;
             }
-            pindex = chainActive.Next(pindex);
+
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(pindex));
+                LogPrintf("Still rescanning. At block %d. Progress=%f\n", item.pindex->nHeight, Checkpoints::GuessVerificationProgress(item.pindex));
+                if (fFileBacked)
+                    CWalletDB(strWalletFile).WriteRescanHeight(item.pindex->nHeight);
             }
         }
-        ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
+        // Free the blocks before the next batch is read
+        std::vector<CRescanBlock>().swap(vBlocks);
     }
+    if (!pindex && fFileBacked)
+        CWalletDB(strWalletFile).EraseRescanHeight();
+    ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     return ret;
 }
 
@@ -1155,7 +1317,7 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == "ix") {
-                mapTxLockReq.insert(make_pair(hash, (CTransaction) * this));
+                txLockManager.AddLockRequest((CTransaction) * this);
                 CreateNewLock(((CTransaction) * this));
                 RelayTransactionLockReq((CTransaction) * this, true);
             } else {
@@ -3619,12 +3781,7 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!fEnableSwiftTX) return -1;
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return (*i).second.CountSignatures();
-    }
-
-    return -1;
+    return txLockManager.CountSignatures(GetHash());
 }
 
 bool CMerkleTx::IsTransactionLockTimedOut() const
@@ -3632,10 +3789,5 @@ bool CMerkleTx::IsTransactionLockTimedOut() const
     if (!fEnableSwiftTX) return 0;
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
-    if (i != mapTxLocks.end()) {
-        return GetTime() > (*i).second.nTimeout;
-    }
-
-    return false;
+    return txLockManager.IsLockTimedOut(GetHash());
 }
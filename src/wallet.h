@@ -16,6 +16,7 @@
 #include "key.h"
 #include "keystore.h"
 #include "main.h"
+#include "obfuscation-planner.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "ui_interface.h"
@@ -53,6 +54,8 @@ static const CAmount DEFAULT_TRANSACTION_MAXFEE = 1 * COIN;
 static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWarning;
 //! Largest (in bytes) free transaction we're willing to create
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
+//! Most threads reading blocks for a wallet rescan, which is mostly bound by the disk
+static const int MAX_RESCAN_THREADS = 8;
 
 class CAccountingEntry;
 class CCoinControl;
@@ -211,6 +214,9 @@ public:
     bool fCombineDust;
     CAmount nAutoCombineThreshold;
 
+    //! coins and balances of automatic denominating
+    CObfuscationPlanner obfuscationPlanner;
+
     CWallet()
     {
         SetNull();
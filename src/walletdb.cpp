@@ -16,6 +16,7 @@
 #include "utiltime.h"
 #include "wallet.h"
 
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -27,6 +28,11 @@ using namespace std;
 
 static uint64_t nAccountingEntryNumber = 0;
 
+//! Transaction records decoded together while loading the wallet
+static const size_t WALLET_LOAD_TX_BATCH = 10000;
+//! Most threads decoding transaction records while loading the wallet
+static const int MAX_WALLET_LOAD_THREADS = 8;
+
 //
 // CWalletDB
 //
@@ -141,6 +147,23 @@ bool CWalletDB::ReadBestBlock(CBlockLocator& locator)
     return Read(std::string("bestblock"), locator);
 }
 
+bool CWalletDB::WriteRescanHeight(int nHeight)
+{
+    nWalletDBUpdated++;
+    return Write(std::string("rescanheight"), nHeight);
+}
+
+bool CWalletDB::ReadRescanHeight(int& nHeight)
+{
+    return Read(std::string("rescanheight"), nHeight);
+}
+
+bool CWalletDB::EraseRescanHeight()
+{
+    nWalletDBUpdated++;
+    return Erase(std::string("rescanheight"));
+}
+
 bool CWalletDB::WriteOrderPosNext(int64_t nOrderPosNext)
 {
     nWalletDBUpdated++;
@@ -405,6 +428,115 @@ public:
     }
 };
 
+/** Decode and check a "tx" record; ssKey is positioned after the record type */
+static bool ReadWalletTx(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgraded, string& strErr)
+{
+    uint256 hash;
+    ssKey >> hash;
+    ssValue >> wtx;
+    CValidationState state;
+    if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+        return false;
+
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703) {
+        if (!ssValue.empty()) {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        } else {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        fUpgraded = true;
+    }
+    return true;
+}
+
+static void LoadWalletTx(CWallet* pwallet, const CWalletTx& wtx, bool fUpgraded, CWalletScanState& wss)
+{
+    if (fUpgraded)
+        wss.vWalletUpgrade.push_back(wtx.GetHash());
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+
+    pwallet->AddToWallet(wtx, true);
+}
+
+/** A "tx" record set aside by LoadWallet to be decoded on a worker thread */
+struct CWalletTxRecord {
+    CDataStream ssKey;
+    CDataStream ssValue;
+    CWalletTx wtx;
+    bool fOk;
+    bool fUpgraded;
+    string strErr;
+
+    CWalletTxRecord(const CDataStream& ssKeyIn, const CDataStream& ssValueIn)
+        : ssKey(ssKeyIn), ssValue(ssValueIn), fOk(false), fUpgraded(false) {}
+};
+
+static bool IsTxRecord(const CDataStream& ssKey)
+{
+    try {
+        CDataStream ssType(ssKey);
+        string strType;
+        ssType >> strType;
+        return strType == "tx";
+    } catch (...) {
+        return false;
+    }
+}
+
+/** Decode every nStride'th record, starting at nStart */
+static void DecodeWalletTxRecords(std::vector<CWalletTxRecord>* pvRecords, size_t nStart, size_t nStride)
+{
+    for (size_t i = nStart; i < pvRecords->size(); i += nStride) {
+        CWalletTxRecord& record = (*pvRecords)[i];
+        try {
+            string strType;
+            record.ssKey >> strType;
+            record.fOk = ReadWalletTx(record.ssKey, record.ssValue, record.wtx, record.fUpgraded, record.strErr);
+        } catch (...) {
+            record.fOk = false;
+        }
+    }
+}
+
+/**
+ * Decode a batch of transaction records in parallel, then add them to the
+ * wallet in database order. Decoding and checking the transactions, hashing
+ * included, is most of the time it takes to load a large wallet.
+ */
+static void LoadWalletTxRecords(CWallet* pwallet, std::vector<CWalletTxRecord>& vRecords, CWalletScanState& wss, bool& fNoncriticalErrors)
+{
+    int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_WALLET_LOAD_THREADS));
+    if (vRecords.size() < 256)
+        nThreads = 1;
+    boost::thread_group threadGroup;
+    for (int i = 1; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&DecodeWalletTxRecords, &vRecords, i, nThreads));
+    DecodeWalletTxRecords(&vRecords, 0, nThreads);
+    threadGroup.join_all();
+
+    BOOST_FOREACH (const CWalletTxRecord& record, vRecords) {
+        if (record.fOk)
+            LoadWalletTx(pwallet, record.wtx, record.fUpgraded, wss);
+        else {
+            // Like any other bad transaction record: warn, and rescan
+            fNoncriticalErrors = true;
+            SoftSetBoolArg("-rescan", true);
+        }
+        if (!record.strErr.empty())
+            LogPrintf("%s\n", record.strErr);
+    }
+    vRecords.clear();
+}
+
 bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CWalletScanState& wss, string& strType, string& strErr)
 {
     try {
@@ -421,34 +553,11 @@ bool ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue, CW
             ssKey >> strAddress;
             ssValue >> pwallet->mapAddressBook[CBitcoinAddress(strAddress).Get()].purpose;
         } else if (strType == "tx") {
-            uint256 hash;
-            ssKey >> hash;
             CWalletTx wtx;
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            bool fUpgraded = false;
+            if (!ReadWalletTx(ssKey, ssValue, wtx, fUpgraded, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703) {
-                if (!ssValue.empty()) {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                        wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                } else {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->AddToWallet(wtx, true);
+            LoadWalletTx(pwallet, wtx, fUpgraded, wss);
         } else if (strType == "acentry") {
             string strAccount;
             ssKey >> strAccount;
@@ -670,6 +779,10 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
+        // Transactions are set aside and decoded in batches, see LoadWalletTxRecords
+        std::vector<CWalletTxRecord> vTxRecords;
+        vTxRecords.reserve(WALLET_LOAD_TX_BATCH);
+
         while (true) {
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -682,6 +795,13 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 return DB_CORRUPT;
             }
 
+            if (IsTxRecord(ssKey)) {
+                vTxRecords.push_back(CWalletTxRecord(ssKey, ssValue));
+                if (vTxRecords.size() >= WALLET_LOAD_TX_BATCH)
+                    LoadWalletTxRecords(pwallet, vTxRecords, wss, fNoncriticalErrors);
+                continue;
+            }
+
             // Try to be tolerant of single corrupt records:
             string strType, strErr;
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr)) {
@@ -700,6 +820,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             if (!strErr.empty())
                 LogPrintf("%s\n", strErr);
         }
+        LoadWalletTxRecords(pwallet, vTxRecords, wss, fNoncriticalErrors);
         pcursor->close();
     } catch (boost::thread_interrupted) {
         throw;
@@ -101,6 +101,10 @@ public:
     bool WriteBestBlock(const CBlockLocator& locator);
     bool ReadBestBlock(CBlockLocator& locator);
 
+    bool WriteRescanHeight(int nHeight);
+    bool ReadRescanHeight(int& nHeight);
+    bool EraseRescanHeight();
+
     bool WriteOrderPosNext(int64_t nOrderPosNext);
 
     // presstab
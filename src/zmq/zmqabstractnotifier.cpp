@@ -25,3 +25,33 @@ bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transacti
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyMasternodeBroadcast(const CMasternodeBroadcast &/*mnb*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyMasternodePing(const CMasternodePing &/*mnp*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBudgetVote(const CBudgetVote &/*vote*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyFinalizedBudgetVote(const CFinalizedBudgetVote &/*vote*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifySpork(const CSporkMessage &/*spork*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyMasternodeWinner(const CMasternodePaymentWinner &/*winner*/)
+{
+    return true;
+}
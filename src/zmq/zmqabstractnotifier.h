@@ -8,6 +8,12 @@
 #include "zmqconfig.h"
 
 class CBlockIndex;
+class CBudgetVote;
+class CFinalizedBudgetVote;
+class CMasternodeBroadcast;
+class CMasternodePaymentWinner;
+class CMasternodePing;
+class CSporkMessage;
 class CZMQAbstractNotifier;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
@@ -35,6 +41,12 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyMasternodeBroadcast(const CMasternodeBroadcast &mnb);
+    virtual bool NotifyMasternodePing(const CMasternodePing &mnp);
+    virtual bool NotifyBudgetVote(const CBudgetVote &vote);
+    virtual bool NotifyFinalizedBudgetVote(const CFinalizedBudgetVote &vote);
+    virtual bool NotifySpork(const CSporkMessage &spork);
+    virtual bool NotifyMasternodeWinner(const CMasternodePaymentWinner &winner);
 
 protected:
     void *psocket;
@@ -10,12 +10,14 @@
 #include "streams.h"
 #include "util.h"
 
+CZMQNotificationInterface* pzmqNotificationInterface = NULL;
+
 void zmqError(const char *str)
 {
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL), nQueueSize(DEFAULT_ZMQ_QUEUE_SIZE)
 {
 }
 
@@ -41,6 +43,11 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["pubhashmnb"] = CZMQAbstractNotifier::Create<CZMQPublishHashMasternodeBroadcastNotifier>;
+    factories["pubmnping"] = CZMQAbstractNotifier::Create<CZMQPublishMasternodePingNotifier>;
+    factories["pubbudgetvote"] = CZMQAbstractNotifier::Create<CZMQPublishBudgetVoteNotifier>;
+    factories["pubspork"] = CZMQAbstractNotifier::Create<CZMQPublishSporkNotifier>;
+    factories["pubmnwinner"] = CZMQAbstractNotifier::Create<CZMQPublishMasternodeWinnerNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -61,6 +68,10 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
 
+        std::map<std::string, std::string>::const_iterator it = args.find("-zmqqueuesize");
+        if (it != args.end())
+            notificationInterface->nQueueSize = std::max(atoi(it->second), 1);
+
         if (!notificationInterface->Initialize())
         {
             delete notificationInterface;
@@ -105,6 +116,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    CZMQAbstractPublishNotifier::StartPublisher(nQueueSize);
+
     return true;
 }
 
@@ -114,6 +127,9 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        // sockets belong to the publisher thread until it has exited
+        CZMQAbstractPublishNotifier::StopPublisher();
+
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -126,53 +142,86 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
+void CZMQNotificationInterface::GetStats(std::vector<CZMQPublishStats>& vStats, CZMQPublishQueueStats& queueStats) const
+{
+    vStats.clear();
+    for (std::list<CZMQAbstractNotifier*>::const_iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        vStats.push_back(static_cast<const CZMQAbstractPublishNotifier*>(*i)->GetStats());
+    }
+    queueStats = CZMQAbstractPublishNotifier::GetQueueStats();
+}
+
+// The notifiers only queue messages, a notifier that failed on the publisher
+// thread stays in the list and ignores further notifications.
 void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindex))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
+        (*i)->NotifyBlock(pindex);
     }
 }
 
 void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
+        (*i)->NotifyTransaction(tx);
     }
 }
 
 void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
 {
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransactionLock(tx))
-        {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
-        }
+        (*i)->NotifyTransactionLock(tx);
+    }
+}
+
+void CZMQNotificationInterface::NotifyMasternodeBroadcast(const CMasternodeBroadcast &mnb)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        (*i)->NotifyMasternodeBroadcast(mnb);
+    }
+}
+
+void CZMQNotificationInterface::NotifyMasternodePing(const CMasternodePing &mnp)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        (*i)->NotifyMasternodePing(mnp);
+    }
+}
+
+void CZMQNotificationInterface::NotifyBudgetVote(const CBudgetVote &vote)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        (*i)->NotifyBudgetVote(vote);
+    }
+}
+
+void CZMQNotificationInterface::NotifyFinalizedBudgetVote(const CFinalizedBudgetVote &vote)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        (*i)->NotifyFinalizedBudgetVote(vote);
+    }
+}
+
+void CZMQNotificationInterface::NotifySpork(const CSporkMessage &spork)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        (*i)->NotifySpork(spork);
+    }
+}
+
+void CZMQNotificationInterface::NotifyMasternodeWinner(const CMasternodePaymentWinner &winner)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); ++i)
+    {
+        (*i)->NotifyMasternodeWinner(winner);
     }
 }
@@ -8,10 +8,32 @@
 #include "validationinterface.h"
 #include <string>
 #include <map>
+#include <vector>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+/** Default for -zmqqueuesize, the number of messages waiting for the publisher thread */
+static const unsigned int DEFAULT_ZMQ_QUEUE_SIZE = 1000;
+
+struct CZMQPublishStats
+{
+    std::string type;
+    std::string address;
+    uint64_t nPublished;
+    uint64_t nDropped;
+    uint64_t nFailed;
+    bool fEnabled;
+};
+
+struct CZMQPublishQueueStats
+{
+    size_t nSize;
+    size_t nMaxSize;
+    size_t nHighWater;
+    uint64_t nDropped;
+};
+
 class CZMQNotificationInterface : public CValidationInterface
 {
 public:
@@ -19,6 +41,8 @@ public:
 
     static CZMQNotificationInterface* CreateWithArguments(const std::map<std::string, std::string> &args);
 
+    void GetStats(std::vector<CZMQPublishStats>& vStats, CZMQPublishQueueStats& queueStats) const;
+
 protected:
     bool Initialize();
     void Shutdown();
@@ -27,12 +51,22 @@ protected:
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void NotifyTransactionLock(const CTransaction &tx);
+    void NotifyMasternodeBroadcast(const CMasternodeBroadcast &mnb);
+    void NotifyMasternodePing(const CMasternodePing &mnp);
+    void NotifyBudgetVote(const CBudgetVote &vote);
+    void NotifyFinalizedBudgetVote(const CFinalizedBudgetVote &vote);
+    void NotifySpork(const CSporkMessage &spork);
+    void NotifyMasternodeWinner(const CMasternodePaymentWinner &winner);
 
 private:
     CZMQNotificationInterface();
 
     void *pcontext;
+    size_t nQueueSize;
+    // not modified after Initialize(), the publisher thread relies on that
     std::list<CZMQAbstractNotifier*> notifiers;
 };
 
+extern CZMQNotificationInterface* pzmqNotificationInterface;
+
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -5,9 +5,19 @@
 #include "chainparams.h"
 #include "zmqpublishnotifier.h"
 #include "main.h"
+#include "masternode.h"
+#include "masternode-budget.h"
+#include "masternode-payments.h"
+#include "spork.h"
 #include "util.h"
 #include "crypto/common.h"
 
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK  = "hashblock";
@@ -16,46 +26,228 @@ static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK   = "rawblock";
 static const char *MSG_RAWTX      = "rawtx";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_HASHMNB    = "hashmnb";
+static const char *MSG_MNPING     = "mnping";
+static const char *MSG_BUDGETVOTE = "budgetvote";
+static const char *MSG_FINALBUDGETVOTE = "finalbudgetvote";
+static const char *MSG_SPORKMESSAGE = "spork";
+static const char *MSG_MNWINNER   = "mnwinner";
+
+static void zmq_release_payload(void* /*data*/, void* hint)
+{
+    delete static_cast<CZMQPayload*>(hint);
+}
 
-// Internal function to send multipart message
-static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
+// Internal function to send the three parts of a message. The command strings
+// are static and the body is shared, so only the sequence number is copied.
+// All parts are built before the first one is sent. fPartial is set when a
+// part after the first failed, which leaves the earlier parts queued on the
+// socket: the caller has to reset it before anything else is sent.
+static int zmq_send_message(void *sock, const char* command, const CZMQPayload& payload, uint32_t nSequence, bool& fPartial)
 {
-    va_list args;
-    va_start(args, size);
+    zmq_msg_t msg[3];
+    fPartial = false;
 
-    while (1)
+    int rc = zmq_msg_init_data(&msg[0], const_cast<char*>(command), strlen(command), NULL, NULL);
+    if (rc != 0)
     {
-        zmq_msg_t msg;
+        zmqError("Unable to initialize ZMQ msg");
+        return -1;
+    }
+
+    // ZMQ holds its own reference to the body until the I/O thread is done with it
+    CZMQPayload* hint = new CZMQPayload(payload);
+    rc = zmq_msg_init_data(&msg[1], const_cast<char*>(&(*payload->begin())), payload->size(), zmq_release_payload, hint);
+    if (rc != 0)
+    {
+        delete hint;
+        zmqError("Unable to initialize ZMQ msg");
+        zmq_msg_close(&msg[0]);
+        return -1;
+    }
 
-        int rc = zmq_msg_init_size(&msg, size);
-        if (rc != 0)
+    rc = zmq_msg_init_size(&msg[2], sizeof(uint32_t));
+    if (rc != 0)
+    {
+        zmqError("Unable to initialize ZMQ msg");
+        zmq_msg_close(&msg[0]);
+        zmq_msg_close(&msg[1]);
+        return -1;
+    }
+    WriteLE32((unsigned char*)zmq_msg_data(&msg[2]), nSequence);
+
+    for (int i = 0; i < 3; i++)
+    {
+        rc = zmq_msg_send(&msg[i], sock, i < 2 ? ZMQ_SNDMORE : 0);
+        if (rc == -1)
         {
-            zmqError("Unable to initialize ZMQ msg");
+            zmqError("Unable to send ZMQ msg");
+            for (int j = i; j < 3; j++)
+                zmq_msg_close(&msg[j]);
+            fPartial = i > 0;
             return -1;
         }
+    }
 
-        void *buf = zmq_msg_data(&msg);
-        memcpy(buf, data, size);
+    return 0;
+}
+
+static CZMQPayload HashPayload(const uint256& hash)
+{
+    boost::shared_ptr<CDataStream> ss(new CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    ss->write(data, 32);
+    return ss;
+}
 
-        data = va_arg(args, const void*);
+template <typename T>
+static CZMQPayload SerializedPayload(const T& obj)
+{
+    boost::shared_ptr<CDataStream> ss(new CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    *ss << obj;
+    return ss;
+}
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
-        if (rc == -1)
+/**
+ * Bounded queue between the validation callbacks and the single thread that
+ * owns the ZMQ sockets. Callbacks never block on ZMQ or on disk; when the
+ * queue is full the newest message is dropped and counted.
+ */
+class CZMQPublishQueue
+{
+private:
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<CZMQPublishMessage> queue;
+    size_t nMaxSize;
+    size_t nHighWater;
+    uint64_t nDropped;
+    bool fRunning;
+    boost::thread thread;
+
+    void Thread()
+    {
+        while (true) {
+            CZMQPublishMessage msg;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (fRunning && queue.empty())
+                    cond.wait(lock);
+                if (!fRunning)
+                    return;
+                msg = queue.front();
+                queue.pop_front();
+            }
+
+            if (!msg.notifier->PreparePayload(msg)) {
+                // e.g. the block was pruned before its turn came: skip this notification only
+                LogPrint("zmq", "zmq: Skipping %s for notifier %s, no payload\n", msg.command, msg.notifier->GetType());
+                boost::unique_lock<boost::mutex> lock(mutex);
+                msg.notifier->nFailed++;
+                continue;
+            }
+
+            bool fSent = msg.notifier->Publish(msg);
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fSent) {
+                msg.notifier->nPublished++;
+            } else {
+                msg.notifier->nFailed++;
+                if (!msg.notifier->psocket) {
+                    // the socket could not be brought back, so nothing more can go out on it
+                    LogPrint("zmq", "zmq: Disabling notifier %s after failed %s\n", msg.notifier->GetType(), msg.command);
+                    msg.notifier->fEnabled = false;
+                }
+            }
+        }
+    }
+
+public:
+    CZMQPublishQueue() : nMaxSize(DEFAULT_ZMQ_QUEUE_SIZE), nHighWater(0), nDropped(0), fRunning(false) {}
+
+    void Start(size_t nMaxSizeIn)
+    {
         {
-            zmqError("Unable to send ZMQ msg");
-            zmq_msg_close(&msg);
-            return -1;
+            boost::unique_lock<boost::mutex> lock(mutex);
+            assert(!fRunning);
+            nMaxSize = std::max(nMaxSizeIn, (size_t)1);
+            fRunning = true;
         }
+        thread = boost::thread(boost::bind(&TraceThread<boost::function<void()> >, "zmqpub",
+            boost::function<void()>(boost::bind(&CZMQPublishQueue::Thread, this))));
+    }
 
-        zmq_msg_close(&msg);
+    void Stop()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (!fRunning)
+                return;
+            fRunning = false;
+            if (!queue.empty())
+                LogPrint("zmq", "zmq: Discarding %u unpublished messages\n", queue.size());
+            queue.clear();
+        }
+        cond.notify_all();
+        thread.join();
+    }
 
-        if (!data)
-            break;
+    bool Push(CZMQAbstractPublishNotifier* notifier, const char* command, const CZMQPayload& payload, const CBlockIndex* pindex)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (!notifier->fEnabled)
+                return false;
+
+            uint32_t nSequence = notifier->nSequence++;
+            if (!fRunning || queue.size() >= nMaxSize) {
+                notifier->nDropped++;
+                nDropped++;
+                return true;
+            }
+
+            CZMQPublishMessage msg;
+            msg.notifier = notifier;
+            msg.command = command;
+            msg.nSequence = nSequence;
+            msg.payload = payload;
+            msg.pindex = pindex;
+            queue.push_back(msg);
+            nHighWater = std::max(nHighWater, queue.size());
+        }
+        cond.notify_one();
+        return true;
+    }
 
-        size = va_arg(args, size_t);
+    CZMQPublishStats GetStats(const CZMQAbstractPublishNotifier* notifier)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        CZMQPublishStats stats;
+        stats.type = notifier->GetType();
+        stats.address = notifier->GetAddress();
+        stats.nPublished = notifier->nPublished;
+        stats.nDropped = notifier->nDropped;
+        stats.nFailed = notifier->nFailed;
+        stats.fEnabled = notifier->fEnabled;
+        return stats;
     }
-    return 0;
-}
+
+    CZMQPublishQueueStats GetQueueStats()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        CZMQPublishQueueStats stats;
+        stats.nSize = queue.size();
+        stats.nMaxSize = nMaxSize;
+        stats.nHighWater = nHighWater;
+        stats.nDropped = nDropped;
+        return stats;
+    }
+};
+
+static CZMQPublishQueue publishQueue;
 
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
@@ -64,6 +256,7 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
     // check if address is being used by other publish notifier
     std::multimap<std::string, CZMQAbstractPublishNotifier*>::iterator i = mapPublishNotifiers.find(address);
 
+    this->pcontext = pcontext;
     if (i==mapPublishNotifiers.end())
     {
         psocket = zmq_socket(pcontext, ZMQ_PUB);
@@ -98,7 +291,6 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 
 void CZMQAbstractPublishNotifier::Shutdown()
 {
-    assert(psocket);
 
     int count = mapPublishNotifiers.count(address);
 
@@ -115,7 +307,7 @@ void CZMQAbstractPublishNotifier::Shutdown()
         }
     }
 
-    if (count == 1)
+    if (count == 1 && psocket)
     {
         LogPrint("zmq", "Close socket at address %s\n", address);
         int linger = 0;
@@ -126,89 +318,174 @@ void CZMQAbstractPublishNotifier::Shutdown()
     psocket = 0;
 }
 
-bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+bool CZMQAbstractPublishNotifier::SendMessage(const char* command, const CZMQPayload& payload, const CBlockIndex* pindex)
 {
-    assert(psocket);
+    return publishQueue.Push(this, command, payload, pindex);
+}
 
-    /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
+bool CZMQAbstractPublishNotifier::Publish(const CZMQPublishMessage& msg)
+{
+    if (!psocket)
         return false;
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
+    bool fPartial;
+    if (zmq_send_message(psocket, msg.command, msg.payload, msg.nSequence, fPartial) == 0)
+        return true;
+    if (fPartial)
+        ResetSocket();
+    return false;
+}
 
-    return true;
+void CZMQAbstractPublishNotifier::ResetSocket()
+{
+    LogPrint("zmq", "zmq: Reopening socket at address %s after a partial message\n", address);
+
+    // Closing without linger drops the parts already queued
+    int linger = 0;
+    zmq_setsockopt(psocket, ZMQ_LINGER, &linger, sizeof(linger));
+    zmq_close(psocket);
+
+    void* psocketNew = zmq_socket(pcontext, ZMQ_PUB);
+    if (!psocketNew)
+    {
+        zmqError("Failed to create socket");
+    }
+    else if (zmq_bind(psocketNew, address.c_str()) != 0)
+    {
+        zmqError("Failed to bind address");
+        zmq_close(psocketNew);
+        psocketNew = 0;
+    }
+
+    // the notifiers sharing this address share the socket
+    typedef std::multimap<std::string, CZMQAbstractPublishNotifier*>::iterator iterator;
+    std::pair<iterator, iterator> iterpair = mapPublishNotifiers.equal_range(address);
+    for (iterator it = iterpair.first; it != iterpair.second; ++it)
+        it->second->psocket = psocketNew;
+}
+
+CZMQPublishStats CZMQAbstractPublishNotifier::GetStats() const
+{
+    return publishQueue.GetStats(this);
+}
+
+void CZMQAbstractPublishNotifier::StartPublisher(size_t nMaxQueueSize)
+{
+    publishQueue.Start(nMaxQueueSize);
+}
+
+void CZMQAbstractPublishNotifier::StopPublisher()
+{
+    publishQueue.Stop();
+}
+
+CZMQPublishQueueStats CZMQAbstractPublishNotifier::GetQueueStats()
+{
+    return publishQueue.GetQueueStats();
 }
 
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint("zmq", "zmq: Publish hashblock %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHBLOCK, data, 32);
+    return SendMessage(MSG_HASHBLOCK, HashPayload(hash));
 }
 
 bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish hashtx %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHTX, data, 32);
+    return SendMessage(MSG_HASHTX, HashPayload(hash));
 }
 
 bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish hashtxlock %s\n", hash.GetHex());
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(MSG_HASHTXLOCK, data, 32);
+    return SendMessage(MSG_HASHTXLOCK, HashPayload(hash));
 }
 
 bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-// XX42    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    // The block is read and serialized on the publisher thread, not under cs_main here
+    return SendMessage(MSG_RAWBLOCK, CZMQPayload(), pindex);
+}
+
+bool CZMQPublishRawBlockNotifier::PreparePayload(CZMQPublishMessage& msg)
+{
+    CDiskBlockPos pos;
     {
         LOCK(cs_main);
-        CBlock block;
-// XX42        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        if(!ReadBlockFromDisk(block, pindex))
+        if (!(msg.pindex->nStatus & BLOCK_HAVE_DATA))
         {
-            zmqError("Can't read block from disk");
+            zmqError("Block not available on disk");
             return false;
         }
+        pos = msg.pindex->GetBlockPos();
+    }
 
-        ss << block;
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pos) || block.GetHash() != msg.pindex->GetBlockHash())
+    {
+        zmqError("Can't read block from disk");
+        return false;
     }
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    boost::shared_ptr<CDataStream> ss(new CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+    *ss << block;
+    msg.payload = ss;
+    return true;
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTX, SerializedPayload(transaction));
 }
 
 bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtxlock %s\n", hash.GetHex());
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+    return SendMessage(MSG_RAWTXLOCK, SerializedPayload(transaction));
+}
+
+bool CZMQPublishHashMasternodeBroadcastNotifier::NotifyMasternodeBroadcast(const CMasternodeBroadcast &mnb)
+{
+    uint256 hash = mnb.GetHash();
+    LogPrint("zmq", "zmq: Publish hashmnb %s\n", hash.GetHex());
+    return SendMessage(MSG_HASHMNB, HashPayload(hash));
+}
+
+bool CZMQPublishMasternodePingNotifier::NotifyMasternodePing(const CMasternodePing &mnp)
+{
+    LogPrint("zmq", "zmq: Publish mnping %s\n", mnp.vin.prevout.ToStringShort());
+    return SendMessage(MSG_MNPING, SerializedPayload(mnp));
+}
+
+bool CZMQPublishBudgetVoteNotifier::NotifyBudgetVote(const CBudgetVote &vote)
+{
+    LogPrint("zmq", "zmq: Publish budgetvote %s for %s\n", vote.vin.prevout.ToStringShort(), vote.nProposalHash.GetHex());
+    return SendMessage(MSG_BUDGETVOTE, SerializedPayload(vote));
+}
+
+bool CZMQPublishBudgetVoteNotifier::NotifyFinalizedBudgetVote(const CFinalizedBudgetVote &vote)
+{
+    LogPrint("zmq", "zmq: Publish finalbudgetvote %s for %s\n", vote.vin.prevout.ToStringShort(), vote.nBudgetHash.GetHex());
+    return SendMessage(MSG_FINALBUDGETVOTE, SerializedPayload(vote));
+}
+
+bool CZMQPublishSporkNotifier::NotifySpork(const CSporkMessage &spork)
+{
+    LogPrint("zmq", "zmq: Publish spork %d\n", spork.nSporkID);
+    return SendMessage(MSG_SPORKMESSAGE, SerializedPayload(spork));
+}
+
+bool CZMQPublishMasternodeWinnerNotifier::NotifyMasternodeWinner(const CMasternodePaymentWinner &winner)
+{
+    LogPrint("zmq", "zmq: Publish mnwinner %d %s\n", winner.nBlockHeight, winner.vinMasternode.prevout.ToStringShort());
+    return SendMessage(MSG_MNWINNER, SerializedPayload(winner));
 }
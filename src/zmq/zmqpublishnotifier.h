@@ -6,26 +6,82 @@
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include "zmqabstractnotifier.h"
+#include "zmqnotificationinterface.h"
+#include "streams.h"
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
 
 class CBlockIndex;
 
+/**
+ * Serialized message body. The buffer is shared with ZMQ and released from
+ * the ZMQ I/O thread once the message has left the socket, so it is never
+ * copied after serialization.
+ */
+typedef boost::shared_ptr<const CDataStream> CZMQPayload;
+
+class CZMQAbstractPublishNotifier;
+
+/** A notification waiting for the publisher thread */
+struct CZMQPublishMessage
+{
+    CZMQAbstractPublishNotifier* notifier;
+    const char* command;
+    uint32_t nSequence;
+    CZMQPayload payload;
+    //! Set instead of payload when the body is built on the publisher thread
+    const CBlockIndex* pindex;
+
+    CZMQPublishMessage() : notifier(NULL), command(NULL), nSequence(0), pindex(NULL) {}
+};
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
     uint32_t nSequence; // upcounting per message sequence number
+    void *pcontext;
+
+    // counters, guarded by the publish queue lock
+    uint64_t nPublished;
+    uint64_t nDropped;
+    uint64_t nFailed;
+    bool fEnabled;
+
+    friend class CZMQPublishQueue;
+
+    /** Hand a prepared message to the socket; publisher thread only */
+    bool Publish(const CZMQPublishMessage& msg);
+    /** Replace the socket after a half sent message; leaves psocket null if that fails */
+    void ResetSocket();
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0), pcontext(0), nPublished(0), nDropped(0), nFailed(0), fEnabled(true) {}
 
-    /* send zmq multipart message
+    /* queue zmq multipart message for the publisher thread
        parts:
           * command
           * data
           * message sequence number
+       The sequence number is assigned here, so messages dropped because the
+       queue is full show up as gaps on the subscriber side.
     */
-    bool SendMessage(const char *command, const void* data, size_t size);
+    bool SendMessage(const char* command, const CZMQPayload& payload, const CBlockIndex* pindex = NULL);
+
+    /** Fill in msg.payload on the publisher thread, for messages queued without one */
+    virtual bool PreparePayload(CZMQPublishMessage& msg) { return !!msg.payload; }
 
     bool Initialize(void *pcontext);
     void Shutdown();
+
+    CZMQPublishStats GetStats() const;
+
+    /** Start the publisher thread; notifiers must be initialized first */
+    static void StartPublisher(size_t nMaxQueueSize);
+    /** Stop the publisher thread, discarding anything still queued */
+    static void StopPublisher();
+    static CZMQPublishQueueStats GetQueueStats();
 };
 
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
@@ -50,6 +106,7 @@ class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
     bool NotifyBlock(const CBlockIndex *pindex);
+    bool PreparePayload(CZMQPublishMessage& msg);
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -64,4 +121,36 @@ public:
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
+class CZMQPublishHashMasternodeBroadcastNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMasternodeBroadcast(const CMasternodeBroadcast &mnb);
+};
+
+class CZMQPublishMasternodePingNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMasternodePing(const CMasternodePing &mnp);
+};
+
+/** Publishes both proposal votes (budgetvote) and finalized budget votes (finalbudgetvote) */
+class CZMQPublishBudgetVoteNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBudgetVote(const CBudgetVote &vote);
+    bool NotifyFinalizedBudgetVote(const CFinalizedBudgetVote &vote);
+};
+
+class CZMQPublishSporkNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifySpork(const CSporkMessage &spork);
+};
+
+class CZMQPublishMasternodeWinnerNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMasternodeWinner(const CMasternodePaymentWinner &winner);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H